@@ -0,0 +1,110 @@
+#include "addr_table.h"
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t hash_addr(uint32_t ip, uint16_t port) {
+    // Fibonacci hashing of the combined key spreads adjacent ports well
+    uint64_t key = ((uint64_t)ip << 16) | port;
+    return (uint32_t)((key * 0x9E3779B97F4A7C15ULL) >> 32);
+}
+
+int addr_table_init(AddrTable *table, int max_entries) {
+    memset(table, 0, sizeof(*table));
+    if (max_entries <= 0) {
+        return -1;
+    }
+
+    // Keep the load factor at or below 50% so probe chains stay short
+    uint32_t capacity = 16;
+    while (capacity < (uint32_t)max_entries * 2) {
+        capacity <<= 1;
+    }
+
+    table->entries = malloc(capacity * sizeof(AddrTableEntry));
+    if (!table->entries) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < capacity; i++) {
+        table->entries[i].value = -1;
+    }
+    table->mask = capacity - 1;
+    return 0;
+}
+
+void addr_table_destroy(AddrTable *table) {
+    free(table->entries);
+    memset(table, 0, sizeof(*table));
+}
+
+int addr_table_get(const AddrTable *table, const struct sockaddr_in *addr) {
+    uint32_t ip = addr->sin_addr.s_addr;
+    uint16_t port = addr->sin_port;
+
+    for (uint32_t i = hash_addr(ip, port) & table->mask;; i = (i + 1) & table->mask) {
+        const AddrTableEntry *e = &table->entries[i];
+        if (e->value < 0) {
+            return -1;
+        }
+        if (e->ip == ip && e->port == port) {
+            return e->value;
+        }
+    }
+}
+
+int addr_table_put(AddrTable *table, const struct sockaddr_in *addr, int value) {
+    uint32_t ip = addr->sin_addr.s_addr;
+    uint16_t port = addr->sin_port;
+
+    if (value < 0 || (uint32_t)table->count >= (table->mask + 1) / 2) {
+        return -1;
+    }
+
+    for (uint32_t i = hash_addr(ip, port) & table->mask;; i = (i + 1) & table->mask) {
+        AddrTableEntry *e = &table->entries[i];
+        if (e->value < 0) {
+            e->ip = ip;
+            e->port = port;
+            e->value = value;
+            table->count++;
+            return 0;
+        }
+        if (e->ip == ip && e->port == port) {
+            e->value = value;
+            return 0;
+        }
+    }
+}
+
+void addr_table_remove(AddrTable *table, const struct sockaddr_in *addr) {
+    uint32_t ip = addr->sin_addr.s_addr;
+    uint16_t port = addr->sin_port;
+    uint32_t i = hash_addr(ip, port) & table->mask;
+
+    for (;; i = (i + 1) & table->mask) {
+        AddrTableEntry *e = &table->entries[i];
+        if (e->value < 0) {
+            return;
+        }
+        if (e->ip == ip && e->port == port) {
+            break;
+        }
+    }
+
+    // Backward-shift deletion keeps probe chains intact without tombstones
+    uint32_t hole = i;
+    for (uint32_t j = (i + 1) & table->mask;; j = (j + 1) & table->mask) {
+        AddrTableEntry *e = &table->entries[j];
+        if (e->value < 0) {
+            break;
+        }
+        uint32_t home = hash_addr(e->ip, e->port) & table->mask;
+        // Move e into the hole unless its home lies cyclically in (hole, j]
+        if (((j - home) & table->mask) >= ((j - hole) & table->mask)) {
+            table->entries[hole] = *e;
+            hole = j;
+        }
+    }
+
+    table->entries[hole].value = -1;
+    table->count--;
+}
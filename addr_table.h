@@ -0,0 +1,28 @@
+#ifndef COMP7005PROJ1_ADDR_TABLE_H
+#define COMP7005PROJ1_ADDR_TABLE_H
+
+#include <stdint.h>
+#include <netinet/in.h>
+
+// One slot of the open-addressed table; value < 0 marks an empty slot
+typedef struct {
+    uint32_t ip;              // Network byte order
+    uint16_t port;            // Network byte order
+    int32_t value;
+} AddrTableEntry;
+
+// Fixed-capacity hash from IPv4 address:port to a caller-owned index
+typedef struct {
+    AddrTableEntry *entries;
+    uint32_t mask;            // Capacity - 1 (capacity is a power of two)
+    int count;
+} AddrTable;
+
+// Function prototypes
+int addr_table_init(AddrTable *table, int max_entries);
+void addr_table_destroy(AddrTable *table);
+int addr_table_get(const AddrTable *table, const struct sockaddr_in *addr);
+int addr_table_put(AddrTable *table, const struct sockaddr_in *addr, int value);
+void addr_table_remove(AddrTable *table, const struct sockaddr_in *addr);
+
+#endif //COMP7005PROJ1_ADDR_TABLE_H
@@ -0,0 +1,606 @@
+// Offline analyzer for --event-log files: the statistics visualize_log.py
+// prints, computed from fixed-size binary records instead of text lines.
+// --json prints the same figures as one JSON document for scripts.
+#include "evlog.h"
+#include "histogram.h"
+#include <fcntl.h>
+#include <glob.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define ANALYZE_MAX_ATTEMPTS 64    // Retransmission histogram buckets; higher attempts share the last
+#define ANALYZE_MAX_SETS 64
+#define BAR_WIDTH 50
+
+// Growable open-addressed set of (flow, seq) pairs seen. Sessions start at
+// random ISNs anywhere in the 32-bit space, so a bitmap indexed by seq
+// would be mostly empty, and bench flows all start at 0.
+typedef struct {
+    uint64_t *words;          // (flow << 32 | seq) + 1 per slot, 0 = empty
+    size_t word_count;        // Power of two
+    uint64_t distinct;
+} SeqSet;
+
+typedef struct {
+    uint64_t sent;
+    uint64_t retransmissions;  // Sends past the first attempt
+    uint64_t acked;
+    uint64_t failed;
+    uint64_t timeouts;
+    uint64_t timeouts_by_attempt[ANALYZE_MAX_ATTEMPTS + 1];
+    uint64_t rtt_us_sum;
+    Histogram rtt_us;
+    SeqSet seqs;
+} ClientStats;
+
+typedef struct {
+    uint64_t received;
+    uint64_t acks_sent;
+    uint64_t sacks_sent;
+    uint64_t duplicates;
+    uint64_t bytes;            // Payload received, duplicates included
+    uint64_t duplicate_bytes;
+    uint64_t first_ns;         // First and last arrival, for the goodput
+    uint64_t last_ns;
+    SeqSet seqs;
+} ServerStats;
+
+typedef struct {
+    uint64_t received;
+    uint64_t dropped;
+    uint64_t delayed;
+    uint64_t queue_full;
+    uint64_t reordered;
+    uint64_t duplicated;
+    uint64_t rate_drops;
+    uint64_t corrupted;
+    uint64_t crc_drops;
+    uint64_t delay_sum;
+    uint32_t delay_min;
+    uint32_t delay_max;
+} ProxyDirStats;
+
+// Client, server and proxy logs sharing one test name prefix
+typedef struct {
+    char name[256];
+    const char *files[3];      // Indexed by EventRole - 1
+} TestSet;
+
+static size_t seq_slot(const uint64_t *words, size_t count, uint64_t key) {
+    size_t i = (size_t)((key * 0x9E3779B97F4A7C15ULL) >> 32) & (count - 1);
+    while (words[i] != 0 && words[i] != key + 1) {
+        i = (i + 1) & (count - 1);
+    }
+    return i;
+}
+
+static int seq_set_add(SeqSet *set, uint32_t flow, uint32_t seq) {
+    uint64_t key = (uint64_t)flow << 32 | seq;
+
+    // Kept at most half full
+    if ((set->distinct + 1) * 2 > set->word_count) {
+        size_t count = set->word_count ? set->word_count * 2 : 1024;
+        uint64_t *words = calloc(count, sizeof(uint64_t));
+        if (!words) {
+            return -1;
+        }
+        for (size_t i = 0; i < set->word_count; i++) {
+            if (set->words[i] != 0) {
+                words[seq_slot(words, count, set->words[i] - 1)] = set->words[i];
+            }
+        }
+        free(set->words);
+        set->words = words;
+        set->word_count = count;
+    }
+
+    size_t i = seq_slot(set->words, set->word_count, key);
+    if (set->words[i] == 0) {
+        set->words[i] = key + 1;
+        set->distinct++;
+    }
+    return 0;
+}
+
+static void print_bar_chart(const char *label, uint64_t value, uint64_t max_value) {
+    int width = max_value ? (int)((double)value / (double)max_value * BAR_WIDTH) : 0;
+    printf("%-25s | ", label);
+    for (int i = 0; i < width; i++) {
+        fputs("█", stdout);
+    }
+    printf(" %llu\n", (unsigned long long)value);
+}
+
+// Maps the whole file; returns the records and their count, or NULL
+static const EventRecord *map_event_log(const char *path, int *role, size_t *count,
+                                        void **map, size_t *map_len) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Warning: %s not found\n", path);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(EventLogHeader)) {
+        fprintf(stderr, "Warning: %s is not an event log\n", path);
+        close(fd);
+        return NULL;
+    }
+
+    *map_len = (size_t)st.st_size;
+    *map = mmap(NULL, *map_len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (*map == MAP_FAILED) {
+        fprintf(stderr, "Warning: cannot map %s\n", path);
+        return NULL;
+    }
+    madvise(*map, *map_len, MADV_SEQUENTIAL);
+
+    const EventLogHeader *header = *map;
+    if (memcmp(header->magic, EVLOG_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != EVLOG_VERSION || header->record_size != sizeof(EventRecord)) {
+        fprintf(stderr, "Warning: %s has an unknown event log format\n", path);
+        munmap(*map, *map_len);
+        return NULL;
+    }
+
+    *role = header->role;
+    *count = (*map_len - sizeof(EventLogHeader)) / sizeof(EventRecord);
+    return (const EventRecord *)((const char *)*map + sizeof(EventLogHeader));
+}
+
+static void analyze_client(const EventRecord *r, size_t count, ClientStats *s) {
+    memset(s, 0, sizeof(*s));
+    histogram_init(&s->rtt_us);
+    for (size_t i = 0; i < count; i++) {
+        switch (r[i].type) {
+            case EV_SEND:
+                s->sent++;
+                s->retransmissions += r[i].attempt > 1;
+                seq_set_add(&s->seqs, r[i].flow, r[i].seq);
+                break;
+            case EV_ACK_RECV:
+                s->acked++;
+                s->rtt_us_sum += r[i].extra;
+                histogram_record(&s->rtt_us, r[i].extra);
+                break;
+            case EV_FAILED:
+                s->failed++;
+                break;
+            case EV_TIMEOUT:
+                s->timeouts++;
+                s->timeouts_by_attempt[r[i].attempt < ANALYZE_MAX_ATTEMPTS ?
+                                       r[i].attempt : ANALYZE_MAX_ATTEMPTS]++;
+                break;
+        }
+    }
+}
+
+static void analyze_server(const EventRecord *r, size_t count, ServerStats *s) {
+    memset(s, 0, sizeof(*s));
+    for (size_t i = 0; i < count; i++) {
+        switch (r[i].type) {
+            case EV_RECV:
+                s->received++;
+                s->bytes += r[i].bytes;
+                // Threads write their records in batches, so the file is not in time order
+                if (s->received == 1 || r[i].ts_ns < s->first_ns) s->first_ns = r[i].ts_ns;
+                if (r[i].ts_ns > s->last_ns) s->last_ns = r[i].ts_ns;
+                seq_set_add(&s->seqs, r[i].flow, r[i].seq);
+                break;
+            case EV_ACK_SEND:
+                s->acks_sent++;
+                break;
+            case EV_SACK_SEND:
+                s->sacks_sent++;
+                break;
+            case EV_DUPLICATE:
+                s->duplicates++;
+                s->duplicate_bytes += r[i].bytes;
+                break;
+        }
+    }
+}
+
+static void analyze_proxy(const EventRecord *r, size_t count, ProxyDirStats s[2]) {
+    memset(s, 0, 2 * sizeof(*s));
+    s[0].delay_min = s[1].delay_min = UINT32_MAX;
+    for (size_t i = 0; i < count; i++) {
+        ProxyDirStats *d = &s[r[i].direction & 1];
+        switch (r[i].type) {
+            case EV_PROXY_RECV:
+                d->received++;
+                break;
+            case EV_PROXY_DROP:
+                d->dropped++;
+                break;
+            case EV_PROXY_QUEUE_FULL:
+                d->queue_full++;
+                break;
+            case EV_PROXY_REORDER:
+                d->reordered++;
+                break;
+            case EV_PROXY_DUPLICATE:
+                d->duplicated++;
+                break;
+            case EV_PROXY_RATE_DROP:
+                d->rate_drops++;
+                break;
+            case EV_PROXY_CORRUPT:
+                d->corrupted++;
+                break;
+            case EV_PROXY_CRC_DROP:
+                d->crc_drops++;
+                break;
+            case EV_PROXY_DELAY:
+                d->delayed++;
+                d->delay_sum += r[i].extra;
+                if (r[i].extra < d->delay_min) d->delay_min = r[i].extra;
+                if (r[i].extra > d->delay_max) d->delay_max = r[i].extra;
+                break;
+        }
+    }
+}
+
+static void print_client(const ClientStats *s) {
+    printf("CLIENT STATISTICS:\n");
+    printf("----------------------------------------------------------------------\n");
+    printf("Unique messages sent:     %llu\n", (unsigned long long)s->seqs.distinct);
+    printf("Total transmissions:      %llu\n", (unsigned long long)s->sent);
+    printf("Successful ACKs:          %llu\n", (unsigned long long)s->acked);
+    printf("Failed messages:          %llu\n", (unsigned long long)s->failed);
+    printf("Timeouts:                 %llu\n", (unsigned long long)s->timeouts);
+    if (s->seqs.distinct > 0) {
+        printf("Success rate:             %.1f%%\n",
+               (double)s->acked / (double)s->seqs.distinct * 100.0);
+    }
+    if (s->sent > 0) {
+        printf("Retransmission rate:      %.2f%%\n",
+               (double)s->retransmissions / (double)s->sent * 100.0);
+    }
+    if (s->acked > 0) {
+        printf("Mean RTT:                 %.3fms\n", (double)s->rtt_us_sum / (double)s->acked / 1e3);
+        printf("RTT p50/p90/p99/max:      %.3f/%.3f/%.3f/%.3fms\n",
+               (double)histogram_percentile(&s->rtt_us, 50.0) / 1e3,
+               (double)histogram_percentile(&s->rtt_us, 90.0) / 1e3,
+               (double)histogram_percentile(&s->rtt_us, 99.0) / 1e3,
+               (double)s->rtt_us.max / 1e3);
+    }
+
+    uint64_t max_count = 0;
+    for (int a = 0; a <= ANALYZE_MAX_ATTEMPTS; a++) {
+        if (s->timeouts_by_attempt[a] > max_count) max_count = s->timeouts_by_attempt[a];
+    }
+    if (max_count > 0) {
+        printf("\nRetransmission attempts:\n");
+        for (int a = 0; a <= ANALYZE_MAX_ATTEMPTS; a++) {
+            if (s->timeouts_by_attempt[a] == 0) continue;
+            char label[32];
+            snprintf(label, sizeof(label), "  Attempt %d%s", a, a == ANALYZE_MAX_ATTEMPTS ? "+" : "");
+            print_bar_chart(label, s->timeouts_by_attempt[a], max_count);
+        }
+    }
+    printf("\n");
+}
+
+// Payload bits per second accepted for the first time, first arrival to last
+static double server_goodput_mbps(const ServerStats *s) {
+    if (s->last_ns <= s->first_ns) {
+        return 0.0;
+    }
+    return (double)(s->bytes - s->duplicate_bytes) * 8.0 / (double)(s->last_ns - s->first_ns) * 1e3;
+}
+
+static void print_server(const ServerStats *s) {
+    printf("SERVER STATISTICS:\n");
+    printf("----------------------------------------------------------------------\n");
+    printf("Messages received:        %llu\n", (unsigned long long)s->received);
+    printf("Unique sequences:         %llu\n", (unsigned long long)s->seqs.distinct);
+    printf("Duplicates:               %llu\n", (unsigned long long)s->duplicates);
+    printf("ACKs sent:                %llu\n", (unsigned long long)s->acks_sent);
+    if (s->sacks_sent > 0) {
+        printf("SACKs sent:               %llu\n", (unsigned long long)s->sacks_sent);
+    }
+    printf("Payload delivered:        %llu bytes\n",
+           (unsigned long long)(s->bytes - s->duplicate_bytes));
+    if (s->last_ns > s->first_ns) {
+        printf("Goodput:                  %.2f Mbit/s over %.3fs\n", server_goodput_mbps(s),
+               (double)(s->last_ns - s->first_ns) / 1e9);
+    }
+    printf("\n");
+}
+
+static void print_proxy_dir(const char *label, const ProxyDirStats *d) {
+    printf("%-26s%llu\n", label, (unsigned long long)d->received);
+    printf("  Dropped:                %llu\n", (unsigned long long)d->dropped);
+    printf("  Delayed:                %llu\n", (unsigned long long)d->delayed);
+    if (d->queue_full > 0) {
+        printf("  Delay queue full:       %llu\n", (unsigned long long)d->queue_full);
+    }
+    if (d->rate_drops > 0) {
+        printf("  Rate queue full:        %llu\n", (unsigned long long)d->rate_drops);
+    }
+    if (d->reordered > 0) {
+        printf("  Reordered:              %llu\n", (unsigned long long)d->reordered);
+    }
+    if (d->duplicated > 0) {
+        printf("  Duplicated:             %llu\n", (unsigned long long)d->duplicated);
+    }
+    if (d->corrupted > 0) {
+        printf("  Corrupted:              %llu\n", (unsigned long long)d->corrupted);
+    }
+    if (d->crc_drops > 0) {
+        printf("  Bad checksum:           %llu\n", (unsigned long long)d->crc_drops);
+    }
+    if (d->received > 0) {
+        printf("  Drop rate:              %.1f%%\n", (double)d->dropped / (double)d->received * 100.0);
+    }
+    if (d->delayed > 0) {
+        printf("  Delay range:            %u-%ums (avg: %.1fms)\n", d->delay_min, d->delay_max,
+               (double)d->delay_sum / (double)d->delayed);
+    }
+}
+
+static void print_proxy(const ProxyDirStats s[2]) {
+    printf("PROXY STATISTICS:\n");
+    printf("----------------------------------------------------------------------\n");
+    print_proxy_dir("Client->Server packets:", &s[0]);
+    printf("\n");
+    print_proxy_dir("Server->Client packets:", &s[1]);
+    printf("\n");
+}
+
+static void json_client(const ClientStats *s) {
+    printf("    \"client\": {\"unique_sent\": %llu, \"transmissions\": %llu, "
+           "\"retransmissions\": %llu, \"retransmit_rate\": %.6f, \"acked\": %llu, "
+           "\"failed\": %llu, \"timeouts\": %llu,\n",
+           (unsigned long long)s->seqs.distinct, (unsigned long long)s->sent,
+           (unsigned long long)s->retransmissions,
+           s->sent ? (double)s->retransmissions / (double)s->sent : 0.0,
+           (unsigned long long)s->acked, (unsigned long long)s->failed,
+           (unsigned long long)s->timeouts);
+    printf("               \"rtt_ms\": {\"mean\": %.3f, \"p50\": %.3f, \"p90\": %.3f, "
+           "\"p99\": %.3f, \"p999\": %.3f, \"max\": %.3f}},\n",
+           s->acked ? (double)s->rtt_us_sum / (double)s->acked / 1e3 : 0.0,
+           (double)histogram_percentile(&s->rtt_us, 50.0) / 1e3,
+           (double)histogram_percentile(&s->rtt_us, 90.0) / 1e3,
+           (double)histogram_percentile(&s->rtt_us, 99.0) / 1e3,
+           (double)histogram_percentile(&s->rtt_us, 99.9) / 1e3,
+           (double)s->rtt_us.max / 1e3);
+}
+
+static void json_server(const ServerStats *s) {
+    printf("    \"server\": {\"received\": %llu, \"unique\": %llu, \"duplicates\": %llu, "
+           "\"acks_sent\": %llu, \"sacks_sent\": %llu, \"bytes_delivered\": %llu, "
+           "\"seconds\": %.6f, \"goodput_mbps\": %.3f},\n",
+           (unsigned long long)s->received, (unsigned long long)s->seqs.distinct,
+           (unsigned long long)s->duplicates, (unsigned long long)s->acks_sent,
+           (unsigned long long)s->sacks_sent, (unsigned long long)(s->bytes - s->duplicate_bytes),
+           s->last_ns > s->first_ns ? (double)(s->last_ns - s->first_ns) / 1e9 : 0.0,
+           server_goodput_mbps(s));
+}
+
+static void json_proxy_dir(const char *name, const ProxyDirStats *d, const char *end) {
+    printf("\"%s\": {\"received\": %llu, \"dropped\": %llu, \"delayed\": %llu, "
+           "\"delay_avg_ms\": %.3f, \"reordered\": %llu, \"duplicated\": %llu, "
+           "\"corrupted\": %llu, \"queue_drops\": %llu}%s",
+           name, (unsigned long long)d->received, (unsigned long long)d->dropped,
+           (unsigned long long)d->delayed,
+           d->delayed ? (double)d->delay_sum / (double)d->delayed : 0.0,
+           (unsigned long long)d->reordered, (unsigned long long)d->duplicated,
+           (unsigned long long)d->corrupted,
+           (unsigned long long)(d->queue_full + d->rate_drops), end);
+}
+
+// One element of the "tests" array; names come from file names, which
+// are assumed not to need JSON escaping
+static void json_test_set(const TestSet *set, int last) {
+    ClientStats client;
+    ServerStats server;
+    int have_client = 0, have_server = 0;
+
+    printf("  {\"name\": \"%s\",\n", set->name);
+    for (int slot = 0; slot < 3; slot++) {
+        if (!set->files[slot]) continue;
+
+        int role;
+        size_t count, map_len;
+        void *map;
+        const EventRecord *records = map_event_log(set->files[slot], &role, &count, &map, &map_len);
+        if (!records) continue;
+
+        if (role == EVLOG_ROLE_CLIENT) {
+            analyze_client(records, count, &client);
+            json_client(&client);
+            have_client = 1;
+        } else if (role == EVLOG_ROLE_SERVER) {
+            analyze_server(records, count, &server);
+            json_server(&server);
+            have_server = 1;
+        } else if (role == EVLOG_ROLE_PROXY) {
+            ProxyDirStats proxy[2];
+            analyze_proxy(records, count, proxy);
+            printf("    \"proxy\": {");
+            json_proxy_dir("client_to_server", &proxy[0], ",\n              ");
+            json_proxy_dir("server_to_client", &proxy[1], "},\n");
+        }
+        munmap(map, map_len);
+    }
+
+    double delivery = have_client && have_server && client.seqs.distinct > 0 ?
+                      (double)server.seqs.distinct / (double)client.seqs.distinct : 0.0;
+    printf("    \"delivery_rate\": %.6f}%s\n", delivery, last ? "" : ",");
+
+    if (have_client) free(client.seqs.words);
+    if (have_server) free(server.seqs.words);
+}
+
+static void analyze_test_set(const TestSet *set) {
+    static const char rule[] = "======================================================================";
+    printf("%s\nTEST: %s\n%s\n\n", rule, set->name, rule);
+
+    ClientStats client;
+    ServerStats server;
+    int have_client = 0, have_server = 0;
+
+    for (int slot = 0; slot < 3; slot++) {
+        if (!set->files[slot]) continue;
+
+        int role;
+        size_t count, map_len;
+        void *map;
+        const EventRecord *records = map_event_log(set->files[slot], &role, &count, &map, &map_len);
+        if (!records) continue;
+
+        if (role == EVLOG_ROLE_CLIENT) {
+            analyze_client(records, count, &client);
+            print_client(&client);
+            have_client = 1;
+        } else if (role == EVLOG_ROLE_SERVER) {
+            analyze_server(records, count, &server);
+            print_server(&server);
+            have_server = 1;
+        } else if (role == EVLOG_ROLE_PROXY) {
+            ProxyDirStats proxy[2];
+            analyze_proxy(records, count, proxy);
+            print_proxy(proxy);
+        }
+        munmap(map, map_len);
+    }
+
+    printf("%s\n", rule);
+    if (have_client && have_server) {
+        printf("OVERALL: %llu/%llu messages delivered successfully\n",
+               (unsigned long long)server.seqs.distinct, (unsigned long long)client.seqs.distinct);
+        if (client.seqs.distinct > 0) {
+            printf("Delivery rate: %.1f%%\n",
+                   (double)server.seqs.distinct / (double)client.seqs.distinct * 100.0);
+        }
+    }
+    printf("%s\n\n", rule);
+
+    if (have_client) free(client.seqs.words);
+    if (have_server) free(server.seqs.words);
+}
+
+// "5DropClient.evt" -> test "5Drop", slot 0; files without a role suffix form their own set
+static void add_file(TestSet *sets, int *set_count, const char *path, int slot) {
+    static const char *suffixes[] = { "Client.evt", "Server.evt", "Proxy.evt" };
+    char name[256];
+    snprintf(name, sizeof(name), "%s", path);
+
+    if (slot >= 0) {
+        size_t len = strlen(name), suffix_len = strlen(suffixes[slot]);
+        name[len - suffix_len] = '\0';
+        if (name[0] == '\0') snprintf(name, sizeof(name), "default");
+    } else {
+        slot = 0;
+    }
+
+    for (int i = 0; i < *set_count; i++) {
+        if (strcmp(sets[i].name, name) == 0 && !sets[i].files[slot]) {
+            sets[i].files[slot] = path;
+            return;
+        }
+    }
+    if (*set_count == ANALYZE_MAX_SETS) {
+        fprintf(stderr, "Warning: more than %d test sets, ignoring %s\n", ANALYZE_MAX_SETS, path);
+        return;
+    }
+    TestSet *set = &sets[(*set_count)++];
+    memset(set, 0, sizeof(*set));
+    snprintf(set->name, sizeof(set->name), "%s", name);
+    set->files[slot] = path;
+}
+
+static int suffix_slot(const char *path) {
+    static const char *suffixes[] = { "Client.evt", "Server.evt", "Proxy.evt" };
+    size_t len = strlen(path);
+    for (int i = 0; i < 3; i++) {
+        size_t suffix_len = strlen(suffixes[i]);
+        if (len >= suffix_len && strcmp(path + len - suffix_len, suffixes[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Tests from the README's suite first, in suite order, then alphabetically
+static int test_rank(const char *name) {
+    static const char *preferred[] = {
+        "NoProxy", "PerfectNetwork", "5Drop", "10Drop", "50Delay", "100Delay", "50Drop50Delay"
+    };
+    for (int i = 0; i < (int)(sizeof(preferred) / sizeof(preferred[0])); i++) {
+        if (strcmp(name, preferred[i]) == 0) {
+            return i;
+        }
+    }
+    return (int)(sizeof(preferred) / sizeof(preferred[0]));
+}
+
+static int compare_sets(const void *a, const void *b) {
+    const TestSet *x = a, *y = b;
+    int rx = test_rank(x->name), ry = test_rank(y->name);
+    return rx != ry ? rx - ry : strcmp(x->name, y->name);
+}
+
+int main(int argc, char *argv[]) {
+    static TestSet sets[ANALYZE_MAX_SETS];
+    int set_count = 0;
+    glob_t found;
+    memset(&found, 0, sizeof(found));
+
+    int json = 0;
+    int first_file = 1;
+    if (argc > 1 && strcmp(argv[1], "--json") == 0) {
+        json = 1;
+        first_file = 2;
+    }
+
+    if (argc > first_file) {
+        for (int i = first_file; i < argc; i++) {
+            add_file(sets, &set_count, argv[i], suffix_slot(argv[i]));
+        }
+    } else {
+        glob("*Client.evt", 0, NULL, &found);
+        glob("*Server.evt", GLOB_APPEND, NULL, &found);
+        glob("*Proxy.evt", GLOB_APPEND, NULL, &found);
+        for (size_t i = 0; i < found.gl_pathc; i++) {
+            add_file(sets, &set_count, found.gl_pathv[i], suffix_slot(found.gl_pathv[i]));
+        }
+    }
+
+    if (set_count == 0) {
+        printf("No event logs found matching patterns: *Client.evt, *Server.evt, *Proxy.evt\n");
+        printf("Record them with --event-log, e.g. --event-log 5DropClient.evt\n");
+        printf("Usage: %s [--json] [event-log ...]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    qsort(sets, (size_t)set_count, sizeof(sets[0]), compare_sets);
+
+    if (json) {
+        printf("{\"tests\": [\n");
+        for (int i = 0; i < set_count; i++) {
+            json_test_set(&sets[i], i + 1 == set_count);
+        }
+        printf("]}\n");
+        globfree(&found);
+        return EXIT_SUCCESS;
+    }
+
+    printf("======================================================================\n");
+    printf("UDP RELIABLE MESSAGING - EVENT LOG ANALYSIS\n");
+    printf("======================================================================\n\n");
+
+    for (int i = 0; i < set_count; i++) {
+        analyze_test_set(&sets[i]);
+    }
+
+    globfree(&found);
+    return EXIT_SUCCESS;
+}
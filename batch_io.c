@@ -0,0 +1,270 @@
+#define _GNU_SOURCE
+#include "batch_io.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <netinet/in.h>
+#ifdef __linux__
+#include <netinet/udp.h>
+#endif
+
+#if defined(__linux__) && defined(MSG_WAITFORONE)
+#define HAVE_MMSG 1
+#endif
+
+#ifdef HAVE_MMSG
+// Room for the UDP_GRO segment size and the SO_RXQ_OVFL counter
+#define UDP_BATCH_CONTROL_SIZE (CMSG_SPACE(sizeof(int)) + CMSG_SPACE(sizeof(uint32_t)))
+
+// Cleared the first time the kernel reports ENOSYS
+static int mmsg_supported = 1;
+#endif
+
+int udp_batch_init(UdpBatch *batch, int capacity, size_t buf_size) {
+    memset(batch, 0, sizeof(*batch));
+    if (capacity <= 0 || capacity > UDP_BATCH_MAX) {
+        return -1;
+    }
+
+    batch->data = malloc((size_t)capacity * buf_size);
+    batch->len = calloc((size_t)capacity, sizeof(size_t));
+    batch->addr = calloc((size_t)capacity, sizeof(struct sockaddr_in));
+    batch->addr_len = calloc((size_t)capacity, sizeof(socklen_t));
+    batch->iov = calloc((size_t)capacity, sizeof(struct iovec));
+    batch->segment = calloc((size_t)capacity, sizeof(uint16_t));
+#ifdef HAVE_MMSG
+    batch->msgs = calloc((size_t)capacity, sizeof(struct mmsghdr));
+    batch->control = calloc((size_t)capacity, UDP_BATCH_CONTROL_SIZE);
+#endif
+    if (!batch->data || !batch->len || !batch->addr || !batch->addr_len || !batch->iov ||
+        !batch->segment
+#ifdef HAVE_MMSG
+        || !batch->msgs || !batch->control
+#endif
+        ) {
+        udp_batch_destroy(batch);
+        return -1;
+    }
+
+    batch->capacity = capacity;
+    batch->buf_size = buf_size;
+    return 0;
+}
+
+void udp_batch_destroy(UdpBatch *batch) {
+    free(batch->data);
+    free(batch->len);
+    free(batch->addr);
+    free(batch->addr_len);
+    free(batch->iov);
+    free(batch->msgs);
+    free(batch->control);
+    free(batch->segment);
+    memset(batch, 0, sizeof(*batch));
+}
+
+uint8_t *udp_batch_buffer(UdpBatch *batch, int i) {
+    return batch->data + (size_t)i * batch->buf_size;
+}
+
+// Slot to serialize the next outgoing datagram into, or NULL when full
+uint8_t *udp_batch_next(UdpBatch *batch) {
+    if (batch->count >= batch->capacity) {
+        return NULL;
+    }
+    return udp_batch_buffer(batch, batch->count);
+}
+
+void udp_batch_commit(UdpBatch *batch, size_t len, const struct sockaddr_in *addr, socklen_t addr_len) {
+    int i = batch->count++;
+    batch->len[i] = len;
+    batch->addr[i] = *addr;
+    batch->addr_len[i] = addr_len;
+}
+
+int udp_batch_add(UdpBatch *batch, const uint8_t *data, size_t len,
+                  const struct sockaddr_in *addr, socklen_t addr_len) {
+    uint8_t *slot = udp_batch_next(batch);
+    if (!slot || len > batch->buf_size) {
+        return -1;
+    }
+    memcpy(slot, data, len);
+    udp_batch_commit(batch, len, addr, addr_len);
+    return 0;
+}
+
+#ifdef HAVE_MMSG
+// Pick up the GRO segment size and the socket's drop counter, if present
+static void parse_control(UdpBatch *batch, int i, struct msghdr *hdr) {
+    batch->segment[i] = 0;
+    for (struct cmsghdr *c = CMSG_FIRSTHDR(hdr); c; c = CMSG_NXTHDR(hdr, c)) {
+#ifdef UDP_GRO
+        if (c->cmsg_level == IPPROTO_UDP && c->cmsg_type == UDP_GRO) {
+            int seg;
+            memcpy(&seg, CMSG_DATA(c), sizeof(seg));
+            batch->segment[i] = (uint16_t)seg;
+        }
+#endif
+#ifdef SO_RXQ_OVFL
+        if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SO_RXQ_OVFL) {
+            uint32_t dropped;
+            memcpy(&dropped, CMSG_DATA(c), sizeof(dropped));
+            if ((int32_t)(dropped - batch->overflow) > 0) {
+                batch->overflow = dropped;
+            }
+        }
+#endif
+    }
+}
+#endif
+
+// Receive whatever is queued on a socket, up to the batch capacity, without
+// blocking. Returns the number of datagrams, or -1 on a real error.
+int udp_recv_batch(int sockfd, UdpBatch *batch) {
+    batch->count = 0;
+    batch->overflow = 0;
+
+#ifdef HAVE_MMSG
+    if (mmsg_supported) {
+        struct mmsghdr *msgs = batch->msgs;
+        for (int i = 0; i < batch->capacity; i++) {
+            batch->iov[i].iov_base = udp_batch_buffer(batch, i);
+            batch->iov[i].iov_len = batch->buf_size;
+            memset(&msgs[i], 0, sizeof(msgs[i]));
+            msgs[i].msg_hdr.msg_iov = &batch->iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_name = &batch->addr[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(batch->addr[i]);
+            msgs[i].msg_hdr.msg_control = batch->control + (size_t)i * UDP_BATCH_CONTROL_SIZE;
+            msgs[i].msg_hdr.msg_controllen = UDP_BATCH_CONTROL_SIZE;
+        }
+
+        int n = recvmmsg(sockfd, msgs, (unsigned int)batch->capacity, MSG_DONTWAIT, NULL);
+        if (n >= 0) {
+            for (int i = 0; i < n; i++) {
+                batch->len[i] = msgs[i].msg_len;
+                batch->addr_len[i] = msgs[i].msg_hdr.msg_namelen;
+                parse_control(batch, i, &msgs[i].msg_hdr);
+            }
+            batch->count = n;
+            return n;
+        }
+        if (errno != ENOSYS) {
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+        }
+        mmsg_supported = 0;
+    }
+#endif
+
+    // Portable fallback: one recvfrom() per datagram until the socket is empty
+    while (batch->count < batch->capacity) {
+        int i = batch->count;
+        batch->addr_len[i] = sizeof(batch->addr[i]);
+        ssize_t n = recvfrom(sockfd, udp_batch_buffer(batch, i), batch->buf_size, MSG_DONTWAIT,
+                             (struct sockaddr *)&batch->addr[i], &batch->addr_len[i]);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return batch->count > 0 ? batch->count : -1;
+        }
+        batch->len[i] = (size_t)n;
+        batch->segment[i] = 0;
+        batch->count++;
+    }
+    return batch->count;
+}
+
+// Send every queued datagram and empty the batch. Returns how many were
+// handed to the kernel; the rest (if any) hit a send error.
+int udp_send_batch(int sockfd, UdpBatch *batch) {
+    int sent = 0;
+
+#ifdef HAVE_MMSG
+    if (mmsg_supported && batch->count > 0) {
+        struct mmsghdr *msgs = batch->msgs;
+        for (int i = 0; i < batch->count; i++) {
+            batch->iov[i].iov_base = udp_batch_buffer(batch, i);
+            batch->iov[i].iov_len = batch->len[i];
+            memset(&msgs[i], 0, sizeof(msgs[i]));
+            msgs[i].msg_hdr.msg_iov = &batch->iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_name = &batch->addr[i];
+            msgs[i].msg_hdr.msg_namelen = batch->addr_len[i];
+        }
+
+        while (sent < batch->count) {
+            int n = sendmmsg(sockfd, msgs + sent, (unsigned int)(batch->count - sent), 0);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                if (errno == ENOSYS && sent == 0) {
+                    mmsg_supported = 0;
+                }
+                break;
+            }
+            sent += n;
+        }
+
+        if (mmsg_supported) {
+            batch->count = 0;
+            return sent;
+        }
+    }
+#endif
+
+    for (; sent < batch->count; sent++) {
+        ssize_t n = sendto(sockfd, udp_batch_buffer(batch, sent), batch->len[sent], 0,
+                           (struct sockaddr *)&batch->addr[sent], batch->addr_len[sent]);
+        if (n < 0) {
+            break;
+        }
+    }
+    batch->count = 0;
+    return sent;
+}
+
+// Send the listed slots, in that order, leaving the batch as it is for the
+// caller to empty. Returns how many went out before the first send error.
+int udp_send_slots(int sockfd, UdpBatch *batch, const int *slots, int count) {
+    int sent = 0;
+
+#ifdef HAVE_MMSG
+    if (mmsg_supported && count > 0) {
+        struct mmsghdr *msgs = batch->msgs;
+        for (int k = 0; k < count; k++) {
+            int i = slots[k];
+            batch->iov[k].iov_base = udp_batch_buffer(batch, i);
+            batch->iov[k].iov_len = batch->len[i];
+            memset(&msgs[k], 0, sizeof(msgs[k]));
+            msgs[k].msg_hdr.msg_iov = &batch->iov[k];
+            msgs[k].msg_hdr.msg_iovlen = 1;
+            msgs[k].msg_hdr.msg_name = &batch->addr[i];
+            msgs[k].msg_hdr.msg_namelen = batch->addr_len[i];
+        }
+
+        while (sent < count) {
+            int n = sendmmsg(sockfd, msgs + sent, (unsigned int)(count - sent), 0);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                if (errno == ENOSYS && sent == 0) {
+                    mmsg_supported = 0;
+                }
+                break;
+            }
+            sent += n;
+        }
+
+        if (mmsg_supported) {
+            return sent;
+        }
+    }
+#endif
+
+    for (; sent < count; sent++) {
+        int i = slots[sent];
+        ssize_t n = sendto(sockfd, udp_batch_buffer(batch, i), batch->len[i], 0,
+                           (struct sockaddr *)&batch->addr[i], batch->addr_len[i]);
+        if (n < 0) {
+            break;
+        }
+    }
+    return sent;
+}
@@ -0,0 +1,60 @@
+#ifndef COMP7005PROJ1_BATCH_IO_H
+#define COMP7005PROJ1_BATCH_IO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+
+#define UDP_BATCH_MAX 64
+#define UDP_BATCH_DEFAULT 32
+
+// A set of datagrams moved with one recvmmsg()/sendmmsg() call
+typedef struct {
+    int capacity;
+    int count;
+    size_t buf_size;
+    uint8_t *data;            // capacity * buf_size bytes, one slot per datagram
+    size_t *len;
+    struct sockaddr_in *addr;
+    socklen_t *addr_len;
+    struct iovec *iov;
+    void *msgs;               // struct mmsghdr[], when the platform has it
+    uint8_t *control;         // Per-slot ancillary data buffers for received datagrams
+    uint16_t *segment;        // UDP_GRO segment size of datagram i, 0 if it was not coalesced
+    uint32_t overflow;        // SO_RXQ_OVFL drop count from the last receive, 0 if none was reported
+} UdpBatch;
+
+// A coalesced datagram holds several wire datagrams of segment[i] bytes
+// back to back; this is the length of the one starting at offset
+static inline size_t udp_batch_segment_len(const UdpBatch *batch, int i, size_t offset) {
+    size_t left = batch->len[i] - offset;
+    size_t seg = batch->segment[i];
+    return seg > 0 && seg < left ? seg : left;
+}
+
+// Datagrams the kernel dropped on the socket since *seen was last updated.
+// SO_RXQ_OVFL counts per socket, so callers keep one *seen per socket.
+static inline uint32_t udp_batch_overflow(const UdpBatch *batch, uint32_t *seen) {
+    uint32_t dropped = batch->overflow - *seen;
+    if ((int32_t)dropped <= 0) {
+        return 0;
+    }
+    *seen = batch->overflow;
+    return dropped;
+}
+
+// Function prototypes
+int udp_batch_init(UdpBatch *batch, int capacity, size_t buf_size);
+void udp_batch_destroy(UdpBatch *batch);
+uint8_t *udp_batch_buffer(UdpBatch *batch, int i);
+uint8_t *udp_batch_next(UdpBatch *batch);
+void udp_batch_commit(UdpBatch *batch, size_t len, const struct sockaddr_in *addr, socklen_t addr_len);
+int udp_batch_add(UdpBatch *batch, const uint8_t *data, size_t len,
+                  const struct sockaddr_in *addr, socklen_t addr_len);
+int udp_recv_batch(int sockfd, UdpBatch *batch);
+int udp_send_batch(int sockfd, UdpBatch *batch);
+int udp_send_slots(int sockfd, UdpBatch *batch, const int *slots, int count);
+
+#endif //COMP7005PROJ1_BATCH_IO_H
@@ -0,0 +1,469 @@
+#include "bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <signal.h>
+
+static volatile int running = 1;
+static BenchThread *bench_threads;
+static int bench_thread_count;
+
+void sigint_handler(int sig) {
+    (void)sig;
+    running = 0;
+    for (int i = 0; i < bench_thread_count; i++) {
+        event_loop_wakeup(&bench_threads[i].loop);
+    }
+}
+
+void log_bench(FILE *log_fp, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    log_vwrite(LOG_LEVEL_INFO, log_fp, format, args);
+    va_end(args);
+}
+
+int parse_bench_args(int argc, char *argv[], BenchConfig *config) {
+    config->target_ip = NULL;
+    config->target_port = 0;
+    config->threads = 1;
+    config->flows = 1;
+    config->rate = 0.0;
+    config->payload = 64;
+    config->window = 16;
+    config->duration = 10.0;
+    config->timeout = 1.0;
+    config->min_rto = 0.2;
+    config->max_rto = 60.0;
+    config->max_retries = 5;
+    config->log_file = NULL;
+    log_config_default(&config->log);
+    config->log.level = LOG_LEVEL_INFO;
+    evlog_config_default(&config->events);
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--target-ip") == 0 && i + 1 < argc) {
+            config->target_ip = argv[++i];
+        } else if (strcmp(argv[i], "--target-port") == 0 && i + 1 < argc) {
+            config->target_port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            config->threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--flows") == 0 && i + 1 < argc) {
+            config->flows = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+            config->rate = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--payload") == 0 && i + 1 < argc) {
+            config->payload = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--window") == 0 && i + 1 < argc) {
+            config->window = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--duration") == 0 && i + 1 < argc) {
+            config->duration = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--timeout") == 0 && i + 1 < argc) {
+            config->timeout = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--min-rto") == 0 && i + 1 < argc) {
+            config->min_rto = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--max-rto") == 0 && i + 1 < argc) {
+            config->max_rto = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--max-retries") == 0 && i + 1 < argc) {
+            config->max_retries = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--log-file") == 0 && i + 1 < argc) {
+            config->log_file = argv[++i];
+        } else if (!log_parse_arg(argc, argv, &i, &config->log)) {
+            evlog_parse_arg(argc, argv, &i, &config->events);
+        }
+    }
+
+    // More threads than flows would leave some idle
+    if (config->threads > config->flows) {
+        config->threads = config->flows;
+    }
+
+    if (!config->target_ip || config->target_port == 0 ||
+        config->threads < 1 || config->threads > BENCH_MAX_THREADS || config->flows < 1 ||
+        config->rate < 0 || config->payload < 0 || config->payload > MAX_WIRE_PAYLOAD ||
+        config->window < 1 || config->window > MAX_WINDOW ||
+        config->duration <= 0 || config->timeout <= 0 || config->min_rto <= 0 || config->max_rto < config->min_rto ||
+        config->max_retries < 1 ||
+        !log_config_valid(&config->log)) {
+        fprintf(stderr, "Usage: %s --target-ip <ip> --target-port <port> [--threads <1-%d>] "
+                       "[--flows <n>] [--rate <msgs/s per flow>] [--payload <0-%d>] "
+                       "[--window <1-%d>] [--duration <sec>] [--timeout <sec>] "
+                       "[--min-rto <sec>] [--max-rto <sec>] [--max-retries <n>] [--log-file <file>] " LOG_USAGE " "
+                       EVLOG_USAGE "\n",
+                argv[0], BENCH_MAX_THREADS, MAX_WIRE_PAYLOAD, MAX_WINDOW);
+        return -1;
+    }
+
+    return 0;
+}
+
+// Same framing as the client: DATA up to MAX_PAYLOAD_SIZE, STREAM beyond it
+static void queue_frame(BenchThread *t, BenchFlow *flow, uint32_t seq_num) {
+    uint8_t *frame = udp_batch_next(&t->tx);
+    if (!frame) {
+        udp_send_batch(flow->sockfd, &t->tx);
+        frame = udp_batch_next(&t->tx);
+    }
+
+    size_t len = (size_t)t->config->payload;
+    uint8_t type = len > MAX_PAYLOAD_SIZE ? MSG_TYPE_STREAM : MSG_TYPE_DATA;
+    memset(frame + MESSAGE_HEADER_SIZE, 'a' + (int)(seq_num % 26), len);
+    size_t frame_len = message_write_header(frame, type, seq_num, (uint16_t)len);
+    udp_batch_commit(&t->tx, frame_len, t->target, sizeof(*t->target));
+}
+
+static void ack_slot(BenchThread *t, BenchFlow *flow, BenchSlot *slot, uint64_t now) {
+    histogram_record(&t->latency, now - slot->first_sent_ns);
+    evlog_emit_flow(flow->id, EV_ACK_RECV, 0, slot->seq_num, (uint16_t)slot->attempts, 0,
+               (uint32_t)((now - slot->first_sent_ns) / 1000));
+    if (slot->attempts == 1) {
+        rto_sample(&flow->rto, (double)(now - slot->sent_ns) / 1e9);
+    }
+    slot->in_use = 0;
+    t->acked++;
+}
+
+static void on_flow_readable(EventSource *src, uint32_t events) {
+    BenchThread *t = src->ctx;
+    BenchFlow *flow = src->data;
+    uint32_t window = (uint32_t)t->config->window;
+    (void)events;
+
+    int n;
+    while ((n = udp_recv_batch(flow->sockfd, &t->rx)) > 0) {
+        uint64_t now = monotonic_ns();
+        for (int i = 0; i < n; i++) {
+            MessageView ack;
+            if (message_view_parse(udp_batch_buffer(&t->rx, i), t->rx.len[i], &ack) < 0) {
+                continue;
+            }
+
+            uint32_t cum_ack;
+            uint64_t sack_bitmap;
+            if (parse_sack_view(&ack, &cum_ack, &sack_bitmap) == 0) {
+                for (uint32_t seq = flow->base; seq != flow->next_seq; seq++) {
+                    BenchSlot *slot = &flow->slots[seq % window];
+                    if (slot->in_use && sack_covers(cum_ack, sack_bitmap, seq)) {
+                        ack_slot(t, flow, slot, now);
+                    }
+                }
+                continue;
+            }
+
+            BenchSlot *slot = &flow->slots[ack.seq_num % window];
+            if (ack.type == MSG_TYPE_ACK && slot->in_use && slot->seq_num == ack.seq_num) {
+                ack_slot(t, flow, slot, now);
+            }
+        }
+        if (n < t->rx.capacity) {
+            break;
+        }
+    }
+}
+
+// Retransmit what has timed out, top the window up at the configured
+// rate, and lower *deadline to the next time this flow needs attention
+static void service_flow(BenchThread *t, BenchFlow *flow, uint64_t now, uint64_t *deadline) {
+    const BenchConfig *config = t->config;
+    uint32_t window = (uint32_t)config->window;
+
+    for (uint32_t seq = flow->base; seq != flow->next_seq; seq++) {
+        BenchSlot *slot = &flow->slots[seq % window];
+        if (!slot->in_use) continue;
+
+        uint64_t due = slot->sent_ns + (uint64_t)(slot->rto * 1e9);
+        if (due <= now) {
+            evlog_emit_flow(flow->id, EV_TIMEOUT, 0, seq, (uint16_t)slot->attempts, 0, 0);
+            if (slot->attempts >= config->max_retries) {
+                evlog_emit_flow(flow->id, EV_FAILED, 0, seq, (uint16_t)slot->attempts, 0, 0);
+                slot->in_use = 0;
+                t->failed++;
+                continue;
+            }
+            slot->attempts++;
+            slot->sent_ns = now;
+            slot->rto = rto_clamp(&flow->rto, slot->rto * 2.0);
+            queue_frame(t, flow, seq);
+            evlog_emit_flow(flow->id, EV_SEND, 0, seq, (uint16_t)slot->attempts, (uint32_t)config->payload, 0);
+            t->retransmits++;
+            due = now + (uint64_t)(slot->rto * 1e9);
+        }
+        if (due < *deadline) *deadline = due;
+    }
+
+    while (flow->base != flow->next_seq && !flow->slots[flow->base % window].in_use) {
+        flow->base++;
+    }
+
+    uint64_t interval = config->rate > 0 ? (uint64_t)(1e9 / config->rate) : 0;
+    while (t->sending && flow->next_seq - flow->base < window && flow->next_send_ns <= now) {
+        BenchSlot *slot = &flow->slots[flow->next_seq % window];
+        slot->in_use = 1;
+        slot->seq_num = flow->next_seq;
+        slot->attempts = 1;
+        slot->first_sent_ns = slot->sent_ns = now;
+        slot->rto = flow->rto.rto;
+        queue_frame(t, flow, flow->next_seq);
+        evlog_emit_flow(flow->id, EV_SEND, 0, flow->next_seq++, 1, (uint32_t)config->payload, 0);
+        t->sent++;
+
+        // Fixed schedule, so latency is not hidden by sending less while slow
+        flow->next_send_ns += interval;
+    }
+    if (t->sending && interval > 0 && flow->next_seq - flow->base < window &&
+        flow->next_send_ns < *deadline) {
+        *deadline = flow->next_send_ns;
+    }
+
+    if (t->tx.count > 0) {
+        int queued = t->tx.count;
+        if (udp_send_batch(flow->sockfd, &t->tx) < queued) {
+            log_bench(t->log_fp, "ERROR: sendmmsg on flow socket failed: %s", strerror(errno));
+        }
+    }
+}
+
+static uint64_t count_in_flight(const BenchThread *t) {
+    uint64_t n = 0;
+    for (int i = 0; i < t->flow_count; i++) {
+        const BenchFlow *flow = &t->flows[i];
+        for (uint32_t seq = flow->base; seq != flow->next_seq; seq++) {
+            n += (uint64_t)flow->slots[seq % (uint32_t)t->config->window].in_use;
+        }
+    }
+    return n;
+}
+
+static void *bench_thread_main(void *arg) {
+    BenchThread *t = arg;
+    uint64_t start = monotonic_ns();
+    uint64_t stop_sending = start + (uint64_t)(t->config->duration * 1e9);
+    uint64_t give_up = stop_sending + BENCH_DRAIN_NS;
+
+    for (int i = 0; i < t->flow_count; i++) {
+        t->flows[i].next_send_ns = start;
+    }
+    t->sending = 1;
+
+    while (running) {
+        uint64_t now = monotonic_ns();
+        if (t->sending && now >= stop_sending) {
+            t->sending = 0;
+        }
+        if (!t->sending && (now >= give_up || count_in_flight(t) == 0)) {
+            break;
+        }
+
+        uint64_t deadline = t->sending ? stop_sending : give_up;
+        for (int i = 0; i < t->flow_count; i++) {
+            service_flow(t, &t->flows[i], now, &deadline);
+        }
+        if (event_loop_poll(&t->loop, deadline) < 0) {
+            log_bench(t->log_fp, "ERROR: thread %d event loop failed: %s", t->id, strerror(errno));
+            break;
+        }
+    }
+
+    t->elapsed_ns = monotonic_ns() - start;
+    t->unacked = count_in_flight(t);
+    evlog_thread_flush();
+    return NULL;
+}
+
+static int bench_thread_init(BenchThread *t, int id, BenchFlow *flows, int flow_count,
+                             const BenchConfig *config, const struct sockaddr_in *target,
+                             FILE *log_fp) {
+    memset(t, 0, sizeof(*t));
+    t->id = id;
+    t->config = config;
+    t->target = target;
+    t->flows = flows;
+    t->flow_count = flow_count;
+    t->log_fp = log_fp;
+    histogram_init(&t->latency);
+
+    if (event_loop_init(&t->loop) < 0 ||
+        udp_batch_init(&t->rx, UDP_BATCH_MAX, MAX_FRAME_SIZE) < 0 ||
+        udp_batch_init(&t->tx, UDP_BATCH_MAX, MAX_FRAME_SIZE) < 0) {
+        return -1;
+    }
+
+    for (int i = 0; i < flow_count; i++) {
+        BenchFlow *flow = &flows[i];
+        flow->thread = t;
+        rto_init(&flow->rto, config->timeout, config->min_rto, config->max_rto);
+        flow->sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (flow->sockfd < 0 ||
+            event_loop_add(&t->loop, &flow->src, flow->sockfd, on_flow_readable, t, flow) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void bench_thread_destroy(BenchThread *t) {
+    for (int i = 0; i < t->flow_count; i++) {
+        if (t->flows[i].sockfd >= 0) close(t->flows[i].sockfd);
+    }
+    event_loop_destroy(&t->loop);
+    udp_batch_destroy(&t->rx);
+    udp_batch_destroy(&t->tx);
+}
+
+static void report(const BenchConfig *config, BenchThread *threads, int count, FILE *log_fp) {
+    static Histogram latency;
+    histogram_init(&latency);
+
+    uint64_t sent = 0, acked = 0, retransmits = 0, failed = 0, unacked = 0, elapsed_ns = 0;
+    for (int i = 0; i < count; i++) {
+        histogram_merge(&latency, &threads[i].latency);
+        sent += threads[i].sent;
+        acked += threads[i].acked;
+        retransmits += threads[i].retransmits;
+        failed += threads[i].failed;
+        unacked += threads[i].unacked;
+        if (threads[i].elapsed_ns > elapsed_ns) elapsed_ns = threads[i].elapsed_ns;
+    }
+
+    double seconds = (double)elapsed_ns / 1e9;
+    double pps = seconds > 0 ? (double)acked / seconds : 0.0;
+    double mbps = pps * config->payload * 8.0 / 1e6;
+
+    printf("Flows: %d on %d threads, payload=%d bytes, window=%d, rate=%s\n",
+           config->flows, count, config->payload, config->window,
+           config->rate > 0 ? "paced" : "unlimited");
+    printf("Messages: sent=%llu, acked=%llu, retransmits=%llu, failed=%llu, unacked=%llu\n",
+           (unsigned long long)sent, (unsigned long long)acked,
+           (unsigned long long)retransmits, (unsigned long long)failed,
+           (unsigned long long)unacked);
+    printf("Throughput: %.0f msgs/s, %.2f Mbit/s goodput over %.3fs\n", pps, mbps, seconds);
+    printf("ACK latency (us): min=%.1f p50=%.1f p90=%.1f p99=%.1f p999=%.1f max=%.1f mean=%.1f\n",
+           latency.total ? (double)latency.min / 1e3 : 0.0,
+           (double)histogram_percentile(&latency, 50.0) / 1e3,
+           (double)histogram_percentile(&latency, 90.0) / 1e3,
+           (double)histogram_percentile(&latency, 99.0) / 1e3,
+           (double)histogram_percentile(&latency, 99.9) / 1e3,
+           (double)latency.max / 1e3, histogram_mean(&latency) / 1e3);
+
+    log_bench(log_fp, "BENCH RESULT: sent=%llu, acked=%llu, retransmits=%llu, failed=%llu, "
+             "msgs_per_sec=%.0f, p50_us=%.1f, p99_us=%.1f, p999_us=%.1f",
+             (unsigned long long)sent, (unsigned long long)acked,
+             (unsigned long long)retransmits, (unsigned long long)failed, pps,
+             (double)histogram_percentile(&latency, 50.0) / 1e3,
+             (double)histogram_percentile(&latency, 99.0) / 1e3,
+             (double)histogram_percentile(&latency, 99.9) / 1e3);
+}
+
+int main(int argc, char *argv[]) {
+    BenchConfig config;
+    FILE *log_fp = NULL;
+
+    if (parse_bench_args(argc, argv, &config) < 0) {
+        return EXIT_FAILURE;
+    }
+
+    if (config.log_file) {
+        log_fp = log_open_file(config.log_file);
+        if (!log_fp) {
+            fprintf(stderr, "Warning: Could not open log file %s\n", config.log_file);
+        }
+    }
+
+    if (log_init(&config.log) < 0) {
+        fprintf(stderr, "Warning: Could not start log writer, logging synchronously\n");
+    }
+
+    struct sockaddr_in target;
+    memset(&target, 0, sizeof(target));
+    target.sin_family = AF_INET;
+    target.sin_port = htons(config.target_port);
+    if (inet_pton(AF_INET, config.target_ip, &target.sin_addr) <= 0) {
+        log_bench(log_fp, "ERROR: Invalid target IP address");
+        log_shutdown();
+        if (log_fp) fclose(log_fp);
+        return EXIT_FAILURE;
+    }
+
+    if (evlog_open(&config.events, EVLOG_ROLE_CLIENT) < 0) {
+        log_bench(log_fp, "WARN: Could not open event log %s: %s",
+                 config.events.path, strerror(errno));
+    }
+
+    log_bench(log_fp, "BENCH STARTED: target=%s:%d, threads=%d, flows=%d, payload=%d, "
+             "window=%d, rate=%.1f/s per flow, duration=%.1fs",
+             config.target_ip, config.target_port, config.threads, config.flows,
+             config.payload, config.window, config.rate, config.duration);
+
+    BenchThread *threads = calloc((size_t)config.threads, sizeof(BenchThread));
+    BenchFlow *flows = calloc((size_t)config.flows, sizeof(BenchFlow));
+    if (!threads || !flows) {
+        log_bench(log_fp, "ERROR: Failed to allocate %d flows", config.flows);
+        free(threads);
+        free(flows);
+        evlog_close();
+        log_shutdown();
+        if (log_fp) fclose(log_fp);
+        return EXIT_FAILURE;
+    }
+    for (int i = 0; i < config.flows; i++) {
+        flows[i].sockfd = -1;
+        flows[i].id = (uint32_t)i;
+    }
+
+    // Flows are split as evenly as possible across threads
+    int ready = 0;
+    for (; ready < config.threads; ready++) {
+        int first = (int)((long)config.flows * ready / config.threads);
+        int last = (int)((long)config.flows * (ready + 1) / config.threads);
+        if (bench_thread_init(&threads[ready], ready, &flows[first], last - first,
+                              &config, &target, log_fp) < 0) {
+            log_bench(log_fp, "ERROR: Failed to set up thread %d: %s", ready, strerror(errno));
+            bench_thread_destroy(&threads[ready]);
+            break;
+        }
+    }
+    if (ready < config.threads) {
+        for (int i = 0; i < ready; i++) bench_thread_destroy(&threads[i]);
+        free(threads);
+        free(flows);
+        evlog_close();
+        log_shutdown();
+        if (log_fp) fclose(log_fp);
+        return EXIT_FAILURE;
+    }
+
+    bench_threads = threads;
+    bench_thread_count = config.threads;
+    signal(SIGINT, sigint_handler);
+
+    int started = 0;
+    for (; started < config.threads; started++) {
+        if (pthread_create(&threads[started].thread, NULL, bench_thread_main, &threads[started]) != 0) {
+            log_bench(log_fp, "ERROR: Failed to start thread %d", started);
+            running = 0;
+            for (int i = 0; i < started; i++) event_loop_wakeup(&threads[i].loop);
+            break;
+        }
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i].thread, NULL);
+    }
+
+    report(&config, threads, started, log_fp);
+    evlog_close();
+
+    bench_thread_count = 0;
+    for (int i = 0; i < config.threads; i++) {
+        bench_thread_destroy(&threads[i]);
+    }
+    free(threads);
+    free(flows);
+    log_shutdown();
+    if (log_fp) fclose(log_fp);
+
+    return started == config.threads ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,87 @@
+#ifndef COMP7005PROJ1_BENCH_H
+#define COMP7005PROJ1_BENCH_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <netinet/in.h>
+#include "protocol.h"
+#include "log.h"
+#include "batch_io.h"
+#include "event_loop.h"
+#include "histogram.h"
+#include "rto.h"
+#include "evlog.h"
+
+typedef struct {
+    char *target_ip;
+    int target_port;
+    int threads;
+    int flows;                 // Independent senders, each with its own socket and window
+    double rate;               // New messages per second per flow, 0 = as fast as the window allows
+    int payload;               // Bytes per message
+    int window;
+    double duration;           // Seconds of load before in-flight messages are drained
+    double timeout;            // Initial retransmission timeout
+    double min_rto;
+    double max_rto;
+    int max_retries;
+    char *log_file;
+    LogConfig log;
+    EventLogConfig events;     // Client-role events: sends, timeouts, ACK latency
+} BenchConfig;
+
+#define BENCH_MAX_THREADS 64
+#define BENCH_DRAIN_NS 2000000000ULL  // Longest wait for outstanding ACKs after the load phase
+
+// One unacknowledged message; its frame is rebuilt on retransmission
+typedef struct {
+    int in_use;
+    uint32_t seq_num;
+    int attempts;
+    uint64_t first_sent_ns;    // Latency is measured from here, retransmissions included
+    uint64_t sent_ns;
+    double rto;
+} BenchSlot;
+
+typedef struct BenchThread BenchThread;
+
+typedef struct {
+    int sockfd;
+    uint32_t id;               // Tags this flow's records in the event log
+    EventSource src;
+    BenchThread *thread;
+    BenchSlot slots[MAX_WINDOW];
+    uint32_t base;
+    uint32_t next_seq;
+    RtoEstimator rto;
+    uint64_t next_send_ns;     // Pacing: earliest time the next new message may go
+} BenchFlow;
+
+// One load-generating thread and the flows it drives
+struct BenchThread {
+    int id;
+    const BenchConfig *config;
+    const struct sockaddr_in *target;
+    BenchFlow *flows;
+    int flow_count;
+    EventLoop loop;
+    UdpBatch rx;
+    UdpBatch tx;
+    Histogram latency;         // Nanoseconds from first transmission to ACK
+    uint64_t sent;
+    uint64_t acked;
+    uint64_t retransmits;
+    uint64_t failed;
+    uint64_t unacked;          // Still in flight when the drain gave up
+    uint64_t elapsed_ns;
+    int sending;
+    pthread_t thread;
+    FILE *log_fp;
+};
+
+// Function prototypes
+int parse_bench_args(int argc, char *argv[], BenchConfig *config);
+void log_bench(FILE *log_fp, const char *format, ...);
+
+#endif //COMP7005PROJ1_BENCH_H
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include "client.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -9,29 +10,57 @@
 #include <stdarg.h>
 #include <time.h>
 #include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <poll.h>
+
+static Metric m_sent = METRIC_COUNTER_INIT("client_packets_sent_total",
+                                           "Frames sent, retransmissions included");
+static Metric m_retransmits = METRIC_COUNTER_INIT("client_retransmits_total",
+                                                  "Frames sent again after a timeout");
+static Metric m_timeouts = METRIC_COUNTER_INIT("client_timeouts_total",
+                                               "Retransmission timers that expired");
+static Metric m_acked = METRIC_COUNTER_INIT("client_messages_acked_total",
+                                            "Messages confirmed by the server");
+static Metric m_failed = METRIC_COUNTER_INIT("client_messages_failed_total",
+                                             "Messages abandoned after --max-retries attempts");
+static Metric m_bytes_acked = METRIC_COUNTER_INIT("client_payload_bytes_acked_total",
+                                                  "Payload bytes confirmed by the server");
+static Metric m_in_flight = METRIC_GAUGE_INIT("client_messages_in_flight",
+                                              "Messages sent and not yet acknowledged or abandoned");
+static Metric m_rto = METRIC_GAUGE_INIT("client_rto_microseconds",
+                                        "Current retransmission timeout estimate");
+static Metric m_fast_retransmits = METRIC_COUNTER_INIT("client_fast_retransmits_total",
+                                                       "Frames resent early because SACKs showed them missing");
+static Metric m_cwnd = METRIC_GAUGE_INIT("client_congestion_window",
+                                         "Messages the congestion window currently allows in flight");
+static Metric m_peer_window = METRIC_GAUGE_INIT("client_peer_window",
+                                                "Window the server last advertised, in messages");
+static Metric m_bad_acks = METRIC_COUNTER_INIT("client_checksum_failures_total",
+                                               "ACKs discarded because their CRC32C did not match");
+static Metric m_rtt = METRIC_HISTOGRAM_INIT("client_rtt_seconds",
+                                            "Round-trip time of messages acknowledged on the first attempt",
+                                            metrics_latency_bounds_ns, 1e-9);
+
+static Metric *const client_metrics[] = {
+    &m_sent, &m_retransmits, &m_timeouts, &m_acked, &m_failed, &m_bytes_acked,
+    &m_in_flight, &m_rto, &m_fast_retransmits, &m_cwnd, &m_peer_window, &m_bad_acks, &m_rtt
+};
+
+// Karn's rule: only unambiguous samples feed the estimator and the histogram
+static void record_rtt(RtoEstimator *rto, double rtt) {
+    rto_sample(rto, rtt);
+    metric_observe(&m_rtt, (uint64_t)(rtt * 1e9));
+    metric_set(&m_rto, (uint64_t)(rto->rto * 1e6));
+}
 
 void log_client(FILE *log_fp, const char *format, ...) {
     va_list args;
-    time_t now = time(NULL);
-    char timestamp[64];
-    strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", localtime(&now));
-
-    // Print to stderr
-    fprintf(stderr, "[%s] ", timestamp);
     va_start(args, format);
-    vfprintf(stderr, format, args);
+    log_vwrite(LOG_LEVEL_INFO, log_fp, format, args);
     va_end(args);
-    fprintf(stderr, "\n");
-
-    // Print to log file if provided
-    if (log_fp) {
-        fprintf(log_fp, "[%s] ", timestamp);
-        va_start(args, format);
-        vfprintf(log_fp, format, args);
-        va_end(args);
-        fprintf(log_fp, "\n");
-        fflush(log_fp);
-    }
 }
 
 int parse_client_args(int argc, char *argv[], ClientConfig *config) {
@@ -39,8 +68,23 @@ int parse_client_args(int argc, char *argv[], ClientConfig *config) {
     config->target_ip = NULL;
     config->target_port = 0;
     config->timeout = 2.0;
+    config->min_rto = 0.2;
+    config->max_rto = 60.0;
     config->max_retries = 5;
+    config->window = 0;
+    config->streams = 1;
+    config->cc = CC_AIMD;
+    config->pacing = 1;
+    config->file = NULL;
+    config->binary = 0;
+    config->crc = 0;
+    config->mtu = LINK_MTU;
+    config->resume = NULL;
     config->log_file = NULL;
+    sockopt_config_default(&config->sock);
+    log_config_default(&config->log);
+    metrics_config_default(&config->metrics);
+    evlog_config_default(&config->events);
 
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "--target-ip") == 0 && i + 1 < argc) {
@@ -49,64 +93,145 @@ int parse_client_args(int argc, char *argv[], ClientConfig *config) {
             config->target_port = atoi(argv[++i]);
         } else if (strcmp(argv[i], "--timeout") == 0 && i + 1 < argc) {
             config->timeout = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--min-rto") == 0 && i + 1 < argc) {
+            config->min_rto = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--max-rto") == 0 && i + 1 < argc) {
+            config->max_rto = atof(argv[++i]);
         } else if (strcmp(argv[i], "--max-retries") == 0 && i + 1 < argc) {
             config->max_retries = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--window") == 0 && i + 1 < argc) {
+            config->window = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--streams") == 0 && i + 1 < argc) {
+            config->streams = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--cc") == 0 && i + 1 < argc) {
+            const char *mode = argv[++i];
+            if (strcmp(mode, "aimd") == 0) {
+                config->cc = CC_AIMD;
+            } else if (strcmp(mode, "fixed") == 0) {
+                config->cc = CC_FIXED;
+            } else {
+                config->cc = -1;
+            }
+        } else if (strcmp(argv[i], "--no-pacing") == 0) {
+            config->pacing = 0;
+        } else if (strcmp(argv[i], "--file") == 0 && i + 1 < argc) {
+            config->file = argv[++i];
+        } else if (strcmp(argv[i], "--binary") == 0) {
+            config->binary = 1;
+        } else if (strcmp(argv[i], "--crc") == 0) {
+            config->crc = 1;
+        } else if (strcmp(argv[i], "--mtu") == 0 && i + 1 < argc) {
+            config->mtu = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--resume") == 0 && i + 1 < argc) {
+            config->resume = argv[++i];
+        } else if (strcmp(argv[i], "--gso") == 0) {
+            config->sock.gso = 1;
+        } else if (strcmp(argv[i], "--timestamps") == 0) {
+            config->sock.timestamps = 1;
         } else if (strcmp(argv[i], "--log-file") == 0 && i + 1 < argc) {
             config->log_file = argv[++i];
+        } else if (!sockopt_parse_arg(argc, argv, &i, &config->sock) &&
+                   !log_parse_arg(argc, argv, &i, &config->log) &&
+                   !metrics_parse_arg(argc, argv, &i, &config->metrics)) {
+            evlog_parse_arg(argc, argv, &i, &config->events);
         }
     }
 
-    if (!config->target_ip || config->target_port == 0) {
-        fprintf(stderr, "Usage: %s --target-ip <ip> --target-port <port> [--timeout <sec>] [--max-retries <n>] [--log-file <file>]\n", argv[0]);
+    // Bulk transfers default to a pipelined window; line mode to stop-and-wait
+    if (config->window == 0) {
+        config->window = (config->file || config->binary) ? CLIENT_BULK_WINDOW : 1;
+    }
+
+    if (!config->target_ip || config->target_port == 0 ||
+        config->window < 1 || config->window > MAX_WINDOW || config->cc < 0 ||
+        config->streams < 1 || config->streams > CLIENT_MAX_STREAMS ||
+        (config->streams > 1 && (config->file || config->binary)) ||
+        (config->resume && !config->file) ||
+        config->mtu < MIN_LINK_MTU || config->mtu > LINK_MTU ||
+        config->timeout <= 0 || config->min_rto <= 0 || config->max_rto < config->min_rto ||
+        !sockopt_config_valid(&config->sock) || !log_config_valid(&config->log) || !metrics_config_valid(&config->metrics)) {
+        fprintf(stderr, "Usage: %s --target-ip <ip> --target-port <port> [--timeout <sec>] "
+                       "[--min-rto <sec>] [--max-rto <sec>] [--max-retries <n>] "
+                       "[--window <1-%d>] [--cc <aimd|fixed>] [--no-pacing] "
+                       "[--file <path> [--resume <checkpoint>] | --binary | --streams <1-%d>] "
+                       "[--crc] [--mtu <%d-%d>] [--gso] [--timestamps] "
+                       SOCKOPT_USAGE " [--log-file <file>] " LOG_USAGE " " METRICS_USAGE " " EVLOG_USAGE "\n",
+                argv[0], MAX_WINDOW, CLIENT_MAX_STREAMS, MIN_LINK_MTU, LINK_MTU);
         return -1;
     }
 
     return 0;
 }
 
-int create_udp_socket(void) {
+int create_udp_socket(const SocketConfig *sock, FILE *log_fp) {
     int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
     if (sockfd < 0) {
         perror("socket");
         return -1;
     }
+    sockopt_apply(sockfd, sock, log_fp);
     return sockfd;
 }
 
-int send_message_with_retry(int sockfd, struct sockaddr_in *server_addr,
-                            const char *payload, uint32_t seq_num,
-                            const ClientConfig *config, FILE *log_fp) {
-    Message msg, ack;
-    uint8_t buffer[1024];
+static double elapsed_since(const struct timespec *start, const struct timespec *now) {
+    return (double)(now->tv_sec - start->tv_sec) +
+           (double)(now->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// Trace a transmission; the frame is decoded only when tracing is on
+static void log_send(FILE *log_fp, const uint8_t *frame, size_t frame_len, int attempt) {
+    MessageView view;
+    FragmentView frag;
+
+    if (!log_trace_enabled() || message_view_parse(frame, frame_len, &view) < 0) {
+        return;
+    }
+    if (view.type == MSG_TYPE_STREAM) {
+        log_trace(log_fp, "SEND: seq=%u, attempt=%d, stream=%u bytes",
+                  view.seq_num, attempt, (unsigned)view.payload_len);
+    } else if (fragment_view_parse(&view, &frag) == 0) {
+        log_trace(log_fp, "SEND: seq=%u, attempt=%d, frag=%u/%u, msg=%u",
+                  view.seq_num, attempt, (unsigned)frag.index + 1, (unsigned)frag.count,
+                  frag.msg_id);
+    } else {
+        log_trace(log_fp, "SEND: seq=%u, attempt=%d, payload=\"%.*s\"",
+                  view.seq_num, attempt, (int)view.payload_len, (const char *)view.payload);
+    }
+}
+
+int send_frame_with_retry(int sockfd, struct sockaddr_in *server_addr,
+                          const uint8_t *frame, size_t msg_len, uint32_t seq_num, uint16_t flow,
+                          const ClientConfig *config, RtoEstimator *rto, FILE *log_fp) {
+    struct timespec sent_at, now;
+    uint8_t buffer[CONTROL_FRAME_SIZE];
     int attempts = 0;
     struct timeval tv;
     fd_set readfds;
 
-    create_data_message(&msg, seq_num, payload);
-
     while (attempts < config->max_retries) {
-        // Serialize and send message
-        int msg_len = serialize_message(&msg, buffer, sizeof(buffer));
-        if (msg_len < 0) {
-            log_client(log_fp, "ERROR: Failed to serialize message");
-            return -1;
-        }
-
-        ssize_t sent = sendto(sockfd, buffer, msg_len, 0,
+        ssize_t sent = sendto(sockfd, frame, msg_len, 0,
                              (struct sockaddr *)server_addr, sizeof(*server_addr));
         if (sent < 0) {
             log_client(log_fp, "ERROR: sendto failed: %s", strerror(errno));
             return -1;
         }
 
-        log_client(log_fp, "SEND: seq=%u, attempt=%d, payload=\"%s\"",
-                  seq_num, attempts + 1, payload);
+        clock_gettime(CLOCK_MONOTONIC, &sent_at);
+        log_send(log_fp, frame, msg_len, attempts + 1);
+        evlog_emit_flow(flow, EV_SEND, 0, seq_num, (uint16_t)(attempts + 1),
+                        (uint32_t)(msg_len - message_overhead(frame)), 0);
+        metric_inc(&m_sent);
+        if (attempts > 0) {
+            metric_inc(&m_retransmits);
+        } else {
+            metric_inc(&m_in_flight);
+        }
 
         // Wait for ACK with timeout
         FD_ZERO(&readfds);
         FD_SET(sockfd, &readfds);
-        tv.tv_sec = (long)config->timeout;
-        tv.tv_usec = (long)((config->timeout - tv.tv_sec) * 1000000);
+        tv.tv_sec = (long)rto->rto;
+        tv.tv_usec = (long)((rto->rto - tv.tv_sec) * 1000000);
 
         int ready = select(sockfd + 1, &readfds, NULL, NULL, &tv);
 
@@ -115,7 +240,12 @@ int send_message_with_retry(int sockfd, struct sockaddr_in *server_addr,
             return -1;
         } else if (ready == 0) {
             // Timeout
-            log_client(log_fp, "TIMEOUT: seq=%u, attempt=%d", seq_num, attempts + 1);
+            log_client(log_fp, "TIMEOUT: seq=%u, attempt=%d, rto=%.3fs",
+                      seq_num, attempts + 1, rto->rto);
+            evlog_emit_flow(flow, EV_TIMEOUT, 0, seq_num, (uint16_t)(attempts + 1), 0, 0);
+            metric_inc(&m_timeouts);
+            rto_backoff(rto);
+            metric_set(&m_rto, (uint64_t)(rto->rto * 1e6));
             attempts++;
             continue;
         }
@@ -131,15 +261,34 @@ int send_message_with_retry(int sockfd, struct sockaddr_in *server_addr,
             return -1;
         }
 
-        // Deserialize ACK
-        if (deserialize_message(buffer, recv_len, &ack) < 0) {
+        MessageView ack;
+        if (message_view_parse(buffer, (size_t)recv_len, &ack) < 0) {
             log_client(log_fp, "ERROR: Failed to deserialize ACK");
             attempts++;
             continue;
         }
+        if (message_view_verify(&ack) < 0) {
+            log_client(log_fp, "WARN: ACK seq=%u failed its checksum", ack.seq_num);
+            metric_inc(&m_bad_acks);
+            attempts++;
+            continue;
+        }
 
-        if (ack.type == MSG_TYPE_ACK && ack.seq_num == seq_num) {
-            log_client(log_fp, "ACK_RECV: seq=%u", seq_num);
+        uint32_t cum_ack;
+        uint64_t sack_bitmap;
+        if ((ack.type == MSG_TYPE_ACK && ack.seq_num == seq_num) ||
+            (parse_sack_view(&ack, &cum_ack, &sack_bitmap) == 0 &&
+             sack_covers(cum_ack, sack_bitmap, seq_num))) {
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            double rtt = elapsed_since(&sent_at, &now);
+            if (attempts == 0) {
+                record_rtt(rto, rtt);
+            }
+            log_trace(log_fp, "ACK_RECV: seq=%u, rtt=%.3fms", seq_num, rtt * 1000.0);
+            evlog_emit_flow(flow, EV_ACK_RECV, 0, seq_num, (uint16_t)(attempts + 1), 0, (uint32_t)(rtt * 1e6));
+            metric_inc(&m_acked);
+            metric_add(&m_bytes_acked, msg_len - message_overhead(frame));
+            metric_sub(&m_in_flight, 1);
             return 0;  // Success
         } else {
             log_client(log_fp, "WARN: Unexpected ACK seq=%u (expected %u)",
@@ -149,9 +298,995 @@ int send_message_with_retry(int sockfd, struct sockaddr_in *server_addr,
     }
 
     log_client(log_fp, "FAILED: seq=%u after %d attempts", seq_num, config->max_retries);
+    evlog_emit_flow(flow, EV_FAILED, 0, seq_num, (uint16_t)attempts, 0, 0);
+    metric_inc(&m_failed);
+    if (attempts > 0) {
+        metric_sub(&m_in_flight, 1);
+    }
     return -1;
 }
 
+// Records that fit one DATA message go as one; larger ones are split into
+// fragments of the session's payload size on consecutive sequence numbers.
+// seq_num always advances past every fragment, even when one of them fails.
+int send_record_with_retry(int sockfd, struct sockaddr_in *server_addr,
+                           const uint8_t *record, size_t len, uint32_t *seq_num, uint32_t msg_id,
+                           const ClientSession *session, const ClientConfig *config,
+                           RtoEstimator *rto, FILE *log_fp) {
+    uint8_t frame[MAX_FRAME_SIZE];
+
+    if (len <= MAX_PAYLOAD_SIZE) {
+        memcpy(frame + MESSAGE_HEADER_SIZE, record, len);
+        size_t frame_len = message_write_header(frame, MSG_TYPE_DATA, *seq_num, (uint16_t)len);
+        if (config->crc) {
+            frame_len = message_seal(frame, frame_len);
+        }
+        return send_frame_with_retry(sockfd, server_addr, frame, frame_len, (*seq_num)++,
+                                     session->local_port, config, rto, log_fp);
+    }
+
+    size_t stride = (size_t)session->wire_payload - FRAG_HEADER_SIZE;
+    uint16_t count = fragment_count(len, stride);
+    uint32_t first_seq = *seq_num;
+    *seq_num += count;
+
+    for (uint16_t i = 0; i < count; i++) {
+        size_t offset = (size_t)i * stride;
+        size_t frag_len = len - offset < stride ? len - offset : stride;
+        size_t frame_len = build_fragment_frame(frame, first_seq + i, msg_id, i, count,
+                                                record + offset, frag_len);
+        if (config->crc) {
+            frame_len = message_seal(frame, frame_len);
+        }
+        if (send_frame_with_retry(sockfd, server_addr, frame, frame_len, first_seq + i,
+                                  session->local_port, config, rto, log_fp) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static uint16_t local_port(int sockfd) {
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    if (getsockname(sockfd, (struct sockaddr *)&addr, &len) < 0) {
+        return 0;
+    }
+    return ntohs(addr.sin_port);
+}
+
+/*
+ * SYN until a SYN-ACK comes back, backing off like a data message. A new
+ * session opens at a random ISN; with resume set the SYN asks for that
+ * session at the checkpointed seq, and a server that no longer knows it
+ * opens a new session there instead. Returns 0 once a session is agreed.
+ */
+int client_handshake(int sockfd, struct sockaddr_in *server_addr, const ClientConfig *config,
+                     const SessionCheckpoint *resume, ClientSession *session, FILE *log_fp) {
+    uint8_t frame[CONTROL_FRAME_SIZE];
+    uint8_t buffer[CONTROL_FRAME_SIZE];
+    uint64_t requested = resume ? resume->session_id : 0;
+    uint32_t seq = resume ? resume->seq : session_new_isn();
+    uint16_t proposed = (uint16_t)WIRE_PAYLOAD_FOR_MTU(config->mtu);
+    double timeout = config->timeout;
+
+    int frame_len = build_session_frame(frame, sizeof(frame), MSG_TYPE_SYN, seq, requested,
+                                        proposed);
+    if (config->crc) {
+        frame_len = (int)message_seal(frame, (size_t)frame_len);
+    }
+
+    for (int attempt = 1; attempt <= config->max_retries; attempt++) {
+        if (sendto(sockfd, frame, (size_t)frame_len, 0,
+                   (struct sockaddr *)server_addr, sizeof(*server_addr)) < 0) {
+            log_client(log_fp, "ERROR: sendto failed: %s", strerror(errno));
+            return -1;
+        }
+        log_trace(log_fp, "SYN_SEND: seq=%u, session=%016llx, payload=%u, attempt=%d",
+                  seq, (unsigned long long)requested, (unsigned)proposed, attempt);
+
+        // Anything but the SYN-ACK, e.g. a late ACK from a previous run, is skipped
+        uint64_t sent_ns = monotonic_ns();
+        uint64_t deadline = sent_ns + (uint64_t)(timeout * 1e9);
+        for (uint64_t now = sent_ns; now < deadline; now = monotonic_ns()) {
+            struct pollfd pfd = { sockfd, POLLIN, 0 };
+            int ready = poll(&pfd, 1, (int)((deadline - now + 999999) / 1000000));
+            if (ready < 0) {
+                if (errno == EINTR) continue;
+                log_client(log_fp, "ERROR: poll failed: %s", strerror(errno));
+                return -1;
+            }
+            if (ready == 0) {
+                break;
+            }
+
+            ssize_t recv_len = recv(sockfd, buffer, sizeof(buffer), 0);
+            MessageView reply;
+            uint64_t id;
+            uint16_t granted;
+            if (recv_len < 0 || message_view_parse(buffer, (size_t)recv_len, &reply) < 0 ||
+                message_view_verify(&reply) < 0 || reply.type != MSG_TYPE_SYN_ACK ||
+                parse_session_view(&reply, &id, &granted) < 0) {
+                continue;
+            }
+
+            session->resumed = requested != 0 && id == requested;
+            if (!session->resumed && reply.seq_num != seq) {
+                continue;     // Answer to some other SYN
+            }
+            session->id = id;
+            session->first_seq = seq;
+            session->offset = session->resumed ? resume->offset : 0;
+            session->local_port = local_port(sockfd);
+            session->wire_payload = granted < proposed ? granted : proposed;
+
+            double rtt = (double)(monotonic_ns() - sent_ns) / 1e9;
+            if (session->resumed) {
+                log_client(log_fp, "SESSION RESUMED: id=%016llx, seq=%u, offset=%llu, server_next=%u, "
+                          "payload=%u, rtt=%.3fms", (unsigned long long)id, seq,
+                          (unsigned long long)session->offset, reply.seq_num,
+                          (unsigned)session->wire_payload, rtt * 1000.0);
+            } else {
+                log_client(log_fp, "SESSION OPEN: id=%016llx, isn=%u, payload=%u, rtt=%.3fms%s",
+                          (unsigned long long)id, seq, (unsigned)session->wire_payload,
+                          rtt * 1000.0,
+                          requested != 0 ? " (server did not know the checkpointed session)" : "");
+            }
+            return 0;
+        }
+
+        log_client(log_fp, "TIMEOUT: SYN attempt=%d, rto=%.3fs", attempt, timeout);
+        timeout = timeout * 2.0 < config->max_rto ? timeout * 2.0 : config->max_rto;
+    }
+
+    log_client(log_fp, "FAILED: no SYN-ACK after %d attempts", config->max_retries);
+    return -1;
+}
+
+// Bookkeeping for a slot the kernel has just accepted
+static void slot_sent(WindowedSender *ws, WindowSlot *slot) {
+    metric_inc(&m_sent);
+    if (slot->attempts > 0) {
+        ws->retransmits++;
+        metric_inc(&m_retransmits);
+    } else {
+        metric_inc(&m_in_flight);
+    }
+    ws->sent_bytes += slot->buf->len - message_overhead(slot->buf->data);
+    slot->attempts++;
+    slot->rto = ws->rto.rto;
+    slot->sent_ns = monotonic_ns();
+    log_send(ws->log_fp, slot->buf->data, slot->buf->len, slot->attempts);
+    evlog_emit_flow(ws->session->local_port, EV_SEND, 0, slot->seq_num, (uint16_t)slot->attempts,
+                    (uint32_t)(slot->buf->len - message_overhead(slot->buf->data)), 0);
+}
+
+static int transmit_slot(WindowedSender *ws, WindowSlot *slot) {
+    ssize_t sent = sendto(ws->sockfd, slot->buf->data, slot->buf->len, 0,
+                         (struct sockaddr *)ws->server_addr, sizeof(*ws->server_addr));
+    if (sent < 0) {
+        log_client(ws->log_fp, "ERROR: sendto failed: %s", strerror(errno));
+        return -1;
+    }
+    slot_sent(ws, slot);
+    return 0;
+}
+
+// Send the queued run of new messages with one UDP_SEGMENT write. If the
+// kernel rejects GSO the run goes out one datagram at a time, as do all
+// later ones.
+static int gso_flush(WindowedSender *ws) {
+    int count = ws->gso_count;
+    ws->gso_count = 0;
+    if (count == 0) {
+        return 0;
+    }
+
+    if (count > 1 && ws->gso) {
+        struct iovec iov[SOCKOPT_GSO_MAX_SEGMENTS];
+        for (int i = 0; i < count; i++) {
+            iov[i].iov_base = ws->gso_slots[i]->buf->data;
+            iov[i].iov_len = ws->gso_slots[i]->buf->len;
+        }
+        if (sockopt_send_gso(ws->sockfd, iov, count, (uint16_t)ws->gso_slots[0]->buf->len,
+                             (struct sockaddr *)ws->server_addr, sizeof(*ws->server_addr)) >= 0) {
+            for (int i = 0; i < count; i++) {
+                slot_sent(ws, ws->gso_slots[i]);
+            }
+            return 0;
+        }
+        log_client(ws->log_fp, "WARN: UDP_SEGMENT send failed (%s), sending without GSO",
+                  strerror(errno));
+        ws->gso = 0;
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (transmit_slot(ws, ws->gso_slots[i]) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Queue a new message for the next GSO send. Every segment but the last
+// must be the same size, so a shorter message ends the run.
+static int gso_queue(WindowedSender *ws, WindowSlot *slot) {
+    size_t len = slot->buf->len;
+    if (ws->gso_count > 0 && len > ws->gso_slots[0]->buf->len && gso_flush(ws) < 0) {
+        return -1;
+    }
+
+    ws->gso_slots[ws->gso_count++] = slot;
+    size_t seg = ws->gso_slots[0]->buf->len;
+    if (len < seg || ws->gso_count == SOCKOPT_GSO_MAX_SEGMENTS ||
+        (size_t)(ws->gso_count + 1) * seg > SOCKOPT_GSO_MAX_BYTES) {
+        return gso_flush(ws);
+    }
+    return 0;
+}
+
+// Timers armed before the first RTT sample were sized from --timeout; let
+// them shrink to the measured RTO instead of stalling on the initial guess.
+static double slot_timeout(const WindowSlot *slot, const RtoEstimator *rto) {
+    if (slot->attempts == 1 && rto->have_sample && rto->rto < slot->rto) {
+        return rto->rto;
+    }
+    return slot->rto;
+}
+
+static uint64_t slot_deadline(const WindowSlot *slot, const RtoEstimator *rto) {
+    return slot->sent_ns + (uint64_t)(slot_timeout(slot, rto) * 1e9);
+}
+
+static void ack_slot(WindowedSender *ws, WindowSlot *slot) {
+    // A kernel receive timestamp leaves out the time the ACK sat in the socket
+    uint64_t now = ws->ack_rx_ns > slot->sent_ns ? ws->ack_rx_ns : monotonic_ns();
+    double rtt = (double)(now - slot->sent_ns) / 1e9;
+    if (slot->attempts == 1) {
+        record_rtt(&ws->rto, rtt);
+    }
+    cc_on_ack(&ws->cc, slot->seq_num);
+    metric_set(&m_cwnd, (uint64_t)cc_window(&ws->cc));
+
+    log_trace(ws->log_fp, "ACK_RECV: seq=%u, rtt=%.3fms", slot->seq_num, rtt * 1000.0);
+    evlog_emit_flow(ws->session->local_port, EV_ACK_RECV, 0, slot->seq_num,
+                    (uint16_t)slot->attempts, 0, (uint32_t)(rtt * 1e6));
+    metric_inc(&m_acked);
+    metric_add(&m_bytes_acked, slot->buf->len - message_overhead(slot->buf->data));
+    metric_sub(&m_in_flight, 1);
+    if (!ws->bulk) {
+        printf("✓ Message sent successfully (seq=%u)\n", slot->seq_num);
+    }
+    ws->acked_bytes += slot->buf->len - message_overhead(slot->buf->data);
+    slot->in_use = 0;
+    packet_free(slot->buf);
+    slot->buf = NULL;
+}
+
+// Find the next complete line at the front of the stdin buffer without
+// consuming it. Lines longer than MAX_RECORD_SIZE are split the same way
+// fgets() splits them in stop-and-wait mode.
+static int take_line(const WindowedSender *ws, size_t *len, size_t *consume) {
+    const char *buf = ws->in_data + ws->in_start;
+    size_t avail = ws->inlen - ws->in_start;
+    size_t limit = avail < MAX_RECORD_SIZE ? avail : MAX_RECORD_SIZE;
+
+    const char *newline = memchr(buf, '\n', limit);
+    size_t n = newline ? (size_t)(newline - buf) : limit;
+
+    int have_newline = (n < avail && buf[n] == '\n');
+    if (!have_newline && n < MAX_RECORD_SIZE && !ws->eof) {
+        return 0;  // Wait for more input
+    }
+    if (n == 0 && !have_newline) {
+        return 0;
+    }
+
+    *len = n;
+    *consume = n + (have_newline ? 1 : 0);
+    return 1;
+}
+
+// Bulk mode: the next full-size chunk, or the short tail once input ends
+static int take_chunk(const WindowedSender *ws, size_t *len) {
+    size_t avail = ws->inlen - ws->in_start;
+    size_t chunk = ws->session->wire_payload;
+    if (avail == 0 || (avail < chunk && !ws->eof)) {
+        return 0;
+    }
+    *len = avail < chunk ? avail : chunk;
+    return 1;
+}
+
+static void on_stdin_readable(EventSource *src, uint32_t events) {
+    WindowedSender *ws = src->ctx;
+    (void)events;
+
+    // Slide unconsumed input to the front only once the tail is full
+    if (ws->inlen == sizeof(ws->inbuf) && ws->in_start > 0) {
+        memmove(ws->inbuf, ws->inbuf + ws->in_start, ws->inlen - ws->in_start);
+        ws->inlen -= ws->in_start;
+        ws->in_start = 0;
+    }
+
+    ssize_t n = read(src->fd, ws->inbuf + ws->inlen, sizeof(ws->inbuf) - ws->inlen);
+    if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+        return;
+    }
+    if (n <= 0) {
+        ws->eof = 1;
+        event_loop_modify(&ws->loop, src, 0);
+        return;
+    }
+    ws->inlen += (size_t)n;
+}
+
+// Room for one more new message under the slot, congestion and receiver
+// windows. With nothing in flight one message may always go, so a closed
+// receiver window is probed rather than waited on forever.
+static int window_open(const WindowedSender *ws) {
+    uint32_t in_flight = ws->next_seq - ws->base;
+    if (in_flight >= (uint32_t)ws->window || in_flight >= (uint32_t)cc_window(&ws->cc)) {
+        return 0;
+    }
+    return !ws->have_peer_window || in_flight == 0 || seq_before(ws->next_seq, ws->peer_edge);
+}
+
+// Resend each hole that CLIENT_DUPTHRESH later messages have been SACKed
+// past, once, without waiting for its timer
+static void retransmit_holes(WindowedSender *ws, uint32_t cum_ack, uint64_t sack_bitmap) {
+    uint32_t window = (uint32_t)ws->window;
+
+    for (uint32_t seq = ws->base; seq != ws->next_seq; seq++) {
+        uint32_t offset = seq - cum_ack;
+        if (seq_before(seq, cum_ack) || offset >= SACK_BITMAP_BITS) {
+            continue;
+        }
+        if (__builtin_popcountll(sack_bitmap >> offset) < CLIENT_DUPTHRESH) {
+            break;
+        }
+
+        WindowSlot *slot = &ws->slots[seq % window];
+        if (!slot->in_use || slot->fast_retx || slot->attempts >= ws->config->max_retries ||
+            sack_covers(cum_ack, sack_bitmap, seq)) {
+            continue;
+        }
+
+        cc_on_loss(&ws->cc, seq, ws->next_seq);
+        metric_set(&m_cwnd, (uint64_t)cc_window(&ws->cc));
+        log_client(ws->log_fp, "FAST RETRANSMIT: seq=%u, attempt=%d, cwnd=%d",
+                  seq, slot->attempts, cc_window(&ws->cc));
+        slot->fast_retx = 1;
+        ws->fast_retransmits++;
+        metric_inc(&m_fast_retransmits);
+        if (transmit_slot(ws, slot) < 0) {
+            return;
+        }
+    }
+}
+
+// Drain every ACK that is already queued on the socket
+static void on_acks_readable(EventSource *src, uint32_t events) {
+    WindowedSender *ws = src->ctx;
+    uint32_t window = (uint32_t)ws->window;
+    uint8_t buffer[CONTROL_FRAME_SIZE];
+    union {
+        char buf[CMSG_SPACE(sizeof(struct timespec) * 3) + CMSG_SPACE(sizeof(uint32_t))];
+        struct cmsghdr align;
+    } control;
+    (void)events;
+
+    for (;;) {
+        struct iovec iov = { buffer, sizeof(buffer) };
+        struct msghdr hdr;
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.msg_iov = &iov;
+        hdr.msg_iovlen = 1;
+        if (ws->config->sock.timestamps) {
+            hdr.msg_control = control.buf;
+            hdr.msg_controllen = sizeof(control.buf);
+        }
+
+        ssize_t recv_len = recvmsg(ws->sockfd, &hdr, MSG_DONTWAIT);
+        ws->ack_rx_ns = recv_len >= 0 && hdr.msg_controllen > 0 ? sockopt_rx_timestamp(&hdr) : 0;
+        if (recv_len < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                log_client(ws->log_fp, "ERROR: recvmsg failed: %s", strerror(errno));
+            }
+            return;
+        }
+
+        MessageView ack;
+        if (message_view_parse(buffer, (size_t)recv_len, &ack) < 0) {
+            log_client(ws->log_fp, "ERROR: Failed to deserialize ACK");
+            continue;
+        }
+        if (message_view_verify(&ack) < 0) {
+            log_client(ws->log_fp, "WARN: ACK seq=%u failed its checksum", ack.seq_num);
+            metric_inc(&m_bad_acks);
+            continue;
+        }
+
+        uint32_t cum_ack;
+        uint64_t sack_bitmap;
+        if (parse_sack_view(&ack, &cum_ack, &sack_bitmap) == 0) {
+            // One SACK can resolve any number of in-flight messages
+            for (uint32_t seq = ws->base; seq != ws->next_seq; seq++) {
+                WindowSlot *slot = &ws->slots[seq % window];
+                if (slot->in_use && sack_covers(cum_ack, sack_bitmap, seq)) {
+                    ack_slot(ws, slot);
+                }
+            }
+
+            uint16_t peer_window = sack_view_window(&ack);
+            if (peer_window != SACK_WINDOW_NONE) {
+                ws->peer_edge = cum_ack + peer_window;
+                ws->have_peer_window = 1;
+                metric_set(&m_peer_window, peer_window);
+            }
+            if (sack_bitmap != 0) {
+                retransmit_holes(ws, cum_ack, sack_bitmap);
+            }
+            continue;
+        }
+
+        WindowSlot *slot = &ws->slots[ack.seq_num % window];
+        if (ack.type != MSG_TYPE_ACK || ack.seq_num - ws->base >= ws->next_seq - ws->base ||
+            !slot->in_use || slot->seq_num != ack.seq_num) {
+            log_client(ws->log_fp, "WARN: Unexpected ACK seq=%u (window %u-%u)",
+                      ack.seq_num, ws->base, ws->next_seq);
+            continue;
+        }
+
+        ack_slot(ws, slot);
+    }
+}
+
+// Fill the window from whatever input is already buffered. Short lines
+// become one DATA message; longer ones are queued fragment by fragment,
+// so a record can straddle several calls when the window is small.
+// New messages are paced one smoothed-RTT / cwnd apart.
+static int fill_window(WindowedSender *ws) {
+    uint32_t window = (uint32_t)ws->window;
+    size_t stride = (size_t)ws->session->wire_payload - FRAG_HEADER_SIZE;
+    ws->paced = 0;
+
+    while (window_open(ws)) {
+        uint64_t interval = ws->config->pacing ?
+                            cc_pacing_interval_ns(&ws->cc, ws->rto.srtt) : 0;
+        uint64_t now = interval ? monotonic_ns() : 0;
+        if (interval && now < ws->next_send_ns) {
+            ws->paced = 1;
+            break;
+        }
+
+        WindowSlot *slot = &ws->slots[ws->next_seq % window];
+        const uint8_t *line = (const uint8_t *)ws->in_data + ws->in_start;
+        if (!slot->buf && !(slot->buf = packet_alloc())) {
+            break;
+        }
+        uint8_t *frame = slot->buf->data;
+
+        if (ws->bulk) {
+            size_t len;
+            if (!take_chunk(ws, &len)) {
+                break;
+            }
+            memcpy(frame + MESSAGE_HEADER_SIZE, line, len);
+            slot->buf->len = message_write_header(frame, MSG_TYPE_STREAM, ws->next_seq,
+                                                  (uint16_t)len);
+            ws->in_start += len;
+        } else if (ws->rec_count == 0) {
+            size_t len, consume;
+            if (!take_line(ws, &len, &consume)) {
+                break;
+            }
+            if (len == 0) {
+                ws->in_start += consume;
+                continue;
+            }
+
+            if (len <= MAX_PAYLOAD_SIZE) {
+                memcpy(frame + MESSAGE_HEADER_SIZE, line, len);
+                slot->buf->len = message_write_header(frame, MSG_TYPE_DATA, ws->next_seq,
+                                                      (uint16_t)len);
+                ws->in_start += consume;
+            } else {
+                ws->rec_len = len;
+                ws->rec_consume = consume;
+                ws->rec_id = ws->next_msg_id++;
+                ws->rec_index = 0;
+                ws->rec_count = fragment_count(len, stride);
+            }
+        }
+
+        if (!ws->bulk && ws->rec_count > 0) {
+            size_t offset = (size_t)ws->rec_index * stride;
+            size_t frag_len = ws->rec_len - offset < stride ? ws->rec_len - offset : stride;
+            slot->buf->len = build_fragment_frame(frame, ws->next_seq, ws->rec_id,
+                                                  ws->rec_index, ws->rec_count,
+                                                  line + offset, frag_len);
+            if (++ws->rec_index == ws->rec_count) {
+                ws->in_start += ws->rec_consume;
+                ws->rec_count = 0;
+            }
+        }
+
+        if (ws->config->crc) {
+            slot->buf->len = message_seal(frame, slot->buf->len);
+        }
+        slot->input_end = ws->in_start;
+        slot->in_use = 1;
+        slot->seq_num = ws->next_seq;
+        slot->attempts = 0;
+        slot->fast_retx = 0;
+        ws->next_seq++;
+
+        if ((ws->gso ? gso_queue(ws, slot) : transmit_slot(ws, slot)) < 0) {
+            return -1;
+        }
+
+        // A late wakeup may catch up on the messages it owes, and an idle sender
+        // by a small burst, but never by a whole window
+        if (interval) {
+            uint64_t burst = CC_PACING_BURST * interval;
+            if (burst < CC_PACING_SLACK_NS) {
+                burst = CC_PACING_SLACK_NS;
+            }
+            if (ws->next_send_ns + burst < now) {
+                ws->next_send_ns = now - burst;
+            }
+            ws->next_send_ns += interval;
+        }
+    }
+    return gso_flush(ws);
+}
+
+// Retransmit only the messages whose timers have expired
+static int retransmit_expired(WindowedSender *ws) {
+    uint32_t window = (uint32_t)ws->window;
+    uint64_t now = monotonic_ns();
+    int timed_out = 0;
+
+    for (uint32_t s = ws->base; s != ws->next_seq; s++) {
+        WindowSlot *slot = &ws->slots[s % window];
+        if (!slot->in_use || now < slot_deadline(slot, &ws->rto)) {
+            continue;
+        }
+
+        double timeout = slot_timeout(slot, &ws->rto);
+        log_client(ws->log_fp, "TIMEOUT: seq=%u, attempt=%d, rto=%.3fs",
+                  slot->seq_num, slot->attempts, timeout);
+        evlog_emit_flow(ws->session->local_port, EV_TIMEOUT, 0, slot->seq_num,
+                        (uint16_t)slot->attempts, 0, 0);
+        metric_inc(&m_timeouts);
+        if (slot->attempts >= ws->config->max_retries) {
+            log_client(ws->log_fp, "FAILED: seq=%u after %d attempts",
+                      slot->seq_num, ws->config->max_retries);
+            evlog_emit_flow(ws->session->local_port, EV_FAILED, 0, slot->seq_num,
+                            (uint16_t)slot->attempts, 0, 0);
+            if (!ws->bulk) {
+                printf("✗ Failed to send message (seq=%u)\n", slot->seq_num);
+            }
+            slot->in_use = 0;
+            packet_free(slot->buf);
+            slot->buf = NULL;
+            ws->failures++;
+            metric_inc(&m_failed);
+            metric_sub(&m_in_flight, 1);
+            continue;
+        }
+
+        // Each retransmission of the same message doubles its own timer
+        timed_out = 1;
+        if (transmit_slot(ws, slot) < 0) {
+            return -1;
+        }
+        if (slot->rto < 2.0 * timeout) {
+            slot->rto = rto_clamp(&ws->rto, 2.0 * timeout);
+        }
+    }
+
+    // Back the shared estimator and the congestion window off once per round of timeouts
+    if (timed_out) {
+        rto_backoff(&ws->rto);
+        metric_set(&m_rto, (uint64_t)(ws->rto.rto * 1e6));
+        cc_on_timeout(&ws->cc, ws->next_seq);
+        metric_set(&m_cwnd, (uint64_t)cc_window(&ws->cc));
+    }
+    return 0;
+}
+
+// --file: map regular files whole so chunks are copied straight from the
+// page cache; pipes, devices and empty files are read like stdin.
+static int open_input_file(WindowedSender *ws, const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        log_client(ws->log_fp, "ERROR: Cannot open %s: %s", path, strerror(errno));
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+            close(fd);
+            ws->in_data = map;
+            ws->map_len = (size_t)st.st_size;
+            ws->inlen = ws->map_len;
+            ws->input_fd = -1;
+            ws->eof = 1;
+            return 0;
+        }
+    }
+
+    ws->input_fd = fd;
+    return 0;
+}
+
+// --resume: record how far the server has acknowledged, at most once per
+// interval unless forced, so a killed client resends little
+static void save_checkpoint(WindowedSender *ws, int force) {
+    SessionCheckpoint *cp = &ws->checkpoint;
+    if (!ws->config->resume || cp->seq == ws->base) {
+        return;
+    }
+    uint64_t now = monotonic_ns();
+    if (!force && now - ws->checkpoint_ns < SESSION_CHECKPOINT_INTERVAL_NS) {
+        return;
+    }
+
+    cp->seq = ws->base;
+    cp->offset = ws->acked_offset;
+    ws->checkpoint_ns = now;
+    if (checkpoint_save(ws->config->resume, cp) < 0) {
+        log_client(ws->log_fp, "WARN: Cannot write checkpoint %s: %s",
+                  ws->config->resume, strerror(errno));
+    }
+}
+
+static void report_goodput(const WindowedSender *ws) {
+    double elapsed = (double)(monotonic_ns() - ws->start_ns) / 1e9;
+    double mbps = elapsed > 0 ? (double)ws->acked_bytes * 8.0 / elapsed / 1e6 : 0.0;
+
+    log_client(ws->log_fp, "TRANSFER: delivered=%llu bytes, sent=%llu bytes, elapsed=%.3fs, "
+              "goodput=%.2f Mbit/s, retransmits=%d, fast_retransmits=%d, failed=%d, cwnd=%d",
+              (unsigned long long)ws->acked_bytes, (unsigned long long)ws->sent_bytes,
+              elapsed, mbps, ws->retransmits, ws->fast_retransmits, ws->failures,
+              cc_window(&ws->cc));
+    printf("Transferred %llu bytes in %.3fs (%.2f Mbit/s goodput, %d retransmits, %d failed)\n",
+           (unsigned long long)ws->acked_bytes, elapsed, mbps, ws->retransmits, ws->failures);
+}
+
+// The caller owns the packet pool, which must hold at least config->window buffers
+int run_windowed_sender(int sockfd, struct sockaddr_in *server_addr, const ClientConfig *config,
+                        int input_fd, const ClientSession *session, FILE *log_fp) {
+    WindowedSender *ws = calloc(1, sizeof(WindowedSender));
+    if (!ws) {
+        log_client(log_fp, "ERROR: Failed to allocate send window");
+        return -1;
+    }
+
+    ws->config = config;
+    ws->sockfd = sockfd;
+    ws->server_addr = server_addr;
+    ws->log_fp = log_fp;
+    ws->window = config->window;
+    ws->slots = calloc((size_t)ws->window, sizeof(WindowSlot));
+    ws->bulk = config->file || config->binary;
+    ws->gso = ws->bulk && config->sock.gso;   // Lines vary in size, so they rarely form a run
+    ws->in_data = ws->inbuf;
+    ws->input_fd = input_fd;
+    ws->session = session;
+    ws->base = ws->next_seq = session->first_seq;
+    ws->start_ns = monotonic_ns();
+    rto_init(&ws->rto, config->timeout, config->min_rto, config->max_rto);
+    cc_init(&ws->cc, (CongestionMode)config->cc, ws->window);
+    metric_set(&m_cwnd, (uint64_t)cc_window(&ws->cc));
+
+    if (config->file && open_input_file(ws, config->file) < 0) {
+        free(ws->slots);
+        free(ws);
+        return -1;
+    }
+
+    // Resumed: skip what the server already has; whatever it also got past
+    // the checkpoint is resent and acknowledged as duplicates
+    if (session->offset > 0) {
+        if (ws->input_fd < 0) {
+            ws->in_start = session->offset < ws->inlen ? (size_t)session->offset : ws->inlen;
+        } else {
+            lseek(ws->input_fd, (off_t)session->offset, SEEK_SET);
+        }
+    }
+    ws->acked_offset = ws->in_start > 0 ? ws->in_start : session->offset;
+    if (config->resume) {
+        struct stat st;
+        ws->checkpoint.session_id = session->id;
+        ws->checkpoint.seq = session->first_seq - 1;   // Forces the first save
+        ws->checkpoint.local_port = session->local_port;
+        ws->checkpoint.file_size = ws->map_len > 0 ? ws->map_len :
+                                   (stat(config->file, &st) == 0 ? (uint64_t)st.st_size : 0);
+    }
+
+    if (!ws->slots || event_loop_init(&ws->loop) < 0 ||
+        event_loop_add(&ws->loop, &ws->sock_src, sockfd, on_acks_readable, ws, NULL) < 0 ||
+        (ws->input_fd >= 0 &&
+         event_loop_add(&ws->loop, &ws->stdin_src, ws->input_fd, on_stdin_readable, ws, NULL) < 0)) {
+        log_client(log_fp, "ERROR: Failed to set up windowed sender: %s", strerror(errno));
+        event_loop_destroy(&ws->loop);
+        if (ws->map_len > 0) munmap((void *)ws->in_data, ws->map_len);
+        if (ws->input_fd > STDIN_FILENO) close(ws->input_fd);
+        free(ws->slots);
+        free(ws);
+        return -1;
+    }
+
+    int result = 0;
+    uint32_t window = (uint32_t)ws->window;
+
+    for (;;) {
+        if (fill_window(ws) < 0) {
+            result = -1;
+            break;
+        }
+
+        if (ws->eof && ws->base == ws->next_seq && ws->in_start == ws->inlen &&
+            ws->rec_count == 0) {
+            break;
+        }
+
+        // Only read more input while there is room to send it
+        int want_input = !ws->eof && window_open(ws) &&
+                         ws->inlen - ws->in_start < sizeof(ws->inbuf);
+        if (ws->input_fd >= 0) {
+            event_loop_modify(&ws->loop, &ws->stdin_src, want_input ? EVENT_READ : 0);
+        }
+
+        // Sleep until input, an ACK, or the earliest retransmission deadline
+        uint64_t deadline = EVENT_LOOP_NO_DEADLINE;
+        for (uint32_t s = ws->base; s != ws->next_seq; s++) {
+            WindowSlot *slot = &ws->slots[s % window];
+            if (slot->in_use && slot_deadline(slot, &ws->rto) < deadline) {
+                deadline = slot_deadline(slot, &ws->rto);
+            }
+        }
+        if (ws->paced && ws->next_send_ns < deadline) {
+            deadline = ws->next_send_ns;
+        }
+
+        if (event_loop_poll(&ws->loop, deadline) < 0) {
+            log_client(log_fp, "ERROR: event loop failed: %s", strerror(errno));
+            result = -1;
+            break;
+        }
+
+        if (retransmit_expired(ws) < 0) {
+            result = -1;
+            break;
+        }
+
+        // Slide the window past everything that has been resolved. Once a
+        // message has failed the checkpoint stays behind it so a rerun sends it.
+        while (ws->base != ws->next_seq && !ws->slots[ws->base % window].in_use) {
+            if (ws->failures == 0) {
+                ws->acked_offset = ws->slots[ws->base % window].input_end;
+            }
+            ws->base++;
+        }
+        if (ws->failures == 0) {
+            save_checkpoint(ws, 0);
+        }
+    }
+
+    if (result == 0 && ws->failures > 0) {
+        result = -1;
+    }
+    if (config->resume) {
+        if (result == 0) {
+            checkpoint_remove(config->resume);   // Done; the next run starts afresh
+        } else if (ws->failures == 0) {
+            save_checkpoint(ws, 1);
+        }
+    }
+    if (ws->bulk) {
+        report_goodput(ws);
+    }
+    event_loop_destroy(&ws->loop);
+    if (ws->map_len > 0) munmap((void *)ws->in_data, ws->map_len);
+    if (ws->input_fd > STDIN_FILENO && ws->input_fd != input_fd) close(ws->input_fd);
+
+    // Return any released slot buffers still held in this thread's cache
+    for (int i = 0; i < ws->window; i++) {
+        if (ws->slots[i].buf) packet_free(ws->slots[i].buf);
+    }
+    free(ws->slots);
+    free(ws);
+    return result;
+}
+
+static void log_packet_pool(FILE *log_fp) {
+    PacketPoolStats pool;
+    packet_pool_stats(&pool);
+    log_client(log_fp, "PACKET POOL: high_water=%zu of %zu buffers, exhausted=%llu",
+              pool.high_water, pool.max_buffers, pool.exhausted);
+}
+
+static void *stream_main(void *arg) {
+    ClientStream *stream = arg;
+    if (client_handshake(stream->sockfd, stream->server_addr, stream->config, NULL,
+                         &stream->session, stream->log_fp) < 0) {
+        // Closing the read end turns the dispatcher's next write into an error
+        stream->result = -1;
+        close(stream->feed[0]);
+        stream->feed[0] = -1;
+    } else {
+        stream->result = run_windowed_sender(stream->sockfd, stream->server_addr, stream->config,
+                                             stream->feed[0], &stream->session, stream->log_fp);
+    }
+    evlog_thread_flush();
+    packet_pool_thread_release();
+    return NULL;
+}
+
+static int write_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// Hands each stdin line to the next stream, in turn, whose pipe has room,
+// so lines flow around a stream that is stuck retransmitting
+static void dispatch_lines(ClientStream *streams, int count, FILE *log_fp) {
+    struct pollfd pfds[CLIENT_MAX_STREAMS];
+    char *line = NULL;
+    size_t line_cap = 0;
+    ssize_t line_len;
+    int next = 0;
+
+    for (int i = 0; i < count; i++) {
+        pfds[i].fd = streams[i].feed[1];
+        pfds[i].events = POLLOUT;
+    }
+
+    while ((line_len = getline(&line, &line_cap, stdin)) > 0) {
+        if (line[line_len - 1] != '\n') {
+            line[line_len++] = '\n';   // getline() leaves room for the terminator
+        }
+
+        int target = -1;
+        while (target < 0) {
+            if (poll(pfds, (nfds_t)count, -1) < 0 && errno != EINTR) {
+                log_client(log_fp, "ERROR: poll on stream pipes failed: %s", strerror(errno));
+                free(line);
+                return;
+            }
+            for (int k = 0; k < count && target < 0; k++) {
+                int i = (next + k) % count;
+                if (pfds[i].revents & (POLLERR | POLLHUP)) {
+                    log_client(log_fp, "ERROR: Stream %d stopped accepting input", i);
+                    free(line);
+                    return;
+                }
+                if (pfds[i].revents & POLLOUT) target = i;
+            }
+        }
+
+        if (write_all(streams[target].feed[1], line, (size_t)line_len) < 0) {
+            log_client(log_fp, "ERROR: write to stream %d failed: %s", target, strerror(errno));
+            break;
+        }
+        next = (target + 1) % count;
+    }
+    free(line);
+}
+
+// --streams N: N windowed senders on their own sockets and threads, each
+// in a session of its own, so loss on one never holds up the others and
+// the server's SO_REUSEPORT workers see N distinct flows
+int run_streams(struct sockaddr_in *server_addr, const ClientConfig *config, FILE *log_fp) {
+    ClientStream *streams = calloc((size_t)config->streams, sizeof(ClientStream));
+    int count = 0;
+    int result = 0;
+
+    if (!streams ||
+        packet_pool_init((size_t)config->streams * (size_t)(config->window + PACKET_CACHE_MAX)) < 0) {
+        log_client(log_fp, "ERROR: Failed to allocate streams");
+        free(streams);
+        return -1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    for (; count < config->streams; count++) {
+        ClientStream *stream = &streams[count];
+        stream->id = count;
+        stream->server_addr = server_addr;
+        stream->config = config;
+        stream->log_fp = log_fp;
+        stream->sockfd = create_udp_socket(&config->sock, log_fp);
+        if (stream->sockfd < 0) {
+            break;
+        }
+        if (pipe(stream->feed) < 0) {
+            close(stream->sockfd);
+            break;
+        }
+        fcntl(stream->feed[1], F_SETPIPE_SZ, CLIENT_STREAM_PIPE_SIZE);
+        if (pthread_create(&stream->thread, NULL, stream_main, stream) != 0) {
+            close(stream->feed[0]);
+            close(stream->feed[1]);
+            close(stream->sockfd);
+            break;
+        }
+        stream->started = 1;
+    }
+
+    if (count < config->streams) {
+        log_client(log_fp, "ERROR: Started only %d of %d streams: %s",
+                  count, config->streams, strerror(errno));
+        result = -1;
+    } else {
+        log_client(log_fp, "STREAMS: %d flows, window=%d each", count, config->window);
+        dispatch_lines(streams, count, log_fp);
+    }
+
+    // EOF on every pipe lets each stream drain its window and exit
+    for (int i = 0; i < count; i++) {
+        close(streams[i].feed[1]);
+    }
+    for (int i = 0; i < count; i++) {
+        pthread_join(streams[i].thread, NULL);
+        if (streams[i].feed[0] >= 0) close(streams[i].feed[0]);
+        close(streams[i].sockfd);
+        if (streams[i].result < 0) {
+            result = -1;
+        }
+    }
+
+    log_packet_pool(log_fp);
+    packet_pool_destroy();
+    free(streams);
+    return result;
+}
+
+// Takes up a --resume checkpoint that still matches the file, from the
+// port it was taken on, then runs the handshake
+static int open_session(int sockfd, struct sockaddr_in *server_addr, const ClientConfig *config,
+                        ClientSession *session, FILE *log_fp) {
+    SessionCheckpoint cp;
+    const SessionCheckpoint *resume = NULL;
+
+    if (config->resume && checkpoint_load(config->resume, &cp) == 0) {
+        struct stat st;
+        if (stat(config->file, &st) < 0 || (uint64_t)st.st_size != cp.file_size ||
+            cp.offset > cp.file_size) {
+            log_client(log_fp, "WARN: Checkpoint %s does not match %s, starting over",
+                      config->resume, config->file);
+        } else {
+            // The same 4-tuple as before reaches the SO_REUSEPORT worker holding the session
+            struct sockaddr_in local;
+            memset(&local, 0, sizeof(local));
+            local.sin_family = AF_INET;
+            local.sin_addr.s_addr = htonl(INADDR_ANY);
+            local.sin_port = htons(cp.local_port);
+            if (bind(sockfd, (struct sockaddr *)&local, sizeof(local)) < 0) {
+                log_client(log_fp, "WARN: Cannot rebind port %u: %s; the server may not find the session",
+                          (unsigned)cp.local_port, strerror(errno));
+            }
+            resume = &cp;
+        }
+    }
+    return client_handshake(sockfd, server_addr, config, resume, session, log_fp);
+}
+
 int main(int argc, char *argv[]) {
     ClientConfig config;
     FILE *log_fp = NULL;
@@ -161,17 +1296,36 @@ int main(int argc, char *argv[]) {
     }
 
     if (config.log_file) {
-        log_fp = fopen(config.log_file, "a");
+        log_fp = log_open_file(config.log_file);
         if (!log_fp) {
             fprintf(stderr, "Warning: Could not open log file %s\n", config.log_file);
         }
     }
 
-    log_client(log_fp, "CLIENT STARTED: target=%s:%d, timeout=%.1fs, max_retries=%d",
-              config.target_ip, config.target_port, config.timeout, config.max_retries);
+    if (log_init(&config.log) < 0) {
+        fprintf(stderr, "Warning: Could not start log writer, logging synchronously\n");
+    }
+
+    log_client(log_fp, "CLIENT STARTED: target=%s:%d, timeout=%.1fs, max_retries=%d, window=%d, "
+              "streams=%d, cc=%s%s, mtu=%d", config.target_ip, config.target_port, config.timeout,
+              config.max_retries, config.window, config.streams, config.cc == CC_AIMD ? "aimd" : "fixed",
+              config.cc == CC_AIMD && config.pacing ? "+pacing" : "", config.mtu);
+
+    metrics_register_all(client_metrics, sizeof(client_metrics) / sizeof(client_metrics[0]));
+    metric_set(&m_rto, (uint64_t)(config.timeout * 1e6));
+    if (metrics_start(&config.metrics, log_fp) < 0) {
+        log_client(log_fp, "WARN: Continuing without a metrics endpoint");
+    }
+    if (evlog_open(&config.events, EVLOG_ROLE_CLIENT) < 0) {
+        log_client(log_fp, "WARN: Could not open event log %s: %s",
+                  config.events.path, strerror(errno));
+    }
 
-    int sockfd = create_udp_socket();
+    int sockfd = create_udp_socket(&config.sock, log_fp);
     if (sockfd < 0) {
+        metrics_stop();
+        evlog_close();
+        log_shutdown();
         if (log_fp) fclose(log_fp);
         return EXIT_FAILURE;
     }
@@ -184,35 +1338,95 @@ int main(int argc, char *argv[]) {
     if (inet_pton(AF_INET, config.target_ip, &server_addr.sin_addr) <= 0) {
         log_client(log_fp, "ERROR: Invalid target IP address");
         close(sockfd);
+        metrics_stop();
+        evlog_close();
+        log_shutdown();
         if (log_fp) fclose(log_fp);
         return EXIT_FAILURE;
     }
 
-    char line[MAX_PAYLOAD_SIZE + 1];
-    uint32_t seq_num = 0;
+    if (config.streams > 1) {
+        close(sockfd);
+        printf("Enter messages (Ctrl+D to quit):\n");
+        run_streams(&server_addr, &config, log_fp);
 
-    printf("Enter messages (Ctrl+D to quit):\n");
+        log_client(log_fp, "CLIENT SHUTDOWN");
+        metrics_stop();
+        evlog_close();
+        log_shutdown();
+        if (log_fp) fclose(log_fp);
+        return EXIT_SUCCESS;
+    }
 
-    while (fgets(line, sizeof(line), stdin)) {
-        // Remove newline
-        line[strcspn(line, "\n")] = '\0';
+    ClientSession session;
+    if (open_session(sockfd, &server_addr, &config, &session, log_fp) < 0) {
+        close(sockfd);
+        metrics_stop();
+        evlog_close();
+        log_shutdown();
+        if (log_fp) fclose(log_fp);
+        return EXIT_FAILURE;
+    }
 
-        if (strlen(line) == 0) {
-            continue;
+    if (config.window > 1 || config.file || config.binary) {
+        if (!config.file && !config.binary) {
+            printf("Enter messages (Ctrl+D to quit):\n");
         }
-
-        if (send_message_with_retry(sockfd, &server_addr, line, seq_num,
-                                    &config, log_fp) == 0) {
-            printf("✓ Message sent successfully (seq=%u)\n", seq_num);
+        if (packet_pool_init((size_t)config.window) == 0) {
+            run_windowed_sender(sockfd, &server_addr, &config, STDIN_FILENO, &session, log_fp);
+            log_packet_pool(log_fp);
+            packet_pool_destroy();
         } else {
-            printf("✗ Failed to send message (seq=%u)\n", seq_num);
+            log_client(log_fp, "ERROR: Failed to allocate send window");
         }
 
-        seq_num++;
+        log_client(log_fp, "CLIENT SHUTDOWN");
+        close(sockfd);
+        metrics_stop();
+        evlog_close();
+        log_shutdown();
+        if (log_fp) fclose(log_fp);
+        return EXIT_SUCCESS;
+    }
+
+    printf("Enter messages (Ctrl+D to quit):\n");
+
+    char *line = NULL;
+    size_t line_cap = 0;
+    ssize_t line_len;
+    uint32_t seq_num = session.first_seq;
+    uint32_t msg_id = 0;
+    RtoEstimator rto;
+    rto_init(&rto, config.timeout, config.min_rto, config.max_rto);
+
+    while ((line_len = getline(&line, &line_cap, stdin)) > 0) {
+        // Remove newline
+        if (line[line_len - 1] == '\n') {
+            line_len--;
+        }
+
+        // Overlong lines are split into MAX_RECORD_SIZE records
+        for (size_t off = 0; off < (size_t)line_len; off += MAX_RECORD_SIZE) {
+            size_t len = (size_t)line_len - off;
+            if (len > MAX_RECORD_SIZE) len = MAX_RECORD_SIZE;
+
+            uint32_t first_seq = seq_num;
+            if (send_record_with_retry(sockfd, &server_addr, (const uint8_t *)line + off, len,
+                                       &seq_num, msg_id++, &session, &config, &rto,
+                                       log_fp) == 0) {
+                printf("✓ Message sent successfully (seq=%u)\n", first_seq);
+            } else {
+                printf("✗ Failed to send message (seq=%u)\n", first_seq);
+            }
+        }
     }
+    free(line);
 
     log_client(log_fp, "CLIENT SHUTDOWN");
     close(sockfd);
+    metrics_stop();
+    evlog_close();
+    log_shutdown();
     if (log_fp) fclose(log_fp);
 
     return EXIT_SUCCESS;
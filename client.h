@@ -3,23 +3,149 @@
 
 #include <stdio.h>
 #include "protocol.h"
+#include "log.h"
+#include "packet_pool.h"
+#include "event_loop.h"
+#include "rto.h"
+#include "congestion.h"
+#include "metrics.h"
+#include "evlog.h"
+#include "sockopt.h"
+#include "session.h"
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <time.h>
+#include <pthread.h>
 
 typedef struct {
     char *target_ip;
     int target_port;
-    double timeout;
+    double timeout;            // Initial retransmission timeout
+    double min_rto;
+    double max_rto;
     int max_retries;
+    int window;                // Max unacknowledged messages in flight
+    int streams;               // Independent flows, each with its own socket and thread
+    int cc;                    // CongestionMode, or -1 when --cc was not understood
+    int pacing;                // Spread each window over an RTT instead of bursting it
+    char *file;                // Bulk-send this file instead of reading lines
+    int binary;                // Bulk-send stdin as a raw byte stream
+    int crc;                   // Append a CRC32C trailer to every data frame
+    int mtu;                   // Path MTU to size frames for, at most LINK_MTU
+    char *resume;              // --file progress is checkpointed here and resumed from it
     char *log_file;
+    SocketConfig sock;
+    LogConfig log;
+    MetricsConfig metrics;
+    EventLogConfig events;
 } ClientConfig;
 
+#define CLIENT_BULK_WINDOW 32  // Default window for --file / --binary
+#define CLIENT_DUPTHRESH 3     // Later messages SACKed above a hole before it counts as lost
+#define CLIENT_MAX_STREAMS 64
+#define CLIENT_STREAM_PIPE_SIZE 4096       // Lines queued per stream before the next stream is tried
+
+// The session a handshake settled on
+typedef struct {
+    uint64_t id;
+    uint32_t first_seq;        // Seq of the first message to send
+    uint64_t offset;           // Input already delivered in an earlier run, when resumed
+    uint16_t local_port;
+    uint16_t wire_payload;     // Largest payload either end takes, so every frame fits both
+    int resumed;
+} ClientSession;
+
+// One in-flight message tracked by the windowed sender
+typedef struct {
+    int in_use;
+    uint32_t seq_num;
+    int attempts;
+    int fast_retx;             // Already resent because SACKs showed it missing
+    uint64_t sent_ns;          // Monotonic time of the last transmission
+    double rto;                // Timeout armed for the last transmission
+    PacketBuf *buf;            // Wire-ready message, sent as-is on every attempt
+    uint64_t input_end;        // Input offset just past this message's bytes
+} WindowSlot;
+
+// State of one --window N transfer, shared by its event handlers
+typedef struct {
+    const ClientConfig *config;
+    int sockfd;
+    struct sockaddr_in *server_addr;
+    FILE *log_fp;
+    WindowSlot *slots;
+    int window;                // Slots, the upper bound on every other limit
+    Congestion cc;
+    uint32_t peer_edge;        // Receiver takes sequence numbers below this
+    int have_peer_window;      // Set once a SACK has advertised a window
+    uint64_t next_send_ns;     // Pacing: earliest time the next new message may go
+    int paced;                 // fill_window() stopped for pacing, not for lack of room
+    uint32_t base;             // Oldest unacknowledged sequence number
+    uint32_t next_seq;         // Next sequence number to assign
+    const ClientSession *session;
+    SessionCheckpoint checkpoint;  // --resume: progress as of the last save
+    uint64_t acked_offset;     // Input offset everything below base covers
+    uint64_t checkpoint_ns;    // When the checkpoint was last written
+    int bulk;                  // Send raw full-size chunks instead of lines
+    int input_fd;              // -1 when the whole input is mapped
+    const char *in_data;       // inbuf, or the mmap'd --file
+    size_t map_len;
+    char inbuf[MAX_RECORD_SIZE + 1];
+    size_t in_start;           // First unconsumed byte of in_data
+    size_t inlen;              // End of buffered input
+    size_t rec_consume;        // Bytes (with newline) of the record being fragmented
+    size_t rec_len;
+    uint32_t rec_id;
+    uint16_t rec_index;        // Next fragment to queue
+    uint16_t rec_count;        // 0 when no record is being fragmented
+    uint32_t next_msg_id;
+    int eof;
+    int failures;
+    uint64_t start_ns;
+    uint64_t acked_bytes;      // Payload bytes delivered, for the goodput report
+    uint64_t sent_bytes;       // Payload bytes transmitted, retransmissions included
+    int retransmits;
+    int fast_retransmits;
+    int gso;                   // Batch new bulk messages into UDP_SEGMENT sends
+    WindowSlot *gso_slots[SOCKOPT_GSO_MAX_SEGMENTS];  // Queued for the next GSO send
+    int gso_count;
+    uint64_t ack_rx_ns;        // Kernel receive time of the ACK being processed, 0 if unknown
+    RtoEstimator rto;
+    EventLoop loop;
+    EventSource sock_src;
+    EventSource stdin_src;
+} WindowedSender;
+
+// One --streams flow: its own socket, sequence space and sender thread,
+// fed whole lines through a pipe by the dispatcher
+typedef struct {
+    int id;
+    int sockfd;
+    int feed[2];               // The thread reads feed[0]; the dispatcher writes feed[1]
+    ClientSession session;
+    struct sockaddr_in *server_addr;
+    const ClientConfig *config;
+    FILE *log_fp;
+    pthread_t thread;
+    int started;
+    int result;
+} ClientStream;
+
 // Function prototypes
 int parse_client_args(int argc, char *argv[], ClientConfig *config);
-int create_udp_socket(void);
-int send_message_with_retry(int sockfd, struct sockaddr_in *server_addr,
-                            const char *payload, uint32_t seq_num,
-                            const ClientConfig *config, FILE *log_fp);
+int create_udp_socket(const SocketConfig *sock, FILE *log_fp);
+int send_frame_with_retry(int sockfd, struct sockaddr_in *server_addr,
+                          const uint8_t *frame, size_t frame_len, uint32_t seq_num, uint16_t flow,
+                          const ClientConfig *config, RtoEstimator *rto, FILE *log_fp);
+int send_record_with_retry(int sockfd, struct sockaddr_in *server_addr,
+                           const uint8_t *record, size_t len, uint32_t *seq_num, uint32_t msg_id,
+                           const ClientSession *session, const ClientConfig *config,
+                           RtoEstimator *rto, FILE *log_fp);
+int client_handshake(int sockfd, struct sockaddr_in *server_addr, const ClientConfig *config,
+                     const SessionCheckpoint *resume, ClientSession *session, FILE *log_fp);
+int run_windowed_sender(int sockfd, struct sockaddr_in *server_addr, const ClientConfig *config,
+                        int input_fd, const ClientSession *session, FILE *log_fp);
+int run_streams(struct sockaddr_in *server_addr, const ClientConfig *config, FILE *log_fp);
 void log_client(FILE *log_fp, const char *format, ...);
 
 
@@ -0,0 +1,67 @@
+#include "congestion.h"
+#include "protocol.h"
+
+void cc_init(Congestion *cc, CongestionMode mode, int max_window) {
+    cc->mode = mode;
+    cc->max_window = max_window;
+    cc->cwnd = mode == CC_FIXED || max_window < CC_INITIAL_WINDOW ? max_window : CC_INITIAL_WINDOW;
+    cc->ssthresh = max_window;
+    cc->in_recovery = 0;
+    cc->recovery_seq = 0;
+}
+
+void cc_on_ack(Congestion *cc, uint32_t seq_num) {
+    if (cc->mode == CC_FIXED) {
+        return;
+    }
+    if (cc->in_recovery && !seq_before(seq_num, cc->recovery_seq)) {
+        cc->in_recovery = 0;
+    }
+
+    if (cc->cwnd < cc->ssthresh) {
+        cc->cwnd += 1.0;
+    } else {
+        cc->cwnd += 1.0 / cc->cwnd;
+    }
+    if (cc->cwnd > cc->max_window) {
+        cc->cwnd = cc->max_window;
+    }
+}
+
+// seq_num was lost; next_seq is the first sequence number not yet sent
+void cc_on_loss(Congestion *cc, uint32_t seq_num, uint32_t next_seq) {
+    if (cc->mode == CC_FIXED || (cc->in_recovery && seq_before(seq_num, cc->recovery_seq))) {
+        return;
+    }
+
+    cc->ssthresh = cc->cwnd / 2.0 < CC_MIN_SSTHRESH ? CC_MIN_SSTHRESH : cc->cwnd / 2.0;
+    cc->cwnd = cc->ssthresh;
+    cc->in_recovery = 1;
+    cc->recovery_seq = next_seq;
+}
+
+// A whole round of timers expired: the path may be gone, so start over
+void cc_on_timeout(Congestion *cc, uint32_t next_seq) {
+    if (cc->mode == CC_FIXED) {
+        return;
+    }
+
+    cc->ssthresh = cc->cwnd / 2.0 < CC_MIN_SSTHRESH ? CC_MIN_SSTHRESH : cc->cwnd / 2.0;
+    cc->cwnd = 1.0;
+    cc->in_recovery = 1;
+    cc->recovery_seq = next_seq;
+}
+
+int cc_window(const Congestion *cc) {
+    int window = (int)cc->cwnd;
+    return window < 1 ? 1 : window;
+}
+
+// Spreads one window over one smoothed RTT; 0 means send without pacing.
+// A single message in flight is already clocked by its ACK.
+uint64_t cc_pacing_interval_ns(const Congestion *cc, double srtt) {
+    if (cc->mode == CC_FIXED || srtt <= 0.0 || cc->cwnd < 2.0) {
+        return 0;
+    }
+    return (uint64_t)(srtt * 1e9 / cc->cwnd);
+}
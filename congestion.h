@@ -0,0 +1,39 @@
+#ifndef COMP7005PROJ1_CONGESTION_H
+#define COMP7005PROJ1_CONGESTION_H
+
+#include <stdint.h>
+
+#define CC_INITIAL_WINDOW 4           // Messages in flight before any feedback
+#define CC_MIN_SSTHRESH 2.0
+#define CC_PACING_BURST 2             // Messages that may leave back to back after an idle period
+#define CC_PACING_SLACK_NS 1000000ULL // Event loop timers fire in whole milliseconds; catch up that much
+
+typedef enum {
+    CC_FIXED,                 // Always the whole --window, the old behaviour
+    CC_AIMD                   // Slow start, then additive increase / multiplicative decrease
+} CongestionMode;
+
+/*
+ * Reno-style congestion window in messages. Slow start grows it by one per
+ * ACK up to ssthresh, congestion avoidance by one per window's worth of
+ * ACKs. A loss halves it at most once per window of data; a timeout drops
+ * it to one message.
+ */
+typedef struct {
+    CongestionMode mode;
+    double cwnd;
+    double ssthresh;
+    int max_window;
+    int in_recovery;
+    uint32_t recovery_seq;    // Losses below this belong to the reduction already made
+} Congestion;
+
+// Function prototypes
+void cc_init(Congestion *cc, CongestionMode mode, int max_window);
+void cc_on_ack(Congestion *cc, uint32_t seq_num);
+void cc_on_loss(Congestion *cc, uint32_t seq_num, uint32_t next_seq);
+void cc_on_timeout(Congestion *cc, uint32_t next_seq);
+int cc_window(const Congestion *cc);
+uint64_t cc_pacing_interval_ns(const Congestion *cc, double srtt);
+
+#endif //COMP7005PROJ1_CONGESTION_H
@@ -0,0 +1,125 @@
+#include "crc32c.h"
+#include <string.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <nmmintrin.h>
+#define HAVE_CRC32C_SSE42 1
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define HAVE_CRC32C_ARM 1
+#endif
+
+#define CRC32C_POLY 0x82F63B78u   // Reflected Castagnoli polynomial
+
+typedef uint32_t (*Crc32cFn)(uint32_t crc, const uint8_t *p, size_t len);
+
+// Slicing-by-8: table[k][b] is the CRC of byte b followed by k zero bytes
+static uint32_t table[8][256];
+static Crc32cFn impl_fn;
+static const char *impl_name;
+
+static uint32_t crc32c_table(uint32_t crc, const uint8_t *p, size_t len) {
+    while (len > 0 && ((uintptr_t)p & 7) != 0) {
+        crc = table[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+        len--;
+    }
+    while (len >= 8) {
+        uint32_t lo, hi;
+        memcpy(&lo, p, 4);
+        memcpy(&hi, p + 4, 4);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        lo = __builtin_bswap32(lo);
+        hi = __builtin_bswap32(hi);
+#endif
+        lo ^= crc;
+        crc = table[7][lo & 0xFF] ^ table[6][(lo >> 8) & 0xFF] ^
+              table[5][(lo >> 16) & 0xFF] ^ table[4][lo >> 24] ^
+              table[3][hi & 0xFF] ^ table[2][(hi >> 8) & 0xFF] ^
+              table[1][(hi >> 16) & 0xFF] ^ table[0][hi >> 24];
+        p += 8;
+        len -= 8;
+    }
+    while (len-- > 0) {
+        crc = table[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#ifdef HAVE_CRC32C_SSE42
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42(uint32_t crc, const uint8_t *p, size_t len) {
+    uint64_t c = crc;
+    while (len >= 8) {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        c = _mm_crc32_u64(c, v);
+        p += 8;
+        len -= 8;
+    }
+    crc = (uint32_t)c;
+    while (len-- > 0) {
+        crc = _mm_crc32_u8(crc, *p++);
+    }
+    return crc;
+}
+#endif
+
+#ifdef HAVE_CRC32C_ARM
+static uint32_t crc32c_arm(uint32_t crc, const uint8_t *p, size_t len) {
+    while (len >= 8) {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        crc = __crc32cd(crc, v);
+        p += 8;
+        len -= 8;
+    }
+    while (len-- > 0) {
+        crc = __crc32cb(crc, *p++);
+    }
+    return crc;
+}
+#endif
+
+// Runs before main(), so worker threads never see the tables half built
+__attribute__((constructor))
+static void crc32c_init(void) {
+    for (uint32_t b = 0; b < 256; b++) {
+        uint32_t crc = b;
+        for (int k = 0; k < 8; k++) {
+            crc = (crc >> 1) ^ (CRC32C_POLY & (0u - (crc & 1)));
+        }
+        table[0][b] = crc;
+    }
+    for (uint32_t b = 0; b < 256; b++) {
+        for (int k = 1; k < 8; k++) {
+            table[k][b] = table[0][table[k - 1][b] & 0xFF] ^ (table[k - 1][b] >> 8);
+        }
+    }
+
+    impl_fn = crc32c_table;
+    impl_name = "table";
+#ifdef HAVE_CRC32C_SSE42
+    // Constructors may run before libgcc's own CPU detection
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2")) {
+        impl_fn = crc32c_sse42;
+        impl_name = "sse4.2";
+    }
+#elif defined(HAVE_CRC32C_ARM)
+    impl_fn = crc32c_arm;
+    impl_name = "armv8-crc";
+#endif
+}
+
+uint32_t crc32c(uint32_t crc, const void *data, size_t len) {
+    return ~impl_fn(~crc, data, len);
+}
+
+// Always the table walk, whatever the CPU offers
+uint32_t crc32c_sw(uint32_t crc, const void *data, size_t len) {
+    return ~crc32c_table(~crc, data, len);
+}
+
+const char *crc32c_impl(void) {
+    return impl_name;
+}
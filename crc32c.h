@@ -0,0 +1,20 @@
+#ifndef COMP7005PROJ1_CRC32C_H
+#define COMP7005PROJ1_CRC32C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * CRC32C (Castagnoli), the checksum iSCSI, SCTP and ext4 use. crc32c()
+ * picks the CPU's CRC instruction when there is one (SSE4.2 on x86-64,
+ * the ARMv8 CRC extension when the build enables it) and otherwise a
+ * slicing-by-8 table walk that folds in 8 bytes per step. Pass 0 to start
+ * a new checksum, or a previous result to extend it.
+ */
+
+// Function prototypes
+uint32_t crc32c(uint32_t crc, const void *data, size_t len);
+uint32_t crc32c_sw(uint32_t crc, const void *data, size_t len);
+const char *crc32c_impl(void);
+
+#endif //COMP7005PROJ1_CRC32C_H
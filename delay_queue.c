@@ -0,0 +1,151 @@
+#include "delay_queue.h"
+#include <stdlib.h>
+#include <string.h>
+
+int delay_queue_init(DelayQueue *q, int capacity) {
+    memset(q, 0, sizeof(*q));
+    if (capacity <= 0) {
+        return -1;
+    }
+
+    q->pool = malloc((size_t)capacity * sizeof(DelayedPacket));
+    q->free_list = malloc((size_t)capacity * sizeof(int));
+    q->heap = malloc((size_t)capacity * sizeof(int));
+    if (!q->pool || !q->free_list || !q->heap) {
+        delay_queue_destroy(q);
+        return -1;
+    }
+
+    q->capacity = capacity;
+    for (int i = 0; i < capacity; i++) {
+        q->free_list[i] = capacity - 1 - i;
+    }
+    q->free_count = capacity;
+    return 0;
+}
+
+void delay_queue_destroy(DelayQueue *q) {
+    for (int i = 0; i < q->size; i++) {
+        packet_free(q->pool[q->heap[i]].buf);
+    }
+    free(q->pool);
+    free(q->free_list);
+    free(q->heap);
+    memset(q, 0, sizeof(*q));
+}
+
+static int heap_less(const DelayQueue *q, int a, int b) {
+    const DelayedPacket *pa = &q->pool[q->heap[a]];
+    const DelayedPacket *pb = &q->pool[q->heap[b]];
+    if (pa->release_ns != pb->release_ns) {
+        return pa->release_ns < pb->release_ns;
+    }
+    return pa->order < pb->order;
+}
+
+static void heap_swap(DelayQueue *q, int a, int b) {
+    int tmp = q->heap[a];
+    q->heap[a] = q->heap[b];
+    q->heap[b] = tmp;
+}
+
+int delay_queue_push(DelayQueue *q, uint64_t release_ns, int fd, int direction,
+                     const struct sockaddr_in *dest, socklen_t dest_len,
+                     const uint8_t *data, size_t len) {
+    if (q->free_count == 0 || len > PACKET_BUF_SIZE) {
+        return -1;
+    }
+    PacketBuf *buf = packet_alloc();
+    if (!buf) {
+        return -1;
+    }
+    buf->len = len;
+    memcpy(buf->data, data, len);
+
+    if (delay_queue_push_buf(q, release_ns, fd, direction, dest, dest_len, buf) < 0) {
+        packet_free(buf);
+        return -1;
+    }
+    return 0;
+}
+
+// Queue a packet already held in a pool buffer; the queue owns buf on success
+int delay_queue_push_buf(DelayQueue *q, uint64_t release_ns, int fd, int direction,
+                         const struct sockaddr_in *dest, socklen_t dest_len, PacketBuf *buf) {
+    if (q->free_count == 0) {
+        return -1;
+    }
+
+    int idx = q->free_list[--q->free_count];
+    DelayedPacket *pkt = &q->pool[idx];
+    pkt->release_ns = release_ns;
+    pkt->order = q->next_order++;
+    pkt->fd = fd;
+    pkt->direction = direction;
+    pkt->dest = *dest;
+    pkt->dest_len = dest_len;
+    pkt->buf = buf;
+
+    // Sift up
+    int i = q->size++;
+    q->heap[i] = idx;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!heap_less(q, i, parent)) break;
+        heap_swap(q, i, parent);
+        i = parent;
+    }
+
+    return 0;
+}
+
+DelayedPacket *delay_queue_peek(const DelayQueue *q) {
+    if (q->size == 0) {
+        return NULL;
+    }
+    return &q->pool[q->heap[0]];
+}
+
+// Remove the earliest packet and hand its buffer to the caller
+PacketBuf *delay_queue_take(DelayQueue *q) {
+    if (q->size == 0) {
+        return NULL;
+    }
+
+    PacketBuf *buf = q->pool[q->heap[0]].buf;
+    q->free_list[q->free_count++] = q->heap[0];
+    q->heap[0] = q->heap[--q->size];
+
+    // Sift down
+    int i = 0;
+    for (;;) {
+        int left = 2 * i + 1;
+        int right = left + 1;
+        int smallest = i;
+        if (left < q->size && heap_less(q, left, smallest)) smallest = left;
+        if (right < q->size && heap_less(q, right, smallest)) smallest = right;
+        if (smallest == i) break;
+        heap_swap(q, i, smallest);
+        i = smallest;
+    }
+    return buf;
+}
+
+void delay_queue_pop(DelayQueue *q) {
+    PacketBuf *buf = delay_queue_take(q);
+    if (buf) {
+        packet_free(buf);
+    }
+}
+
+// Milliseconds until the next release (rounded up), or -1 if the queue is empty
+int delay_queue_timeout_ms(const DelayQueue *q, uint64_t now_ns) {
+    const DelayedPacket *next = delay_queue_peek(q);
+    if (!next) {
+        return -1;
+    }
+    if (next->release_ns <= now_ns) {
+        return 0;
+    }
+    return (int)((next->release_ns - now_ns + 999999ULL) / 1000000ULL);
+}
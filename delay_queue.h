@@ -0,0 +1,47 @@
+#ifndef COMP7005PROJ1_DELAY_QUEUE_H
+#define COMP7005PROJ1_DELAY_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "packet_pool.h"
+
+#define DELAY_QUEUE_DEFAULT_CAPACITY 4096
+
+// A packet held back by the proxy until its release time
+typedef struct {
+    uint64_t release_ns;      // Monotonic time at which to forward
+    uint64_t order;           // Insertion order, keeps equal deadlines FIFO
+    int fd;                   // Socket to forward on
+    int direction;
+    struct sockaddr_in dest;
+    socklen_t dest_len;
+    PacketBuf *buf;           // Borrowed from the packet pool while queued
+} DelayedPacket;
+
+// Min-heap of delayed packets keyed on release time, backed by a fixed pool
+typedef struct {
+    DelayedPacket *pool;
+    int *free_list;
+    int free_count;
+    int *heap;                // Pool indices ordered by (release_ns, order)
+    int size;
+    int capacity;
+    uint64_t next_order;
+} DelayQueue;
+
+// Function prototypes
+int delay_queue_init(DelayQueue *q, int capacity);
+void delay_queue_destroy(DelayQueue *q);
+int delay_queue_push(DelayQueue *q, uint64_t release_ns, int fd, int direction,
+                     const struct sockaddr_in *dest, socklen_t dest_len,
+                     const uint8_t *data, size_t len);
+int delay_queue_push_buf(DelayQueue *q, uint64_t release_ns, int fd, int direction,
+                         const struct sockaddr_in *dest, socklen_t dest_len, PacketBuf *buf);
+DelayedPacket *delay_queue_peek(const DelayQueue *q);
+void delay_queue_pop(DelayQueue *q);
+PacketBuf *delay_queue_take(DelayQueue *q);
+int delay_queue_timeout_ms(const DelayQueue *q, uint64_t now_ns);
+
+#endif //COMP7005PROJ1_DELAY_QUEUE_H
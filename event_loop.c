@@ -0,0 +1,263 @@
+#include "event_loop.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#define HAVE_EPOLL 1
+#endif
+
+uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void drain_wake_pipe(EventSource *src, uint32_t events) {
+    (void)events;
+    char buf[64];
+    while (read(src->fd, buf, sizeof(buf)) > 0) {
+    }
+}
+
+static int track_source(EventLoop *loop, EventSource *src) {
+    if (loop->count == loop->capacity) {
+        int capacity = loop->capacity ? loop->capacity * 2 : 16;
+        EventSource **sources = realloc(loop->sources, (size_t)capacity * sizeof(*sources));
+        if (!sources) {
+            return -1;
+        }
+        loop->sources = sources;
+        loop->capacity = capacity;
+    }
+
+    src->slot = loop->count;
+    loop->sources[loop->count++] = src;
+    return 0;
+}
+
+static void untrack_source(EventLoop *loop, EventSource *src) {
+    int slot = src->slot;
+    if (slot < 0 || slot >= loop->count || loop->sources[slot] != src) {
+        return;
+    }
+    loop->sources[slot] = loop->sources[--loop->count];
+    loop->sources[slot]->slot = slot;
+    src->slot = -1;
+}
+
+int event_loop_init(EventLoop *loop) {
+    memset(loop, 0, sizeof(*loop));
+    loop->epfd = -1;
+    loop->wake_pipe[0] = loop->wake_pipe[1] = -1;
+
+#ifdef HAVE_EPOLL
+    loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->epfd < 0) {
+        return -1;
+    }
+#endif
+
+    if (pipe(loop->wake_pipe) < 0) {
+        event_loop_destroy(loop);
+        return -1;
+    }
+    for (int i = 0; i < 2; i++) {
+        fcntl(loop->wake_pipe[i], F_SETFL, fcntl(loop->wake_pipe[i], F_GETFL) | O_NONBLOCK);
+        fcntl(loop->wake_pipe[i], F_SETFD, FD_CLOEXEC);
+    }
+
+    if (event_loop_add(loop, &loop->wake_src, loop->wake_pipe[0],
+                       drain_wake_pipe, NULL, NULL) < 0) {
+        event_loop_destroy(loop);
+        return -1;
+    }
+    return 0;
+}
+
+void event_loop_destroy(EventLoop *loop) {
+    if (loop->epfd >= 0) close(loop->epfd);
+    if (loop->wake_pipe[0] >= 0) close(loop->wake_pipe[0]);
+    if (loop->wake_pipe[1] >= 0) close(loop->wake_pipe[1]);
+    free(loop->sources);
+    memset(loop, 0, sizeof(*loop));
+    loop->epfd = -1;
+    loop->wake_pipe[0] = loop->wake_pipe[1] = -1;
+}
+
+int event_loop_add(EventLoop *loop, EventSource *src, int fd,
+                   EventHandler handler, void *ctx, void *data) {
+    src->fd = fd;
+    src->events = EVENT_READ;
+    src->handler = handler;
+    src->ctx = ctx;
+    src->data = data;
+    src->always_ready = 0;
+    src->slot = -1;
+
+#ifdef HAVE_EPOLL
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = src;
+    if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        if (errno != EPERM) {
+            return -1;
+        }
+        src->always_ready = 1;  // Regular file (e.g. stdin redirected from disk)
+    }
+#endif
+
+    if (track_source(loop, src) < 0) {
+#ifdef HAVE_EPOLL
+        if (!src->always_ready) epoll_ctl(loop->epfd, EPOLL_CTL_DEL, fd, NULL);
+#endif
+        return -1;
+    }
+    return 0;
+}
+
+// Change the interest set; 0 pauses the source without forgetting it. A
+// paused fd is taken out of epoll entirely, since epoll reports hang-ups
+// even with an empty interest set.
+int event_loop_modify(EventLoop *loop, EventSource *src, uint32_t events) {
+    if (src->events == events) {
+        return 0;
+    }
+    uint32_t old_events = src->events;
+    src->events = events;
+
+#ifdef HAVE_EPOLL
+    if (!src->always_ready) {
+        if (!events) {
+            return epoll_ctl(loop->epfd, EPOLL_CTL_DEL, src->fd, NULL);
+        }
+
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.ptr = src;
+        return epoll_ctl(loop->epfd, old_events ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, src->fd, &ev);
+    }
+#else
+    (void)loop;
+    (void)old_events;
+#endif
+    return 0;
+}
+
+void event_loop_remove(EventLoop *loop, EventSource *src) {
+#ifdef HAVE_EPOLL
+    if (!src->always_ready && src->events) {
+        epoll_ctl(loop->epfd, EPOLL_CTL_DEL, src->fd, NULL);
+    }
+#endif
+    untrack_source(loop, src);
+}
+
+// Async-signal-safe: interrupts a wait in progress (or the next one)
+void event_loop_wakeup(EventLoop *loop) {
+    if (loop->wake_pipe[1] >= 0) {
+        ssize_t n = write(loop->wake_pipe[1], "x", 1);
+        (void)n;
+    }
+}
+
+static int timeout_ms_until(uint64_t deadline_ns) {
+    if (deadline_ns == EVENT_LOOP_NO_DEADLINE) {
+        return -1;
+    }
+
+    uint64_t now = monotonic_ns();
+    if (deadline_ns <= now) {
+        return 0;
+    }
+
+    uint64_t ms = (deadline_ns - now + 999999ULL) / 1000000ULL;
+    return ms > 60000 ? 60000 : (int)ms;
+}
+
+/*
+ * Wait until a source is readable or the deadline passes, then run the
+ * handlers of every ready source. A handler may pause or remove its own
+ * source, but must not remove other sources. Returns the number of
+ * handlers run, 0 on timeout or signal, -1 on error.
+ */
+int event_loop_poll(EventLoop *loop, uint64_t deadline_ns) {
+    int timeout_ms = timeout_ms_until(deadline_ns);
+
+    // Always-ready sources must not block the wait
+    for (int i = 0; i < loop->count; i++) {
+        if (loop->sources[i]->always_ready && (loop->sources[i]->events & EVENT_READ)) {
+            timeout_ms = 0;
+            break;
+        }
+    }
+
+    int dispatched = 0;
+
+#ifdef HAVE_EPOLL
+    struct epoll_event events[EVENT_LOOP_MAX_EVENTS];
+    int n = epoll_wait(loop->epfd, events, EVENT_LOOP_MAX_EVENTS, timeout_ms);
+    if (n < 0) {
+        return errno == EINTR ? 0 : -1;
+    }
+
+    for (int i = 0; i < n; i++) {
+        EventSource *src = events[i].data.ptr;
+        uint32_t ev = 0;
+        if (events[i].events & EPOLLIN) ev |= EVENT_READ;
+        if (events[i].events & (EPOLLERR | EPOLLHUP)) ev |= EVENT_ERROR | EVENT_READ;
+        src->handler(src, ev);
+        dispatched++;
+    }
+#else
+    struct pollfd *pfds = calloc((size_t)loop->count, sizeof(struct pollfd));
+    EventSource **ready = calloc((size_t)loop->count, sizeof(EventSource *));
+    int count = loop->count;
+    if (!pfds || !ready) {
+        free(pfds);
+        free(ready);
+        return -1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        ready[i] = loop->sources[i];
+        pfds[i].fd = (ready[i]->events & EVENT_READ) ? ready[i]->fd : -1;
+        pfds[i].events = POLLIN;
+    }
+
+    int n = poll(pfds, (nfds_t)count, timeout_ms);
+    if (n < 0) {
+        free(pfds);
+        free(ready);
+        return errno == EINTR ? 0 : -1;
+    }
+
+    for (int i = 0; i < count && n > 0; i++) {
+        if (!pfds[i].revents) continue;
+        uint32_t ev = EVENT_READ;
+        if (pfds[i].revents & (POLLERR | POLLHUP | POLLNVAL)) ev |= EVENT_ERROR;
+        ready[i]->handler(ready[i], ev);
+        dispatched++;
+    }
+    free(pfds);
+    free(ready);
+    return dispatched;
+#endif
+
+    // Sources epoll cannot watch are reported readable on every pass
+    for (int i = 0; i < loop->count; i++) {
+        EventSource *src = loop->sources[i];
+        if (src->always_ready && (src->events & EVENT_READ)) {
+            src->handler(src, EVENT_READ);
+            dispatched++;
+        }
+    }
+    return dispatched;
+}
@@ -0,0 +1,48 @@
+#ifndef COMP7005PROJ1_EVENT_LOOP_H
+#define COMP7005PROJ1_EVENT_LOOP_H
+
+#include <stdint.h>
+
+#define EVENT_READ  0x1u
+#define EVENT_ERROR 0x2u
+
+// Passed as a deadline to wait until a descriptor becomes ready
+#define EVENT_LOOP_NO_DEADLINE UINT64_MAX
+
+#define EVENT_LOOP_MAX_EVENTS 64
+
+typedef struct EventSource EventSource;
+typedef void (*EventHandler)(EventSource *src, uint32_t events);
+
+// A registered descriptor; owned by the caller and must outlive its registration
+struct EventSource {
+    int fd;
+    uint32_t events;          // Interest set, 0 while paused
+    EventHandler handler;
+    void *ctx;                // Shared context (e.g. the server or proxy state)
+    void *data;               // Per-source datum (e.g. a proxy session)
+    int always_ready;         // Regular files cannot be polled; treat as readable
+    int slot;                 // Index in the loop's bookkeeping arrays
+};
+
+typedef struct {
+    int epfd;                 // epoll instance (-1 when using poll())
+    int wake_pipe[2];         // Self-pipe so signal handlers can interrupt a wait
+    EventSource wake_src;
+    EventSource **sources;    // Every registered source, for poll() and always-ready fds
+    int count;
+    int capacity;
+} EventLoop;
+
+// Function prototypes
+uint64_t monotonic_ns(void);
+int event_loop_init(EventLoop *loop);
+void event_loop_destroy(EventLoop *loop);
+int event_loop_add(EventLoop *loop, EventSource *src, int fd,
+                   EventHandler handler, void *ctx, void *data);
+int event_loop_modify(EventLoop *loop, EventSource *src, uint32_t events);
+void event_loop_remove(EventLoop *loop, EventSource *src);
+int event_loop_poll(EventLoop *loop, uint64_t deadline_ns);
+void event_loop_wakeup(EventLoop *loop);
+
+#endif //COMP7005PROJ1_EVENT_LOOP_H
@@ -0,0 +1,125 @@
+#include "evlog.h"
+#include "event_loop.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+int evlog_active;
+static int evlog_fd = -1;
+
+// Each thread batches its own records, so emitting never takes a lock;
+// O_APPEND keeps every thread's whole-record writes from interleaving
+static _Thread_local EventRecord *thread_buf;
+static _Thread_local int thread_count;
+
+void evlog_config_default(EventLogConfig *config) {
+    config->path = NULL;
+}
+
+int evlog_parse_arg(int argc, char *argv[], int *i, EventLogConfig *config) {
+    if (strcmp(argv[*i], "--event-log") == 0 && *i + 1 < argc) {
+        config->path = argv[++*i];
+        return 1;
+    }
+    return 0;
+}
+
+static int write_all(int fd, const void *data, size_t len) {
+    const char *p = data;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+int evlog_open(const EventLogConfig *config, EventRole role) {
+    if (!config->path) {
+        return 0;
+    }
+
+    int fd = open(config->path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+
+    EventLogHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, EVLOG_MAGIC, sizeof(header.magic));
+    header.version = EVLOG_VERSION;
+    header.record_size = sizeof(EventRecord);
+    header.role = (uint8_t)role;
+
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    header.monotonic_ns = monotonic_ns();
+    header.realtime_ns = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+
+    if (write_all(fd, &header, sizeof(header)) < 0) {
+        close(fd);
+        return -1;
+    }
+    evlog_fd = fd;
+    evlog_active = 1;
+    return 0;
+}
+
+static void flush_buffer(void) {
+    if (thread_count > 0 && evlog_fd >= 0) {
+        write_all(evlog_fd, thread_buf, (size_t)thread_count * sizeof(EventRecord));
+    }
+    thread_count = 0;
+}
+
+// Call before a thread that emitted events exits
+void evlog_thread_flush(void) {
+    flush_buffer();
+    free(thread_buf);
+    thread_buf = NULL;
+}
+
+// Flushes the calling thread; other threads must have flushed already
+void evlog_close(void) {
+    evlog_active = 0;
+    evlog_thread_flush();
+    if (evlog_fd >= 0) {
+        close(evlog_fd);
+        evlog_fd = -1;
+    }
+}
+
+void evlog_write(uint32_t flow, uint8_t type, uint8_t direction, uint32_t seq, uint16_t attempt,
+                 uint32_t bytes, uint32_t extra) {
+    if (!thread_buf) {
+        thread_buf = malloc(EVLOG_BUFFER_RECORDS * sizeof(EventRecord));
+        if (!thread_buf) {
+            return;
+        }
+        thread_count = 0;
+    }
+
+    EventRecord *r = &thread_buf[thread_count++];
+    r->ts_ns = monotonic_ns();
+    r->seq = seq;
+    r->bytes = bytes;
+    r->extra = extra;
+    r->flow = flow;
+    r->type = type;
+    r->direction = direction;
+    r->attempt = attempt;
+    r->reserved = 0;
+
+    if (thread_count == EVLOG_BUFFER_RECORDS) {
+        flush_buffer();
+    }
+}
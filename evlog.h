@@ -0,0 +1,97 @@
+#ifndef COMP7005PROJ1_EVLOG_H
+#define COMP7005PROJ1_EVLOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define EVLOG_MAGIC "UDPEVT01"
+#define EVLOG_VERSION 2
+#define EVLOG_BUFFER_RECORDS 2048     // Per thread, written out with one write() when full
+#define EVLOG_USAGE "[--event-log <file>]"
+
+typedef enum {
+    EVLOG_ROLE_CLIENT = 1,
+    EVLOG_ROLE_SERVER = 2,
+    EVLOG_ROLE_PROXY = 3
+} EventRole;
+
+typedef enum {
+    // Client
+    EV_SEND = 1,              // attempt, bytes = payload length
+    EV_ACK_RECV = 2,          // extra = RTT in microseconds; bench measures from the first transmission
+    EV_TIMEOUT = 3,           // attempt that timed out
+    EV_FAILED = 4,            // attempt = attempts made
+    // Server
+    EV_RECV = 16,             // bytes = payload length
+    EV_ACK_SEND = 17,
+    EV_SACK_SEND = 18,        // seq = cumulative ack point, bytes = advertised window
+    EV_DUPLICATE = 19,
+    // Proxy; direction is DIR_CLIENT_TO_SERVER or DIR_SERVER_TO_CLIENT
+    EV_PROXY_RECV = 32,
+    EV_PROXY_DROP = 33,
+    EV_PROXY_DELAY = 34,      // extra = delay in milliseconds
+    EV_PROXY_QUEUE_FULL = 35,
+    EV_PROXY_FORWARD = 36,
+    EV_PROXY_REORDER = 37,    // extra = hold-back in milliseconds
+    EV_PROXY_DUPLICATE = 38,
+    EV_PROXY_RATE_DROP = 39,  // No room in the rate-limited bottleneck's buffer
+    EV_PROXY_CORRUPT = 40,    // extra = index of the flipped bit
+    EV_PROXY_CRC_DROP = 41    // Arrived with a CRC32C trailer that did not match (--verify-crc)
+} EventType;
+
+// File header, followed by nothing but EventRecords. Host byte order.
+typedef struct {
+    char magic[8];
+    uint16_t version;
+    uint16_t record_size;
+    uint8_t role;             // EventRole
+    uint8_t reserved[3];
+    uint64_t realtime_ns;     // Wall clock when the log was opened...
+    uint64_t monotonic_ns;    // ...and the monotonic clock at the same moment
+} EventLogHeader;
+
+// One fixed-size event; 32 bytes, no payload contents
+typedef struct {
+    uint64_t ts_ns;           // CLOCK_MONOTONIC
+    uint32_t seq;
+    uint32_t bytes;
+    uint32_t extra;           // Per-type detail, see EventType
+    uint32_t flow;            // Which sender seq belongs to: bench's flow, the client's local port; else 0
+    uint8_t type;
+    uint8_t direction;
+    uint16_t attempt;
+    uint32_t reserved;
+} EventRecord;
+
+typedef struct {
+    const char *path;         // NULL = no event log
+} EventLogConfig;
+
+extern int evlog_active;
+
+// Function prototypes
+void evlog_config_default(EventLogConfig *config);
+int evlog_parse_arg(int argc, char *argv[], int *i, EventLogConfig *config);
+int evlog_open(const EventLogConfig *config, EventRole role);
+void evlog_close(void);
+void evlog_thread_flush(void);
+void evlog_write(uint32_t flow, uint8_t type, uint8_t direction, uint32_t seq, uint16_t attempt,
+                 uint32_t bytes, uint32_t extra);
+
+// Costs one branch when no event log is open
+static inline void evlog_emit(uint8_t type, uint8_t direction, uint32_t seq, uint16_t attempt,
+                              uint32_t bytes, uint32_t extra) {
+    if (evlog_active) {
+        evlog_write(0, type, direction, seq, attempt, bytes, extra);
+    }
+}
+
+// For logs with several senders, whose sequence numbers may coincide
+static inline void evlog_emit_flow(uint32_t flow, uint8_t type, uint8_t direction, uint32_t seq,
+                                   uint16_t attempt, uint32_t bytes, uint32_t extra) {
+    if (evlog_active) {
+        evlog_write(flow, type, direction, seq, attempt, bytes, extra);
+    }
+}
+
+#endif //COMP7005PROJ1_EVLOG_H
@@ -0,0 +1,75 @@
+#include "histogram.h"
+#include <string.h>
+
+static unsigned bucket_index(uint64_t value) {
+    if (value < HIST_SUB_COUNT) {
+        return (unsigned)value;
+    }
+
+    // Keep the top HIST_SUB_BITS bits; the shift selects the power of two
+    unsigned shift = (unsigned)(63 - __builtin_clzll(value)) - HIST_SUB_BITS + 1;
+    return shift * (HIST_SUB_COUNT / 2) + (unsigned)(value >> shift);
+}
+
+// Highest value that lands in bucket idx
+static uint64_t bucket_upper(unsigned idx) {
+    if (idx < HIST_SUB_COUNT) {
+        return idx;
+    }
+
+    unsigned shift = idx / (HIST_SUB_COUNT / 2) - 1;
+    uint64_t mantissa = idx - shift * (HIST_SUB_COUNT / 2);
+    return ((mantissa + 1) << shift) - 1;
+}
+
+void histogram_init(Histogram *h) {
+    memset(h, 0, sizeof(*h));
+    h->min = UINT64_MAX;
+}
+
+void histogram_record(Histogram *h, uint64_t value) {
+    if (value > HIST_MAX_VALUE) {
+        value = HIST_MAX_VALUE;
+    }
+
+    h->counts[bucket_index(value)]++;
+    h->total++;
+    h->sum += (double)value;
+    if (value < h->min) h->min = value;
+    if (value > h->max) h->max = value;
+}
+
+void histogram_merge(Histogram *dst, const Histogram *src) {
+    for (unsigned i = 0; i < HIST_BUCKETS; i++) {
+        dst->counts[i] += src->counts[i];
+    }
+    dst->total += src->total;
+    dst->sum += src->sum;
+    if (src->min < dst->min) dst->min = src->min;
+    if (src->max > dst->max) dst->max = src->max;
+}
+
+// Smallest bucket bound covering the given share of samples, percentile in [0, 100]
+uint64_t histogram_percentile(const Histogram *h, double percentile) {
+    if (h->total == 0) {
+        return 0;
+    }
+
+    uint64_t rank = (uint64_t)(percentile / 100.0 * (double)h->total + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > h->total) rank = h->total;
+
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->counts[i];
+        if (seen >= rank) {
+            uint64_t upper = bucket_upper(i);
+            return upper > h->max ? h->max : upper;
+        }
+    }
+    return h->max;
+}
+
+double histogram_mean(const Histogram *h) {
+    return h->total ? h->sum / (double)h->total : 0.0;
+}
@@ -0,0 +1,30 @@
+#ifndef COMP7005PROJ1_HISTOGRAM_H
+#define COMP7005PROJ1_HISTOGRAM_H
+
+#include <stdint.h>
+
+// HDR-style log-linear buckets: every power of two is split into
+// HIST_SUB_COUNT / 2 linear steps, so any recorded value is reported
+// within 1/64 (~1.6%) of itself from 1 ns up to HIST_MAX_VALUE.
+#define HIST_SUB_BITS 7
+#define HIST_SUB_COUNT (1u << HIST_SUB_BITS)
+#define HIST_MAX_SHIFT 34
+#define HIST_BUCKETS ((HIST_MAX_SHIFT + 1) * (HIST_SUB_COUNT / 2) + HIST_SUB_COUNT / 2)
+#define HIST_MAX_VALUE (((uint64_t)HIST_SUB_COUNT << HIST_MAX_SHIFT) - 1)
+
+typedef struct {
+    uint64_t counts[HIST_BUCKETS];
+    uint64_t total;
+    uint64_t min;
+    uint64_t max;
+    double sum;
+} Histogram;
+
+// Function prototypes
+void histogram_init(Histogram *h);
+void histogram_record(Histogram *h, uint64_t value);
+void histogram_merge(Histogram *dst, const Histogram *src);
+uint64_t histogram_percentile(const Histogram *h, double percentile);
+double histogram_mean(const Histogram *h);
+
+#endif //COMP7005PROJ1_HISTOGRAM_H
@@ -0,0 +1,193 @@
+#include "impair.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Network impairment models for the proxy. Every random choice comes from
+ * a per-direction PCG32 stream, so a run is reproducible from its seed as
+ * long as packets arrive in the same order.
+ */
+
+void rng_seed(Rng *rng, uint64_t seed, uint64_t stream) {
+    rng->state = 0;
+    rng->inc = (stream << 1) | 1;
+    rng_next(rng);
+    rng->state += seed;
+    rng_next(rng);
+}
+
+uint32_t rng_next(Rng *rng) {
+    uint64_t old = rng->state;
+    rng->state = old * 6364136223846793005ULL + rng->inc;
+    uint32_t xorshifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+    uint32_t rot = (uint32_t)(old >> 59);
+    return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+}
+
+// Uniform in [0, bound) without modulo bias (Lemire's multiply-and-reject)
+uint32_t rng_below(Rng *rng, uint32_t bound) {
+    uint64_t m = (uint64_t)rng_next(rng) * bound;
+    uint32_t low = (uint32_t)m;
+    if (low < bound) {
+        uint32_t threshold = -bound % bound;
+        while (low < threshold) {
+            m = (uint64_t)rng_next(rng) * bound;
+            low = (uint32_t)m;
+        }
+    }
+    return (uint32_t)(m >> 32);
+}
+
+// Uniform in [0, 1)
+double rng_uniform(Rng *rng) {
+    return rng_next(rng) * (1.0 / 4294967296.0);
+}
+
+static int chance(Rng *rng, double percent) {
+    if (percent <= 0) return 0;
+    if (percent >= 100) return 1;
+    return rng_uniform(rng) * 100.0 < percent;
+}
+
+void impair_config_default(ImpairConfig *config) {
+    memset(config, 0, sizeof(*config));
+    config->burst_loss = 100;
+    config->reorder_ms = IMPAIR_DEFAULT_REORDER_MS;
+    config->queue_bytes = IMPAIR_DEFAULT_QUEUE_BYTES;
+}
+
+// "<enter%>,<exit%>[,<loss%>]"
+static int parse_burst(const char *arg, ImpairConfig *config) {
+    char *end;
+    config->burst_enter = strtod(arg, &end);
+    if (end == arg || *end != ',') {
+        return -1;
+    }
+    arg = end + 1;
+    config->burst_exit = strtod(arg, &end);
+    if (end == arg) {
+        return -1;
+    }
+    if (*end == ',') {
+        arg = end + 1;
+        config->burst_loss = strtod(arg, &end);
+        if (end == arg) {
+            return -1;
+        }
+    }
+    return *end ? -1 : 0;
+}
+
+// Handles <prefix>drop, delay, burst, reorder, duplicate, corrupt, rate and queue
+// options, e.g. --client-drop. Returns 1 if argv[*i] was consumed.
+int impair_parse_arg(int argc, char *argv[], int *i, const char *prefix, ImpairConfig *config) {
+    size_t plen = strlen(prefix);
+    if (strncmp(argv[*i], prefix, plen) != 0 || *i + 1 >= argc) {
+        return 0;
+    }
+    const char *name = argv[*i] + plen;
+    const char *value = argv[*i + 1];
+
+    if (strcmp(name, "drop") == 0) {
+        config->drop = atoi(value);
+    } else if (strcmp(name, "delay") == 0) {
+        config->delay = atoi(value);
+    } else if (strcmp(name, "delay-time-min") == 0) {
+        config->delay_min = atoi(value);
+    } else if (strcmp(name, "delay-time-max") == 0) {
+        config->delay_max = atoi(value);
+    } else if (strcmp(name, "burst") == 0) {
+        if (parse_burst(value, config) < 0) {
+            config->burst_enter = -1;  // Rejected by impair_config_valid()
+        }
+    } else if (strcmp(name, "reorder") == 0) {
+        config->reorder = atoi(value);
+    } else if (strcmp(name, "reorder-time") == 0) {
+        config->reorder_ms = atoi(value);
+    } else if (strcmp(name, "duplicate") == 0) {
+        config->duplicate = atoi(value);
+    } else if (strcmp(name, "corrupt") == 0) {
+        config->corrupt = atoi(value);
+    } else if (strcmp(name, "rate") == 0) {
+        config->rate_kbps = atol(value);
+    } else if (strcmp(name, "queue") == 0) {
+        config->queue_bytes = atoi(value);
+    } else {
+        return 0;
+    }
+    ++*i;
+    return 1;
+}
+
+int impair_config_valid(const ImpairConfig *config) {
+    return config->burst_enter >= 0 && config->burst_enter <= 100 &&
+           (config->burst_enter == 0 || (config->burst_exit > 0 && config->burst_exit <= 100)) &&
+           config->burst_loss >= 0 && config->burst_loss <= 100 &&
+           config->reorder >= 0 && config->reorder <= 100 && config->reorder_ms > 0 &&
+           config->duplicate >= 0 && config->duplicate <= 100 &&
+           config->corrupt >= 0 && config->corrupt <= 100 &&
+           config->rate_kbps >= 0 && config->queue_bytes > 0;
+}
+
+// Longest any packet can be held: random delay or reorder hold-back, plus a full bottleneck
+uint64_t impair_max_hold_ns(const ImpairConfig *config) {
+    int hold_ms = config->delay_max > config->reorder_ms ? config->delay_max : config->reorder_ms;
+    uint64_t hold_ns = (uint64_t)hold_ms * 1000000ULL;
+    if (config->rate_kbps > 0) {
+        hold_ns += (uint64_t)config->queue_bytes * 8000000ULL / (uint64_t)config->rate_kbps;
+    }
+    return hold_ns;
+}
+
+void impair_init(Impairment *imp, const ImpairConfig *config, uint64_t seed, uint64_t stream) {
+    memset(imp, 0, sizeof(*imp));
+    imp->config = config;
+    rng_seed(&imp->rng, seed, stream);
+}
+
+void impair_decide(Impairment *imp, size_t len, uint64_t now_ns, ImpairDecision *out) {
+    const ImpairConfig *config = imp->config;
+    memset(out, 0, sizeof(*out));
+
+    // Gilbert-Elliott: the loss rate depends on a two-state channel that
+    // changes state once per packet, so losses arrive in bursts
+    double loss = config->drop;
+    if (config->burst_enter > 0) {
+        if (imp->bad) {
+            imp->bad = !chance(&imp->rng, config->burst_exit);
+        } else {
+            imp->bad = chance(&imp->rng, config->burst_enter);
+        }
+        if (imp->bad) {
+            loss = config->burst_loss;
+        }
+    }
+    if (chance(&imp->rng, loss)) {
+        out->verdict = IMPAIR_DROP;
+        return;
+    }
+
+    // Rate-limited bottleneck with a byte-sized drop-tail buffer
+    if (config->rate_kbps > 0) {
+        uint64_t start = imp->link_free_ns > now_ns ? imp->link_free_ns : now_ns;
+        uint64_t backlog_bytes = (start - now_ns) * (uint64_t)config->rate_kbps / 8000000ULL;
+        if (backlog_bytes + len > (uint64_t)config->queue_bytes) {
+            out->verdict = IMPAIR_QUEUE_DROP;
+            return;
+        }
+        imp->link_free_ns = start + (uint64_t)len * 8000000ULL / (uint64_t)config->rate_kbps;
+        out->queue_ns = imp->link_free_ns - now_ns;
+    }
+
+    if (chance(&imp->rng, config->delay)) {
+        out->delay_ms = config->delay_min >= config->delay_max ? config->delay_min :
+                        config->delay_min +
+                        (int)rng_below(&imp->rng, (uint32_t)(config->delay_max - config->delay_min + 1));
+    } else if (chance(&imp->rng, config->reorder)) {
+        out->reorder_ms = config->reorder_ms;
+    }
+    out->duplicate = chance(&imp->rng, config->duplicate);
+    if (len > 0 && chance(&imp->rng, config->corrupt)) {
+        out->corrupt_bit = rng_below(&imp->rng, (uint32_t)(len * 8)) + 1;
+    }
+}
@@ -0,0 +1,81 @@
+#ifndef COMP7005PROJ1_IMPAIR_H
+#define COMP7005PROJ1_IMPAIR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define IMPAIR_DEFAULT_REORDER_MS 5
+#define IMPAIR_DEFAULT_QUEUE_BYTES 65536
+
+// Printed through a format string, hence %%
+#define IMPAIR_USAGE "[--seed <n>] [--client-burst <enter%%>,<exit%%>[,<loss%%>]] " \
+                     "[--client-reorder <%%>] [--client-reorder-time <ms>] [--client-duplicate <%%>] " \
+                     "[--client-corrupt <%%>] " \
+                     "[--client-rate <kbit/s>] [--client-queue <bytes>] " \
+                     "(and the same --server-* options)"
+
+// PCG32 generator; each thread making decisions owns one, so there is no shared state
+typedef struct {
+    uint64_t state;
+    uint64_t inc;             // Stream selector, always odd
+} Rng;
+
+// Impairments applied to one direction
+typedef struct {
+    int drop;                 // Loss %; the good-state loss under the burst model
+    int delay;                // % of packets delayed
+    int delay_min;            // ms
+    int delay_max;            // ms
+    double burst_enter;       // Gilbert-Elliott: % chance per packet of entering the bad state, 0 = off
+    double burst_exit;        // % chance per packet of leaving it
+    double burst_loss;        // Loss % while in the bad state
+    int reorder;              // % of undelayed packets held back so later ones overtake them
+    int reorder_ms;
+    int duplicate;            // % of packets forwarded twice
+    int corrupt;              // % of packets forwarded with one bit flipped
+    long rate_kbps;           // Bottleneck rate, 0 = unlimited
+    int queue_bytes;          // Bottleneck buffer; arrivals that do not fit are tail-dropped
+} ImpairConfig;
+
+typedef enum {
+    IMPAIR_FORWARD = 0,
+    IMPAIR_DROP,              // Random or burst loss
+    IMPAIR_QUEUE_DROP         // No room in the bottleneck buffer
+} ImpairVerdict;
+
+// What to do with one packet
+typedef struct {
+    ImpairVerdict verdict;
+    int delay_ms;             // Random delay, 0 if none
+    int reorder_ms;           // Hold-back for reordering, 0 if none
+    uint64_t queue_ns;        // Time to drain through the bottleneck, 0 without --*-rate
+    int duplicate;
+    uint32_t corrupt_bit;     // 1 + index of the bit to flip, 0 to leave the packet intact
+} ImpairDecision;
+
+// Decision state for one direction, touched only by the thread that owns it
+typedef struct {
+    const ImpairConfig *config;
+    Rng rng;
+    int bad;                  // Gilbert-Elliott channel state
+    uint64_t link_free_ns;    // When the bottleneck finishes sending what it has admitted
+} Impairment;
+
+// Function prototypes
+void rng_seed(Rng *rng, uint64_t seed, uint64_t stream);
+uint32_t rng_next(Rng *rng);
+uint32_t rng_below(Rng *rng, uint32_t bound);
+double rng_uniform(Rng *rng);
+void impair_config_default(ImpairConfig *config);
+int impair_parse_arg(int argc, char *argv[], int *i, const char *prefix, ImpairConfig *config);
+int impair_config_valid(const ImpairConfig *config);
+uint64_t impair_max_hold_ns(const ImpairConfig *config);
+void impair_init(Impairment *imp, const ImpairConfig *config, uint64_t seed, uint64_t stream);
+void impair_decide(Impairment *imp, size_t len, uint64_t now_ns, ImpairDecision *out);
+
+// Total time a forwarded packet is held before it goes out
+static inline uint64_t impair_hold_ns(const ImpairDecision *d) {
+    return d->queue_ns + (uint64_t)(d->delay_ms + d->reorder_ms) * 1000000ULL;
+}
+
+#endif //COMP7005PROJ1_IMPAIR_H
@@ -0,0 +1,329 @@
+#include "log.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LOG_WRITE_BUF_SIZE 65536
+#define LOG_IDLE_SLEEP_NS 2000000L
+
+typedef struct {
+    uint64_t when_ns;             // CLOCK_MONOTONIC
+    FILE *dest;                   // Log file, or NULL for stderr only
+    unsigned short len;
+    char text[LOG_LINE_MAX];
+} LogEntry;
+
+// Single-producer (owning thread) single-consumer (writer thread) ring
+typedef struct {
+    _Atomic unsigned head;        // Next entry the writer reads
+    _Atomic unsigned tail;        // Next entry the producer fills
+    LogEntry entries[LOG_RING_SIZE];
+} LogRing;
+
+static struct {
+    LogConfig config;
+    int running;
+    pthread_t writer;
+    _Atomic int stop;
+    _Atomic int ring_count;
+    LogRing *rings[LOG_MAX_THREADS];
+    pthread_mutex_t register_lock;
+    _Atomic unsigned long dropped;
+} logger = {
+    .config = { LOG_LEVEL_TRACE, 1 },
+    .register_lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+static _Thread_local LogRing *thread_ring;
+static _Thread_local int thread_unregistered;
+static _Thread_local unsigned trace_counter;
+
+void log_config_default(LogConfig *config) {
+    config->level = LOG_LEVEL_TRACE;
+    config->sample = 1;
+}
+
+int log_parse_arg(int argc, char *argv[], int *i, LogConfig *config) {
+    if (strcmp(argv[*i], "--log-level") == 0 && *i + 1 < argc) {
+        const char *value = argv[++*i];
+        if (strcmp(value, "info") == 0) {
+            config->level = LOG_LEVEL_INFO;
+        } else if (strcmp(value, "trace") == 0) {
+            config->level = LOG_LEVEL_TRACE;
+        } else {
+            config->level = LOG_LEVEL_INVALID;
+        }
+        return 1;
+    }
+    if (strcmp(argv[*i], "--log-sample") == 0 && *i + 1 < argc) {
+        config->sample = atoi(argv[++*i]);
+        return 1;
+    }
+    return 0;
+}
+
+int log_config_valid(const LogConfig *config) {
+    return config->level != LOG_LEVEL_INVALID && config->sample >= 1;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Formats "[seconds.nanoseconds] " of the monotonic clock
+static size_t format_timestamp(uint64_t when_ns, char *out) {
+    int n = sprintf(out, "[%llu.%09llu] ", (unsigned long long)(when_ns / 1000000000ULL),
+                    (unsigned long long)(when_ns % 1000000000ULL));
+    return (size_t)n;
+}
+
+static void write_all(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n <= 0) {
+            return;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+}
+
+// Writer-thread only: moves every queued entry out, one write() per buffer
+static int drain_rings(char *buf, size_t *buf_len) {
+    int drained = 0;
+    FILE *last_dest = NULL;
+    int count = atomic_load_explicit(&logger.ring_count, memory_order_acquire);
+
+    for (int r = 0; r < count; r++) {
+        LogRing *ring = logger.rings[r];
+        unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        unsigned tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+        while (head != tail) {
+            LogEntry *e = &ring->entries[head & (LOG_RING_SIZE - 1)];
+            char line[32 + LOG_LINE_MAX + 1];
+            size_t len = format_timestamp(e->when_ns, line);
+            memcpy(line + len, e->text, e->len);
+            len += e->len;
+            line[len++] = '\n';
+
+            if (*buf_len + len > LOG_WRITE_BUF_SIZE) {
+                write_all(STDERR_FILENO, buf, *buf_len);
+                *buf_len = 0;
+            }
+            memcpy(buf + *buf_len, line, len);
+            *buf_len += len;
+
+            if (e->dest) {
+                if (last_dest && last_dest != e->dest) fflush(last_dest);
+                fwrite(line, 1, len, e->dest);
+                last_dest = e->dest;
+            }
+
+            head++;
+            drained++;
+            atomic_store_explicit(&ring->head, head, memory_order_release);
+        }
+    }
+
+    if (*buf_len > 0) {
+        write_all(STDERR_FILENO, buf, *buf_len);
+        *buf_len = 0;
+    }
+    if (last_dest) fflush(last_dest);
+    return drained;
+}
+
+static void *writer_main(void *arg) {
+    (void)arg;
+    char *buf = malloc(LOG_WRITE_BUF_SIZE);
+    size_t buf_len = 0;
+    if (!buf) {
+        return NULL;
+    }
+
+    for (;;) {
+        int stopping = atomic_load_explicit(&logger.stop, memory_order_acquire);
+        int drained = drain_rings(buf, &buf_len);
+
+        unsigned long dropped = atomic_exchange(&logger.dropped, 0);
+        if (dropped > 0) {
+            char line[96];
+            size_t len = format_timestamp(now_ns(), line);
+            len += (size_t)snprintf(line + len, sizeof(line) - len,
+                                    "LOG: dropped %lu trace events (ring full)\n", dropped);
+            write_all(STDERR_FILENO, line, len);
+        }
+
+        if (stopping && drained == 0) {
+            break;
+        }
+        if (drained == 0) {
+            struct timespec ts = { 0, LOG_IDLE_SLEEP_NS };
+            nanosleep(&ts, NULL);
+        }
+    }
+
+    free(buf);
+    return NULL;
+}
+
+int log_init(const LogConfig *config) {
+    if (logger.running) {
+        return 0;
+    }
+    logger.config = *config;
+    atomic_store(&logger.stop, 0);
+    if (pthread_create(&logger.writer, NULL, writer_main, NULL) != 0) {
+        return -1;
+    }
+    logger.running = 1;
+    atexit(log_shutdown);
+    return 0;
+}
+
+void log_shutdown(void) {
+    if (!logger.running) {
+        return;
+    }
+    atomic_store_explicit(&logger.stop, 1, memory_order_release);
+    pthread_join(logger.writer, NULL);
+    logger.running = 0;
+
+    int count = atomic_load(&logger.ring_count);
+    for (int r = 0; r < count; r++) {
+        free(logger.rings[r]);
+        logger.rings[r] = NULL;
+    }
+    atomic_store(&logger.ring_count, 0);
+}
+
+/*
+ * Opens a log file for appending and starts this run with a CLOCK line
+ * pairing the monotonic clock with the wall clock, so readers can turn
+ * the monotonic line timestamps back into local time
+ */
+FILE *log_open_file(const char *path) {
+    FILE *fp = fopen(path, "a");
+    if (!fp) {
+        return NULL;
+    }
+
+    struct timespec real;
+    uint64_t mono = now_ns();
+    clock_gettime(CLOCK_REALTIME, &real);
+
+    struct tm tm_real;
+    char wall[64];
+    localtime_r(&real.tv_sec, &tm_real);
+    strftime(wall, sizeof(wall), "%Y-%m-%d %H:%M:%S", &tm_real);
+
+    char zone[8];
+    strftime(zone, sizeof(zone), "%z", &tm_real);
+
+    char line[160];
+    size_t len = format_timestamp(mono, line);
+    len += (size_t)snprintf(line + len, sizeof(line) - len,
+                            "CLOCK: monotonic_ns=%llu, realtime=%s.%09ld %s\n",
+                            (unsigned long long)mono, wall, real.tv_nsec, zone);
+    fwrite(line, 1, len, fp);
+    fflush(fp);
+    return fp;
+}
+
+int log_trace_enabled(void) {
+    return logger.config.level >= LOG_LEVEL_TRACE;
+}
+
+static LogRing *get_thread_ring(void) {
+    if (thread_ring || thread_unregistered) {
+        return thread_ring;
+    }
+
+    // Registration is the only locked step; after it the thread logs lock-free
+    pthread_mutex_lock(&logger.register_lock);
+    int count = atomic_load(&logger.ring_count);
+    if (count < LOG_MAX_THREADS) {
+        LogRing *ring = calloc(1, sizeof(LogRing));
+        if (ring) {
+            logger.rings[count] = ring;
+            atomic_store_explicit(&logger.ring_count, count + 1, memory_order_release);
+            thread_ring = ring;
+        }
+    }
+    pthread_mutex_unlock(&logger.register_lock);
+
+    if (!thread_ring) {
+        thread_unregistered = 1;
+    }
+    return thread_ring;
+}
+
+// Used before log_init(), after log_shutdown() and for threads without a ring
+static void write_sync(FILE *log_fp, const char *text, size_t text_len) {
+    char line[32 + LOG_LINE_MAX + 1];
+    size_t len = format_timestamp(now_ns(), line);
+    memcpy(line + len, text, text_len);
+    len += text_len;
+    line[len++] = '\n';
+
+    write_all(STDERR_FILENO, line, len);
+    if (log_fp) {
+        fwrite(line, 1, len, log_fp);
+        fflush(log_fp);
+    }
+}
+
+void log_vwrite(LogLevel level, FILE *log_fp, const char *format, va_list args) {
+    if (level > logger.config.level) {
+        return;
+    }
+
+    LogRing *ring = logger.running ? get_thread_ring() : NULL;
+    if (!ring) {
+        char text[LOG_LINE_MAX];
+        int n = vsnprintf(text, sizeof(text), format, args);
+        if (n < 0) return;
+        write_sync(log_fp, text, (size_t)n < sizeof(text) ? (size_t)n : sizeof(text) - 1);
+        return;
+    }
+
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    while (tail - atomic_load_explicit(&ring->head, memory_order_acquire) >= LOG_RING_SIZE) {
+        // Trace events are shed under pressure; everything else waits for the writer
+        if (level == LOG_LEVEL_TRACE) {
+            atomic_fetch_add_explicit(&logger.dropped, 1, memory_order_relaxed);
+            return;
+        }
+        sched_yield();
+    }
+
+    LogEntry *e = &ring->entries[tail & (LOG_RING_SIZE - 1)];
+    int n = vsnprintf(e->text, sizeof(e->text), format, args);
+    if (n < 0) return;
+    e->len = (unsigned short)((size_t)n < sizeof(e->text) ? (size_t)n : sizeof(e->text) - 1);
+    e->when_ns = now_ns();
+    e->dest = log_fp;
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
+
+void log_trace(FILE *log_fp, const char *format, ...) {
+    if (logger.config.level < LOG_LEVEL_TRACE) {
+        return;
+    }
+    if (logger.config.sample > 1 && trace_counter++ % (unsigned)logger.config.sample != 0) {
+        return;
+    }
+
+    va_list args;
+    va_start(args, format);
+    log_vwrite(LOG_LEVEL_TRACE, log_fp, format, args);
+    va_end(args);
+}
@@ -0,0 +1,34 @@
+#ifndef COMP7005PROJ1_LOG_H
+#define COMP7005PROJ1_LOG_H
+
+#include <stdarg.h>
+#include <stdio.h>
+
+#define LOG_LINE_MAX 480
+#define LOG_RING_SIZE 4096        // Entries per thread, power of two
+#define LOG_MAX_THREADS 128
+#define LOG_USAGE "[--log-level <info|trace>] [--log-sample <n>]"
+
+typedef enum {
+    LOG_LEVEL_INVALID = -1,
+    LOG_LEVEL_INFO = 0,           // Lifecycle, errors, timeouts, drops
+    LOG_LEVEL_TRACE = 1           // Per-packet hot path (SEND, ACK_RECV, RECV, forwards)
+} LogLevel;
+
+typedef struct {
+    LogLevel level;
+    int sample;                   // Keep 1 in N trace events (1 = all)
+} LogConfig;
+
+// Function prototypes
+void log_config_default(LogConfig *config);
+int log_parse_arg(int argc, char *argv[], int *i, LogConfig *config);
+int log_config_valid(const LogConfig *config);
+int log_init(const LogConfig *config);
+void log_shutdown(void);
+FILE *log_open_file(const char *path);
+int log_trace_enabled(void);
+void log_vwrite(LogLevel level, FILE *log_fp, const char *format, va_list args);
+void log_trace(FILE *log_fp, const char *format, ...);
+
+#endif //COMP7005PROJ1_LOG_H
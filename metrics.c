@@ -0,0 +1,255 @@
+#include "metrics.h"
+#include "log.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#define METRICS_POLL_MS 200           // How often the endpoint thread checks for shutdown
+#define METRICS_REQUEST_MAX 2048
+
+const uint64_t metrics_latency_bounds_ns[17] = {
+    50000ULL, 100000ULL, 250000ULL, 500000ULL,
+    1000000ULL, 2500000ULL, 5000000ULL, 10000000ULL, 25000000ULL, 50000000ULL,
+    100000000ULL, 250000000ULL, 500000000ULL,
+    1000000000ULL, 2500000000ULL, 5000000000ULL, 10000000000ULL
+};
+
+// Filled before any worker thread starts and read-only afterwards
+static Metric *registry[METRICS_MAX];
+static int registry_count;
+
+static struct {
+    int listen_fd;
+    int running;
+    _Atomic int stop;
+    pthread_t thread;
+    char response[METRICS_RESPONSE_MAX];
+} endpoint = { .listen_fd = -1 };
+
+static void log_metrics(FILE *log_fp, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    log_vwrite(LOG_LEVEL_INFO, log_fp, format, args);
+    va_end(args);
+}
+
+void metrics_config_default(MetricsConfig *config) {
+    config->ip = "127.0.0.1";
+    config->port = 0;
+}
+
+int metrics_parse_arg(int argc, char *argv[], int *i, MetricsConfig *config) {
+    if (strcmp(argv[*i], "--metrics-port") == 0 && *i + 1 < argc) {
+        config->port = atoi(argv[++*i]);
+        return 1;
+    }
+    if (strcmp(argv[*i], "--metrics-ip") == 0 && *i + 1 < argc) {
+        config->ip = argv[++*i];
+        return 1;
+    }
+    return 0;
+}
+
+int metrics_config_valid(const MetricsConfig *config) {
+    struct in_addr addr;
+    return config->port >= 0 && config->port <= 65535 &&
+           inet_pton(AF_INET, config->ip, &addr) == 1;
+}
+
+int metrics_register(Metric *metric) {
+    if (registry_count == METRICS_MAX ||
+        (metric->type == METRIC_HISTOGRAM && metric->bucket_count > METRICS_MAX_BUCKETS)) {
+        return -1;
+    }
+    registry[registry_count++] = metric;
+    return 0;
+}
+
+void metrics_register_all(Metric *const *metrics, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        metrics_register(metrics[i]);
+    }
+}
+
+void metric_observe(Metric *metric, uint64_t value) {
+    int b = 0;
+    while (b < metric->bucket_count && value > metric->bounds[b]) {
+        b++;
+    }
+    atomic_fetch_add_explicit(&metric->buckets[b], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&metric->value, value, memory_order_relaxed);
+}
+
+// snprintf that stops appending once the buffer is full
+static size_t append(char *buf, size_t size, size_t used, const char *format, ...) {
+    if (used >= size) {
+        return used;
+    }
+
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(buf + used, size - used, format, args);
+    va_end(args);
+    return n < 0 ? used : used + (size_t)n;
+}
+
+static size_t format_histogram(char *buf, size_t size, size_t used, const Metric *m) {
+    uint64_t cumulative = 0;
+    for (int b = 0; b <= m->bucket_count; b++) {
+        cumulative += atomic_load_explicit(&m->buckets[b], memory_order_relaxed);
+        if (b < m->bucket_count) {
+            used = append(buf, size, used, "%s_bucket{le=\"%.9g\"} %llu\n",
+                          m->name, (double)m->bounds[b] * m->scale, (unsigned long long)cumulative);
+        } else {
+            used = append(buf, size, used, "%s_bucket{le=\"+Inf\"} %llu\n",
+                          m->name, (unsigned long long)cumulative);
+        }
+    }
+    uint64_t sum = atomic_load_explicit(&m->value, memory_order_relaxed);
+    used = append(buf, size, used, "%s_sum %.9g\n", m->name, (double)sum * m->scale);
+    return append(buf, size, used, "%s_count %llu\n", m->name, (unsigned long long)cumulative);
+}
+
+// Prometheus text exposition format (version 0.0.4)
+size_t metrics_format(char *buf, size_t size) {
+    static const char *type_names[] = { "counter", "gauge", "histogram" };
+    size_t used = 0;
+
+    for (int i = 0; i < registry_count; i++) {
+        const Metric *m = registry[i];
+        used = append(buf, size, used, "# HELP %s %s\n# TYPE %s %s\n",
+                      m->name, m->help, m->name, type_names[m->type]);
+
+        uint64_t value = atomic_load_explicit(&m->value, memory_order_relaxed);
+        if (m->type == METRIC_HISTOGRAM) {
+            used = format_histogram(buf, size, used, m);
+        } else if (m->type == METRIC_GAUGE) {
+            used = append(buf, size, used, "%s %lld\n", m->name, (long long)(int64_t)value);
+        } else {
+            used = append(buf, size, used, "%s %llu\n", m->name, (unsigned long long)value);
+        }
+    }
+    return used < size ? used : size - 1;
+}
+
+static void send_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+}
+
+// Answers any GET with the current metrics; one short-lived connection per scrape
+static void serve_scrape(int fd) {
+    struct timeval tv = { 1, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    char request[METRICS_REQUEST_MAX];
+    size_t got = 0;
+    while (got < sizeof(request) - 1) {
+        ssize_t n = recv(fd, request + got, sizeof(request) - 1 - got, 0);
+        if (n <= 0) break;
+        got += (size_t)n;
+        request[got] = '\0';
+        if (strstr(request, "\r\n\r\n") || strstr(request, "\n\n")) break;
+    }
+
+    if (got < 4 || strncmp(request, "GET ", 4) != 0) {
+        static const char bad[] = "HTTP/1.0 405 Method Not Allowed\r\nContent-Length: 0\r\n\r\n";
+        send_all(fd, bad, sizeof(bad) - 1);
+        return;
+    }
+
+    char header[128];
+    size_t body_len = metrics_format(endpoint.response, sizeof(endpoint.response));
+    int header_len = snprintf(header, sizeof(header),
+                              "HTTP/1.0 200 OK\r\n"
+                              "Content-Type: text/plain; version=0.0.4\r\n"
+                              "Content-Length: %zu\r\n\r\n", body_len);
+    send_all(fd, header, (size_t)header_len);
+    send_all(fd, endpoint.response, body_len);
+}
+
+static void *endpoint_main(void *arg) {
+    (void)arg;
+    struct pollfd pfd = { .fd = endpoint.listen_fd, .events = POLLIN };
+
+    while (!atomic_load(&endpoint.stop)) {
+        int ready = poll(&pfd, 1, METRICS_POLL_MS);
+        if (ready <= 0) {
+            continue;
+        }
+
+        int fd = accept(endpoint.listen_fd, NULL, NULL);
+        if (fd < 0) {
+            continue;
+        }
+        serve_scrape(fd);
+        close(fd);
+    }
+    return NULL;
+}
+
+// Serves GET /metrics over HTTP from a background thread; a no-op when no port is set
+int metrics_start(const MetricsConfig *config, FILE *log_fp) {
+    if (config->port == 0) {
+        return 0;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(config->port);
+    inet_pton(AF_INET, config->ip, &addr.sin_addr);
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        log_metrics(log_fp, "ERROR: metrics socket failed: %s", strerror(errno));
+        return -1;
+    }
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 16) < 0) {
+        log_metrics(log_fp, "ERROR: metrics endpoint %s:%d unavailable: %s",
+                    config->ip, config->port, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    endpoint.listen_fd = fd;
+    atomic_store(&endpoint.stop, 0);
+    if (pthread_create(&endpoint.thread, NULL, endpoint_main, NULL) != 0) {
+        log_metrics(log_fp, "ERROR: Failed to start metrics thread");
+        close(fd);
+        endpoint.listen_fd = -1;
+        return -1;
+    }
+    endpoint.running = 1;
+    log_metrics(log_fp, "METRICS: serving http://%s:%d/metrics", config->ip, config->port);
+    return 0;
+}
+
+void metrics_stop(void) {
+    if (endpoint.running) {
+        atomic_store(&endpoint.stop, 1);
+        pthread_join(endpoint.thread, NULL);
+        endpoint.running = 0;
+    }
+    if (endpoint.listen_fd >= 0) {
+        close(endpoint.listen_fd);
+        endpoint.listen_fd = -1;
+    }
+}
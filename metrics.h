@@ -0,0 +1,77 @@
+#ifndef COMP7005PROJ1_METRICS_H
+#define COMP7005PROJ1_METRICS_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define METRICS_MAX 64                // Metrics one process may register
+#define METRICS_MAX_BUCKETS 20        // Finite histogram buckets; +Inf is implicit
+#define METRICS_RESPONSE_MAX 65536
+#define METRICS_USAGE "[--metrics-port <port>] [--metrics-ip <ip>]"
+
+typedef enum {
+    METRIC_COUNTER,
+    METRIC_GAUGE,
+    METRIC_HISTOGRAM
+} MetricType;
+
+/*
+ * One exported series. Updates are single relaxed atomic operations, so
+ * the hot path never locks; each metric sits on its own cache line so
+ * workers bumping different metrics do not share lines.
+ */
+typedef struct {
+    const char *name;
+    const char *help;
+    MetricType type;
+    _Atomic uint64_t value;           // Counter total, gauge level, or histogram sum
+    const uint64_t *bounds;           // Histogram bucket upper bounds, ascending
+    int bucket_count;
+    double scale;                     // Exported value = raw * scale (e.g. ns -> seconds)
+    _Atomic uint64_t buckets[METRICS_MAX_BUCKETS + 1];  // Per bucket, not cumulative; last is +Inf
+} __attribute__((aligned(64))) Metric;
+
+#define METRIC_COUNTER_INIT(n, h) { .name = (n), .help = (h), .type = METRIC_COUNTER, .scale = 1.0 }
+#define METRIC_GAUGE_INIT(n, h) { .name = (n), .help = (h), .type = METRIC_GAUGE, .scale = 1.0 }
+#define METRIC_HISTOGRAM_INIT(n, h, b, s) { .name = (n), .help = (h), .type = METRIC_HISTOGRAM, \
+    .bounds = (b), .bucket_count = (int)(sizeof(b) / sizeof((b)[0])), .scale = (s) }
+
+// Upper bounds in nanoseconds for latency histograms, 50us to 10s
+extern const uint64_t metrics_latency_bounds_ns[17];
+
+typedef struct {
+    const char *ip;
+    int port;                         // 0 = no endpoint
+} MetricsConfig;
+
+// Function prototypes
+void metrics_config_default(MetricsConfig *config);
+int metrics_parse_arg(int argc, char *argv[], int *i, MetricsConfig *config);
+int metrics_config_valid(const MetricsConfig *config);
+int metrics_register(Metric *metric);
+void metrics_register_all(Metric *const *metrics, size_t count);
+void metric_observe(Metric *metric, uint64_t value);
+size_t metrics_format(char *buf, size_t size);
+int metrics_start(const MetricsConfig *config, FILE *log_fp);
+void metrics_stop(void);
+
+static inline void metric_add(Metric *metric, uint64_t n) {
+    atomic_fetch_add_explicit(&metric->value, n, memory_order_relaxed);
+}
+
+static inline void metric_inc(Metric *metric) {
+    metric_add(metric, 1);
+}
+
+// Gauges only; the level is kept as a two's complement uint64_t
+static inline void metric_sub(Metric *metric, uint64_t n) {
+    atomic_fetch_sub_explicit(&metric->value, n, memory_order_relaxed);
+}
+
+static inline void metric_set(Metric *metric, uint64_t value) {
+    atomic_store_explicit(&metric->value, value, memory_order_relaxed);
+}
+
+#endif //COMP7005PROJ1_METRICS_H
@@ -0,0 +1,156 @@
+#include "packet_pool.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+/*
+ * Process-wide pool of fixed-size packet buffers. Slabs are carved on
+ * demand up to max_buffers and kept until packet_pool_destroy(), so once
+ * traffic reaches its high-water mark no further heap allocation happens.
+ * Each thread keeps a small cache and only takes the lock to move a batch
+ * of buffers in or out of it.
+ */
+
+typedef struct {
+    PacketBuf *head;
+    int count;
+} PacketCache;
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static PacketBuf *pool_free;
+static PacketBuf **slabs;
+static size_t slab_count;
+static size_t pool_max;
+static size_t pool_capacity;
+static size_t pool_outstanding;
+static size_t pool_high_water;
+static atomic_ullong pool_exhausted;
+
+static _Thread_local PacketCache cache;
+
+int packet_pool_init(size_t max_buffers) {
+    size_t max_slabs = (max_buffers + PACKET_POOL_SLAB - 1) / PACKET_POOL_SLAB;
+    if (max_buffers == 0) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&pool_lock);
+    slabs = calloc(max_slabs, sizeof(PacketBuf *));
+    pool_max = slabs ? max_buffers : 0;
+    pthread_mutex_unlock(&pool_lock);
+    return slabs ? 0 : -1;
+}
+
+// Every buffer becomes invalid; call once all users are done with theirs
+void packet_pool_destroy(void) {
+    pthread_mutex_lock(&pool_lock);
+    for (size_t i = 0; i < slab_count; i++) {
+        free(slabs[i]);
+    }
+    free(slabs);
+    slabs = NULL;
+    slab_count = 0;
+    pool_free = NULL;
+    pool_max = pool_capacity = pool_outstanding = 0;
+    pthread_mutex_unlock(&pool_lock);
+    cache.head = NULL;
+    cache.count = 0;
+}
+
+// Caller holds pool_lock
+static int carve_slab(void) {
+    size_t n = pool_max - pool_capacity;
+    if (n == 0) {
+        return -1;
+    }
+    if (n > PACKET_POOL_SLAB) {
+        n = PACKET_POOL_SLAB;
+    }
+
+    PacketBuf *slab = aligned_alloc(_Alignof(PacketBuf), n * sizeof(PacketBuf));
+    if (!slab) {
+        return -1;
+    }
+    slabs[slab_count++] = slab;
+    pool_capacity += n;
+    for (size_t i = 0; i < n; i++) {
+        slab[i].next = pool_free;
+        pool_free = &slab[i];
+    }
+    return 0;
+}
+
+static void refill_cache(void) {
+    pthread_mutex_lock(&pool_lock);
+    int moved = 0;
+    while (moved < PACKET_CACHE_BATCH && (pool_free || carve_slab() == 0)) {
+        PacketBuf *buf = pool_free;
+        pool_free = buf->next;
+        buf->next = cache.head;
+        cache.head = buf;
+        moved++;
+    }
+    pool_outstanding += (size_t)moved;
+    if (pool_outstanding > pool_high_water) {
+        pool_high_water = pool_outstanding;
+    }
+    pthread_mutex_unlock(&pool_lock);
+    cache.count += moved;
+}
+
+static void return_to_pool(int n) {
+    pthread_mutex_lock(&pool_lock);
+    for (int i = 0; i < n && cache.head; i++) {
+        PacketBuf *buf = cache.head;
+        cache.head = buf->next;
+        buf->next = pool_free;
+        pool_free = buf;
+        cache.count--;
+        pool_outstanding--;
+    }
+    pthread_mutex_unlock(&pool_lock);
+}
+
+// Returns NULL once max_buffers are outstanding; callers treat that like a full queue
+PacketBuf *packet_alloc(void) {
+    if (!cache.head) {
+        refill_cache();
+        if (!cache.head) {
+            atomic_fetch_add_explicit(&pool_exhausted, 1, memory_order_relaxed);
+            return NULL;
+        }
+    }
+
+    PacketBuf *buf = cache.head;
+    cache.head = buf->next;
+    cache.count--;
+    buf->len = 0;
+    return buf;
+}
+
+void packet_free(PacketBuf *buf) {
+    if (!buf) {
+        return;
+    }
+
+    buf->next = cache.head;
+    cache.head = buf;
+    if (++cache.count > PACKET_CACHE_MAX) {
+        return_to_pool(PACKET_CACHE_BATCH);
+    }
+}
+
+// Hands a thread's cached buffers back before it exits
+void packet_pool_thread_release(void) {
+    return_to_pool(cache.count);
+}
+
+void packet_pool_stats(PacketPoolStats *stats) {
+    pthread_mutex_lock(&pool_lock);
+    stats->max_buffers = pool_max;
+    stats->capacity = pool_capacity;
+    stats->outstanding = pool_outstanding;
+    stats->high_water = pool_high_water;
+    pthread_mutex_unlock(&pool_lock);
+    stats->exhausted = atomic_load_explicit(&pool_exhausted, memory_order_relaxed);
+}
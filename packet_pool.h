@@ -0,0 +1,37 @@
+#ifndef COMP7005PROJ1_PACKET_POOL_H
+#define COMP7005PROJ1_PACKET_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "protocol.h"
+
+#define PACKET_BUF_SIZE MAX_FRAME_SIZE  // One whole wire frame
+#define PACKET_POOL_SLAB 64             // Buffers carved per slab allocation
+#define PACKET_CACHE_MAX 64             // Buffers a thread keeps before handing some back
+#define PACKET_CACHE_BATCH 32           // Buffers moved between a thread and the shared pool at once
+
+// A wire packet with room for one full frame; cache-line aligned so
+// neighbouring buffers never share a line between threads
+typedef struct PacketBuf {
+    struct PacketBuf *next;   // Free-list link, unused while the buffer is handed out
+    size_t len;
+    uint8_t data[PACKET_BUF_SIZE];
+} __attribute__((aligned(64))) PacketBuf;
+
+typedef struct {
+    size_t max_buffers;
+    size_t capacity;          // Buffers carved from slabs so far
+    size_t outstanding;       // Held by threads, in use or in their caches
+    size_t high_water;        // Most ever outstanding at once
+    unsigned long long exhausted;  // Allocations refused at the limit
+} PacketPoolStats;
+
+// Function prototypes
+int packet_pool_init(size_t max_buffers);
+void packet_pool_destroy(void);
+PacketBuf *packet_alloc(void);
+void packet_free(PacketBuf *buf);
+void packet_pool_thread_release(void);
+void packet_pool_stats(PacketPoolStats *stats);
+
+#endif //COMP7005PROJ1_PACKET_POOL_H
@@ -0,0 +1,137 @@
+#!/bin/bash
+# Regression benchmark behind `make perf`: bench against the server
+# directly, then through the proxy for every drop/delay pair in the matrix.
+# Each scenario records client (bench), server and proxy event logs;
+# analyze_events turns them into PERF_DIR/report.json for comparing releases.
+#
+# Settings, all from the environment:
+#   PERF_DURATION   Seconds of load per scenario (default: 3)
+#   PERF_DROPS      Proxy drop percentages, applied both ways (default: "0 1 5")
+#   PERF_DELAYS     Percent of packets the proxy delays, both ways (default: "0 25")
+#   PERF_DELAY_MS   Delay range in milliseconds, <min>-<max> (default: 5-20)
+#   PERF_FLOWS      Bench flows (default: 4)
+#   PERF_PAYLOAD    Bytes per message (default: 1024)
+#   PERF_WINDOW     Messages in flight per flow (default: 16)
+#   PERF_RTO        Bench --timeout and --min-rto in seconds, <initial>-<min>; loopback
+#                   RTTs are tiny, so the defaults keep a loss from stalling a flow
+#                   for the whole run (default: 0.05-0.01)
+#   PERF_SEED       Proxy seed, so each scenario drops the same packets (default: 1)
+#   PERF_PORT       Server port; the proxy listens on the next one (default: 6100)
+#   PERF_DIR        Where logs and the report go (default: perf-results)
+#   PACKET          Build variant, recorded in the report (default: standard)
+
+set -u
+cd "$(dirname "$0")" || exit 1
+ROOT=$PWD
+
+DURATION=${PERF_DURATION:-3}
+DROPS=${PERF_DROPS:-"0 1 5"}
+DELAYS=${PERF_DELAYS:-"0 25"}
+DELAY_MS=${PERF_DELAY_MS:-5-20}
+FLOWS=${PERF_FLOWS:-4}
+PAYLOAD=${PERF_PAYLOAD:-1024}
+WINDOW=${PERF_WINDOW:-16}
+RTO=${PERF_RTO:-0.05-0.01}
+SEED=${PERF_SEED:-1}
+PORT=${PERF_PORT:-6100}
+DIR=${PERF_DIR:-perf-results}
+PROXY_PORT=$((PORT + 1))
+DELAY_MIN=${DELAY_MS%-*}
+DELAY_MAX=${DELAY_MS#*-}
+RTO_INITIAL=${RTO%-*}
+RTO_MIN=${RTO#*-}
+
+for bin in server proxy bench analyze_events; do
+    if [ ! -x "./$bin" ]; then
+        echo "perf: ./$bin not built; run make first" >&2
+        exit 1
+    fi
+done
+
+rm -rf "$DIR"
+mkdir -p "$DIR"
+
+SERVER_PID=
+PROXY_PID=
+cleanup() {
+    for pid in $SERVER_PID $PROXY_PID; do
+        kill -INT "$pid" 2>/dev/null
+        wait "$pid" 2>/dev/null
+    done
+    SERVER_PID=
+    PROXY_PID=
+}
+trap cleanup EXIT
+
+# The server and proxy are given a moment to bind before the load starts
+# and SIGINT afterwards, so their event logs are flushed
+run_scenario() {
+    local name=$1 drop=$2 delay=$3 target=$PORT
+
+    ./server --listen-ip 127.0.0.1 --listen-port "$PORT" --sack \
+             --log-file "$DIR/${name}Server.log" --event-log "$DIR/${name}Server.evt" \
+             > /dev/null 2>&1 &
+    SERVER_PID=$!
+    if [ "$name" != Direct ]; then
+        ./proxy --listen-ip 127.0.0.1 --listen-port "$PROXY_PORT" \
+                --target-ip 127.0.0.1 --target-port "$PORT" --seed "$SEED" \
+                --client-drop "$drop" --server-drop "$drop" \
+                --client-delay "$delay" --server-delay "$delay" \
+                --client-delay-time-min "$DELAY_MIN" --client-delay-time-max "$DELAY_MAX" \
+                --server-delay-time-min "$DELAY_MIN" --server-delay-time-max "$DELAY_MAX" \
+                --log-file "$DIR/${name}Proxy.log" --event-log "$DIR/${name}Proxy.evt" \
+                > /dev/null 2>&1 &
+        PROXY_PID=$!
+        target=$PROXY_PORT
+    fi
+    sleep 0.5
+
+    ./bench --target-ip 127.0.0.1 --target-port "$target" --duration "$DURATION" \
+            --flows "$FLOWS" --payload "$PAYLOAD" --window "$WINDOW" \
+            --timeout "$RTO_INITIAL" --min-rto "$RTO_MIN" \
+            --log-file "$DIR/${name}Bench.log" --event-log "$DIR/${name}Client.evt" \
+            > "$DIR/${name}Bench.txt" 2>&1
+    local status=$?
+    cleanup
+
+    printf "%-16s %s\n" "$name" "$(grep -h '^Throughput' "$DIR/${name}Bench.txt")"
+    printf "%-16s %s\n" "" "$(grep -h '^ACK latency' "$DIR/${name}Bench.txt")"
+    SCENARIOS="${SCENARIOS:+$SCENARIOS,
+}    {\"name\": \"$name\", \"proxy\": $([ "$name" = Direct ] && echo false || echo true), \
+\"drop_percent\": $drop, \"delay_percent\": $delay, \"bench_ok\": $([ $status -eq 0 ] && echo true || echo false)}"
+    [ $status -eq 0 ] || FAILED=1
+}
+
+SCENARIOS=
+FAILED=0
+run_scenario Direct 0 0
+for drop in $DROPS; do
+    for delay in $DELAYS; do
+        run_scenario "Drop${drop}Delay${delay}" "$drop" "$delay"
+    done
+done
+
+# The event logs are matched by name from inside PERF_DIR, wherever that is
+ANALYSIS=$(cd "$DIR" && "$ROOT/analyze_events" --json *Client.evt *Server.evt *Proxy.evt)
+if [ $? -ne 0 ] || [ -z "$ANALYSIS" ]; then
+    echo "perf: analyze_events failed; no report written" >&2
+    exit 1
+fi
+COMMIT=$(git rev-parse --short HEAD 2>/dev/null || echo unknown)
+
+cat > "$DIR/report.json" <<EOF
+{"commit": "$COMMIT",
+ "date": "$(date -u +%Y-%m-%dT%H:%M:%SZ)",
+ "packet": "${PACKET:-standard}",
+ "load": {"duration_s": $DURATION, "flows": $FLOWS, "payload": $PAYLOAD, "window": $WINDOW,
+          "timeout_s": $RTO_INITIAL, "min_rto_s": $RTO_MIN},
+ "delay_ms": {"min": $DELAY_MIN, "max": $DELAY_MAX},
+ "scenarios": [
+$SCENARIOS
+ ],
+ "analysis": $ANALYSIS
+}
+EOF
+
+echo "Report: $DIR/report.json"
+exit $FAILED
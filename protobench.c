@@ -0,0 +1,268 @@
+#include "protobench.h"
+#include "crc32c.h"
+#include "event_loop.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const size_t payload_sizes[] = { 0, 64, MAX_PAYLOAD_SIZE, MAX_WIRE_PAYLOAD };
+
+static void fill_message(ProtoBenchScratch *s, size_t payload) {
+    memset(&s->msg, 0, sizeof(s->msg));
+    s->msg.magic = MAGIC_NUMBER;
+    s->msg.type = MSG_TYPE_DATA;
+    s->msg.payload_len = (uint16_t)payload;
+    memcpy(s->msg.payload, s->payload, payload);
+}
+
+static uint64_t run_serialize(ProtoBenchScratch *s, size_t payload, uint64_t iterations) {
+    uint64_t acc = 0;
+    fill_message(s, payload);
+    for (uint64_t i = 0; i < iterations; i++) {
+        s->msg.seq_num = (uint32_t)i;
+        acc += (uint64_t)serialize_message(&s->msg, s->frame, sizeof(s->frame)) + s->frame[6];
+    }
+    return acc;
+}
+
+static uint64_t run_deserialize(ProtoBenchScratch *s, size_t payload, uint64_t iterations) {
+    uint64_t acc = 0;
+    fill_message(s, payload);
+    size_t len = (size_t)serialize_message(&s->msg, s->frame, sizeof(s->frame));
+    for (uint64_t i = 0; i < iterations; i++) {
+        acc += (uint64_t)deserialize_message(s->frame, len, &s->msg) + s->msg.seq_num +
+               (uint8_t)s->msg.payload[0];
+    }
+    return acc;
+}
+
+// Zero-copy senders build the payload in place, so only the header is written
+static uint64_t run_view_build(ProtoBenchScratch *s, size_t payload, uint64_t iterations) {
+    uint64_t acc = 0;
+    memcpy(s->frame + MESSAGE_HEADER_SIZE, s->payload, payload);
+    for (uint64_t i = 0; i < iterations; i++) {
+        acc += message_write_header(s->frame, MSG_TYPE_STREAM, (uint32_t)i, (uint16_t)payload) +
+               s->frame[6];
+    }
+    return acc;
+}
+
+static uint64_t run_view_parse(ProtoBenchScratch *s, size_t payload, uint64_t iterations) {
+    uint64_t acc = 0;
+    memcpy(s->frame + MESSAGE_HEADER_SIZE, s->payload, payload);
+    size_t len = message_write_header(s->frame, MSG_TYPE_STREAM, 1, (uint16_t)payload);
+    for (uint64_t i = 0; i < iterations; i++) {
+        MessageView view;
+        acc += (uint64_t)message_view_parse(s->frame, len, &view) + view.seq_num + view.payload_len;
+    }
+    return acc;
+}
+
+static uint64_t run_sack_build(ProtoBenchScratch *s, size_t payload, uint64_t iterations) {
+    uint64_t acc = 0;
+    (void)payload;
+    for (uint64_t i = 0; i < iterations; i++) {
+        acc += (uint64_t)build_sack_frame(s->frame, sizeof(s->frame), (uint32_t)i,
+                                          i * 0x9E3779B97F4A7C15ULL, (uint16_t)i) +
+               s->frame[MESSAGE_HEADER_SIZE];
+    }
+    return acc;
+}
+
+static uint64_t run_sack_parse(ProtoBenchScratch *s, size_t payload, uint64_t iterations) {
+    uint64_t acc = 0;
+    (void)payload;
+    int len = build_sack_frame(s->frame, sizeof(s->frame), 1, 0x5555555555555555ULL, MAX_WINDOW);
+    for (uint64_t i = 0; i < iterations; i++) {
+        MessageView view;
+        uint32_t cum_ack = 0;
+        uint64_t bitmap = 0;
+        message_view_parse(s->frame, (size_t)len, &view);
+        acc += (uint64_t)parse_sack_view(&view, &cum_ack, &bitmap) + cum_ack + bitmap;
+    }
+    return acc;
+}
+
+static uint64_t run_fragment_build(ProtoBenchScratch *s, size_t payload, uint64_t iterations) {
+    uint64_t acc = 0;
+    for (uint64_t i = 0; i < iterations; i++) {
+        acc += build_fragment_frame(s->frame, (uint32_t)i, 7, 0, 1, s->payload, payload) +
+               s->frame[6];
+    }
+    return acc;
+}
+
+static uint64_t run_fragment_parse(ProtoBenchScratch *s, size_t payload, uint64_t iterations) {
+    uint64_t acc = 0;
+    size_t len = build_fragment_frame(s->frame, 1, 7, 0, 1, s->payload, payload);
+    for (uint64_t i = 0; i < iterations; i++) {
+        MessageView view;
+        FragmentView frag;
+        message_view_parse(s->frame, len, &view);
+        acc += (uint64_t)fragment_view_parse(&view, &frag) +
+               (uint64_t)fragment_view_check(&frag, MAX_FRAGMENT_DATA) + frag.msg_id + frag.len;
+    }
+    return acc;
+}
+
+// Checksum the payload alone, with whichever implementation crc32c() picked
+static uint64_t run_crc32c(ProtoBenchScratch *s, size_t payload, uint64_t iterations) {
+    uint64_t acc = 0;
+    for (uint64_t i = 0; i < iterations; i++) {
+        acc += crc32c((uint32_t)i, s->payload, payload);
+    }
+    return acc;
+}
+
+static uint64_t run_crc32c_table(ProtoBenchScratch *s, size_t payload, uint64_t iterations) {
+    uint64_t acc = 0;
+    for (uint64_t i = 0; i < iterations; i++) {
+        acc += crc32c_sw((uint32_t)i, s->payload, payload);
+    }
+    return acc;
+}
+
+// Header write plus trailer, what a --crc sender pays per frame
+static uint64_t run_view_seal(ProtoBenchScratch *s, size_t payload, uint64_t iterations) {
+    uint64_t acc = 0;
+    memcpy(s->frame + MESSAGE_HEADER_SIZE, s->payload, payload);
+    for (uint64_t i = 0; i < iterations; i++) {
+        size_t len = message_write_header(s->frame, MSG_TYPE_STREAM, (uint32_t)i, (uint16_t)payload);
+        acc += message_seal(s->frame, len) + s->frame[len];
+    }
+    return acc;
+}
+
+static uint64_t run_view_verify(ProtoBenchScratch *s, size_t payload, uint64_t iterations) {
+    uint64_t acc = 0;
+    memcpy(s->frame + MESSAGE_HEADER_SIZE, s->payload, payload);
+    size_t len = message_seal(s->frame, message_write_header(s->frame, MSG_TYPE_STREAM, 1,
+                                                             (uint16_t)payload));
+    for (uint64_t i = 0; i < iterations; i++) {
+        MessageView view;
+        acc += (uint64_t)message_view_parse(s->frame, len, &view) +
+               (uint64_t)message_view_verify(&view) + view.payload_len;
+    }
+    return acc;
+}
+
+#define FRAG_FRAME_HEADER (MESSAGE_HEADER_SIZE + FRAG_HEADER_SIZE)
+
+static const ProtoBenchCase cases[] = {
+    { "serialize",      run_serialize,      MAX_PAYLOAD_SIZE,  0, MESSAGE_HEADER_SIZE },
+    { "deserialize",    run_deserialize,    MAX_PAYLOAD_SIZE,  0, MESSAGE_HEADER_SIZE },
+    { "view_build",     run_view_build,     MAX_WIRE_PAYLOAD,  0, MESSAGE_HEADER_SIZE },
+    { "view_parse",     run_view_parse,     MAX_WIRE_PAYLOAD,  0, MESSAGE_HEADER_SIZE },
+    { "sack_build",     run_sack_build,     SACK_PAYLOAD_SIZE, SACK_PAYLOAD_SIZE, MESSAGE_HEADER_SIZE },
+    { "sack_parse",     run_sack_parse,     SACK_PAYLOAD_SIZE, SACK_PAYLOAD_SIZE, MESSAGE_HEADER_SIZE },
+    { "fragment_build", run_fragment_build, MAX_FRAGMENT_DATA, MAX_FRAGMENT_DATA, FRAG_FRAME_HEADER },
+    { "fragment_parse", run_fragment_parse, MAX_FRAGMENT_DATA, MAX_FRAGMENT_DATA, FRAG_FRAME_HEADER },
+    { "crc32c",         run_crc32c,         MAX_WIRE_PAYLOAD,  0, 0 },
+    { "crc32c_table",   run_crc32c_table,   MAX_WIRE_PAYLOAD,  0, 0 },
+    { "view_seal",      run_view_seal,      MAX_WIRE_PAYLOAD,  0, MESSAGE_HEADER_SIZE + CRC_TRAILER_SIZE },
+    { "view_verify",    run_view_verify,    MAX_WIRE_PAYLOAD,  0, MESSAGE_HEADER_SIZE + CRC_TRAILER_SIZE },
+};
+
+int parse_protobench_args(int argc, char *argv[], ProtoBenchConfig *config) {
+    config->iterations = 0;
+    config->min_time = PROTOBENCH_DEFAULT_MIN_TIME;
+    config->repeat = PROTOBENCH_DEFAULT_REPEAT;
+    config->filter = NULL;
+    int bad = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            config->iterations = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            config->min_time = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            config->repeat = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            config->filter = argv[++i];
+        } else {
+            bad = 1;
+        }
+    }
+
+    if (bad || config->min_time <= 0 || config->repeat < 1) {
+        fprintf(stderr, "Usage: %s [--iterations <n>] [--min-time <sec>] [--repeat <n>] "
+                       "[--filter <name>]\n", argv[0]);
+        return -1;
+    }
+    return 0;
+}
+
+static volatile uint64_t sink;
+
+static uint64_t time_run(const ProtoBenchCase *c, ProtoBenchScratch *s, size_t payload,
+                         uint64_t iterations) {
+    uint64_t start = monotonic_ns();
+    sink += c->run(s, payload, iterations);
+    return monotonic_ns() - start;
+}
+
+// Grow the iteration count until one run takes min_time
+static uint64_t calibrate(const ProtoBenchCase *c, ProtoBenchScratch *s, size_t payload,
+                          double min_time) {
+    uint64_t target_ns = (uint64_t)(min_time * 1e9);
+    uint64_t iterations = 1000;
+    for (;;) {
+        uint64_t elapsed = time_run(c, s, payload, iterations);
+        if (elapsed >= target_ns / 10) {
+            return (uint64_t)((double)iterations * (double)target_ns / (double)elapsed) + 1;
+        }
+        iterations *= 10;
+    }
+}
+
+static void run_case(const ProtoBenchConfig *config, const ProtoBenchCase *c,
+                     ProtoBenchScratch *s, size_t payload) {
+    uint64_t iterations = config->iterations ? config->iterations
+                                             : calibrate(c, s, payload, config->min_time);
+    uint64_t best = UINT64_MAX;
+    for (int r = 0; r < config->repeat; r++) {
+        uint64_t elapsed = time_run(c, s, payload, iterations);
+        if (elapsed < best) best = elapsed;
+    }
+
+    // Throughput counts whole frames, header included
+    double ns_per_op = (double)best / (double)iterations;
+    double frame_bytes = (double)(c->header_bytes + payload);
+    printf("%-16s %8zu %12llu %10.2f %10.2f %12.1f %8.3f\n", c->name, payload,
+           (unsigned long long)iterations, ns_per_op, 1e3 / ns_per_op,
+           frame_bytes * 1e3 / ns_per_op, frame_bytes > 0 ? ns_per_op / frame_bytes : 0.0);
+}
+
+int main(int argc, char *argv[]) {
+    ProtoBenchConfig config;
+    if (parse_protobench_args(argc, argv, &config) < 0) {
+        return EXIT_FAILURE;
+    }
+
+    static ProtoBenchScratch scratch;
+    for (size_t i = 0; i < sizeof(scratch.payload); i++) {
+        scratch.payload[i] = (uint8_t)('a' + i % 26);
+    }
+
+    printf("crc32c implementation: %s\n", crc32c_impl());
+    printf("%-16s %8s %12s %10s %10s %12s %8s\n",
+           "case", "payload", "iterations", "ns/op", "Mops/s", "MB/s", "ns/B");
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        const ProtoBenchCase *c = &cases[i];
+        if (config.filter && !strstr(c->name, config.filter)) {
+            continue;
+        }
+
+        if (c->fixed_payload) {
+            run_case(&config, c, &scratch, c->fixed_payload);
+            continue;
+        }
+        for (size_t j = 0; j < sizeof(payload_sizes) / sizeof(payload_sizes[0]); j++) {
+            if (payload_sizes[j] <= c->max_payload) {
+                run_case(&config, c, &scratch, payload_sizes[j]);
+            }
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,40 @@
+#ifndef COMP7005PROJ1_PROTOBENCH_H
+#define COMP7005PROJ1_PROTOBENCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "protocol.h"
+
+typedef struct {
+    uint64_t iterations;       // Per case, 0 = calibrate to min_time
+    double min_time;           // Seconds each case should run for when calibrating
+    int repeat;                // Runs per case; the fastest is reported
+    const char *filter;        // Only run cases whose name contains this
+} ProtoBenchConfig;
+
+#define PROTOBENCH_DEFAULT_MIN_TIME 0.2
+#define PROTOBENCH_DEFAULT_REPEAT 3
+
+// Scratch state shared by every case, so buffers stay warm in cache
+typedef struct {
+    Message msg;
+    uint8_t frame[MAX_FRAME_SIZE];
+    uint8_t payload[MAX_WIRE_PAYLOAD];
+} ProtoBenchScratch;
+
+// Runs one operation `iterations` times; returns a value folded from the
+// results so the compiler cannot discard the work
+typedef uint64_t (*ProtoBenchFn)(ProtoBenchScratch *s, size_t payload, uint64_t iterations);
+
+typedef struct {
+    const char *name;
+    ProtoBenchFn run;
+    size_t max_payload;        // Largest payload the API accepts
+    size_t fixed_payload;      // Nonzero: run once at this size instead of every payload size
+    size_t header_bytes;       // Added to the payload when counting bytes/s
+} ProtoBenchCase;
+
+// Function prototypes
+int parse_protobench_args(int argc, char *argv[], ProtoBenchConfig *config);
+
+#endif //COMP7005PROJ1_PROTOBENCH_H
@@ -1,83 +1,113 @@
 #include "protocol.h"
+#include "crc32c.h"
 #include <string.h>
 #include <arpa/inet.h>
 
-int serialize_message(const Message *msg, uint8_t *buffer, size_t buffer_size) {
-    if (buffer_size < sizeof(uint16_t) + sizeof(uint8_t) + sizeof(uint32_t) + sizeof(uint16_t) + msg->payload_len) {
-        return -1;
-    }
-
-    size_t offset = 0;
+static void put_u16(uint8_t *p, uint16_t v) {
+    uint16_t net = htons(v);
+    memcpy(p, &net, sizeof(net));
+}
 
-    // Magic number (network byte order)
-    uint16_t magic_net = htons(msg->magic);
-    memcpy(buffer + offset, &magic_net, sizeof(uint16_t));
-    offset += sizeof(uint16_t);
+static void put_u32(uint8_t *p, uint32_t v) {
+    uint32_t net = htonl(v);
+    memcpy(p, &net, sizeof(net));
+}
 
-    // Type
-    buffer[offset] = msg->type;
-    offset += sizeof(uint8_t);
+static uint16_t get_u16(const uint8_t *p) {
+    uint16_t net;
+    memcpy(&net, p, sizeof(net));
+    return ntohs(net);
+}
 
-    // Sequence number (network byte order)
-    uint32_t seq_net = htonl(msg->seq_num);
-    memcpy(buffer + offset, &seq_net, sizeof(uint32_t));
-    offset += sizeof(uint32_t);
+static uint32_t get_u32(const uint8_t *p) {
+    uint32_t net;
+    memcpy(&net, p, sizeof(net));
+    return ntohl(net);
+}
 
-    // Payload length (network byte order)
-    uint16_t len_net = htons(msg->payload_len);
-    memcpy(buffer + offset, &len_net, sizeof(uint16_t));
-    offset += sizeof(uint16_t);
+static void put_u64(uint8_t *p, uint64_t v) {
+    put_u32(p, (uint32_t)(v >> 32));
+    put_u32(p + sizeof(uint32_t), (uint32_t)v);
+}
 
-    // Payload
-    if (msg->payload_len > 0) {
-        memcpy(buffer + offset, msg->payload, msg->payload_len);
-        offset += msg->payload_len;
-    }
+static uint64_t get_u64(const uint8_t *p) {
+    return ((uint64_t)get_u32(p) << 32) | get_u32(p + sizeof(uint32_t));
+}
 
-    return (int)offset;
+/*
+ * Writes the wire header into the first MESSAGE_HEADER_SIZE bytes of frame.
+ * The payload is expected to already sit at frame + MESSAGE_HEADER_SIZE.
+ */
+size_t message_write_header(uint8_t *frame, uint8_t type, uint32_t seq_num, uint16_t payload_len) {
+    put_u16(frame, MAGIC_NUMBER);
+    frame[2] = type;
+    put_u32(frame + 3, seq_num);
+    put_u16(frame + 7, payload_len);
+    return MESSAGE_HEADER_SIZE + payload_len;
 }
 
-int deserialize_message(const uint8_t *buffer, size_t buffer_len, Message *msg) {
-    if (buffer_len < sizeof(uint16_t) + sizeof(uint8_t) + sizeof(uint32_t) + sizeof(uint16_t)) {
+int message_view_parse(const uint8_t *buffer, size_t buffer_len, MessageView *view) {
+    if (buffer_len < MESSAGE_HEADER_SIZE || get_u16(buffer) != MAGIC_NUMBER) {
         return -1;
     }
 
-    size_t offset = 0;
-
-    // Magic number
-    uint16_t magic_net;
-    memcpy(&magic_net, buffer + offset, sizeof(uint16_t));
-    msg->magic = ntohs(magic_net);
-    offset += sizeof(uint16_t);
+    view->type = buffer[2] & MSG_TYPE_MASK;
+    view->crc = (buffer[2] & MSG_FLAG_CRC) != 0;
+    view->seq_num = get_u32(buffer + 3);
+    view->payload_len = get_u16(buffer + 7);
+    view->payload = buffer + MESSAGE_HEADER_SIZE;
 
-    if (msg->magic != MAGIC_NUMBER) {
-        return -1;  // Invalid magic number
+    if (view->payload_len > MAX_WIRE_PAYLOAD || message_view_frame_len(view) > buffer_len) {
+        return -1;
     }
+    return 0;
+}
 
-    // Type
-    msg->type = buffer[offset];
-    offset += sizeof(uint8_t);
-
-    // Sequence number
-    uint32_t seq_net;
-    memcpy(&seq_net, buffer + offset, sizeof(uint32_t));
-    msg->seq_num = ntohl(seq_net);
-    offset += sizeof(uint32_t);
+/*
+ * Marks a finished frame as checksummed and appends the CRC32C of its
+ * header and payload. The buffer needs CRC_TRAILER_SIZE bytes of room past
+ * frame_len. Returns the new frame length.
+ */
+size_t message_seal(uint8_t *frame, size_t frame_len) {
+    frame[2] |= MSG_FLAG_CRC;
+    put_u32(frame + frame_len, crc32c(0, frame, frame_len));
+    return frame_len + CRC_TRAILER_SIZE;
+}
 
-    // Payload length
-    uint16_t len_net;
-    memcpy(&len_net, buffer + offset, sizeof(uint16_t));
-    msg->payload_len = ntohs(len_net);
-    offset += sizeof(uint16_t);
+// 0 if the frame carries no trailer or its trailer matches, -1 otherwise
+int message_view_verify(const MessageView *view) {
+    if (!view->crc) {
+        return 0;
+    }
+    const uint8_t *frame = view->payload - MESSAGE_HEADER_SIZE;
+    size_t len = MESSAGE_HEADER_SIZE + view->payload_len;
+    return crc32c(0, frame, len) == get_u32(frame + len) ? 0 : -1;
+}
 
-    // Validate payload length
-    if (msg->payload_len > MAX_PAYLOAD_SIZE || offset + msg->payload_len > buffer_len) {
+int serialize_message(const Message *msg, uint8_t *buffer, size_t buffer_size) {
+    if (buffer_size < MESSAGE_HEADER_SIZE + (size_t)msg->payload_len) {
         return -1;
     }
 
-    // Payload
     if (msg->payload_len > 0) {
-        memcpy(msg->payload, buffer + offset, msg->payload_len);
+        memcpy(buffer + MESSAGE_HEADER_SIZE, msg->payload, msg->payload_len);
+    }
+    return (int)message_write_header(buffer, msg->type, msg->seq_num, msg->payload_len);
+}
+
+int deserialize_message(const uint8_t *buffer, size_t buffer_len, Message *msg) {
+    MessageView view;
+    if (message_view_parse(buffer, buffer_len, &view) < 0 || view.payload_len > MAX_PAYLOAD_SIZE ||
+        message_view_verify(&view) < 0) {
+        return -1;
+    }
+
+    msg->magic = MAGIC_NUMBER;
+    msg->type = view.type;
+    msg->seq_num = view.seq_num;
+    msg->payload_len = view.payload_len;
+    if (view.payload_len > 0) {
+        memcpy(msg->payload, view.payload, view.payload_len);
     }
     msg->payload[msg->payload_len] = '\0';  // Null terminate
 
@@ -88,11 +118,9 @@ void create_data_message(Message *msg, uint32_t seq_num, const char *payload) {
     msg->magic = MAGIC_NUMBER;
     msg->type = MSG_TYPE_DATA;
     msg->seq_num = seq_num;
-    msg->payload_len = (uint16_t)strlen(payload);
 
-    if (msg->payload_len > MAX_PAYLOAD_SIZE) {
-        msg->payload_len = MAX_PAYLOAD_SIZE;
-    }
+    size_t len = strlen(payload);
+    msg->payload_len = (uint16_t)(len > MAX_PAYLOAD_SIZE ? MAX_PAYLOAD_SIZE : len);
 
     memcpy(msg->payload, payload, msg->payload_len);
     msg->payload[msg->payload_len] = '\0';
@@ -104,4 +132,160 @@ void create_ack_message(Message *msg, uint32_t seq_num) {
     msg->seq_num = seq_num;
     msg->payload_len = 0;
     msg->payload[0] = '\0';
-}
\ No newline at end of file
+}
+
+int build_ack_frame(uint8_t *buffer, size_t buffer_size, uint32_t seq_num) {
+    if (buffer_size < MESSAGE_HEADER_SIZE) {
+        return -1;
+    }
+    return (int)message_write_header(buffer, MSG_TYPE_ACK, seq_num, 0);
+}
+
+/*
+ * SACK layout: seq_num carries the cumulative ack point (every sequence
+ * number below it has been received) and the payload carries a 64-bit
+ * bitmap in network byte order where bit i acknowledges cum_ack + 1 + i,
+ * then the receiver's advertised window: how many sequence numbers from
+ * cum_ack on it can take now. SACKs with only the bitmap advertise nothing.
+ */
+void create_sack_message(Message *msg, uint32_t cum_ack, uint64_t sack_bitmap, uint16_t window) {
+    msg->magic = MAGIC_NUMBER;
+    msg->type = MSG_TYPE_SACK;
+    msg->seq_num = cum_ack;
+    msg->payload_len = SACK_PAYLOAD_SIZE;
+    put_u64((uint8_t *)msg->payload, sack_bitmap);
+    put_u16((uint8_t *)msg->payload + SACK_BITMAP_SIZE, window);
+    msg->payload[msg->payload_len] = '\0';
+}
+
+int build_sack_frame(uint8_t *buffer, size_t buffer_size, uint32_t cum_ack, uint64_t sack_bitmap,
+                     uint16_t window) {
+    if (buffer_size < MESSAGE_HEADER_SIZE + SACK_PAYLOAD_SIZE) {
+        return -1;
+    }
+    put_u64(buffer + MESSAGE_HEADER_SIZE, sack_bitmap);
+    put_u16(buffer + MESSAGE_HEADER_SIZE + SACK_BITMAP_SIZE, window);
+    return (int)message_write_header(buffer, MSG_TYPE_SACK, cum_ack, SACK_PAYLOAD_SIZE);
+}
+
+int parse_sack_message(const Message *msg, uint32_t *cum_ack, uint64_t *sack_bitmap) {
+    if (msg->type != MSG_TYPE_SACK || msg->payload_len < SACK_BITMAP_SIZE) {
+        return -1;
+    }
+
+    *cum_ack = msg->seq_num;
+    *sack_bitmap = get_u64((const uint8_t *)msg->payload);
+    return 0;
+}
+
+int parse_sack_view(const MessageView *view, uint32_t *cum_ack, uint64_t *sack_bitmap) {
+    if (view->type != MSG_TYPE_SACK || view->payload_len < SACK_BITMAP_SIZE) {
+        return -1;
+    }
+
+    *cum_ack = view->seq_num;
+    *sack_bitmap = get_u64(view->payload);
+    return 0;
+}
+
+// Call after parse_sack_view() succeeds
+uint16_t sack_view_window(const MessageView *view) {
+    if (view->payload_len < SACK_PAYLOAD_SIZE) {
+        return SACK_WINDOW_NONE;
+    }
+    return get_u16(view->payload + SACK_BITMAP_SIZE);
+}
+
+// stride is the fragment data a session's frames carry: its negotiated
+// wire payload less FRAG_HEADER_SIZE
+uint16_t fragment_count(size_t record_len, size_t stride) {
+    if (record_len == 0) {
+        return 1;
+    }
+    return (uint16_t)((record_len + stride - 1) / stride);
+}
+
+/*
+ * Fragment layout: the payload starts with msg_id, frag_index and
+ * frag_count in network byte order, followed by the fragment's slice of
+ * the record. Every fragment but the last carries exactly one stride of
+ * data, so the slice offset follows from the index.
+ */
+size_t build_fragment_frame(uint8_t *frame, uint32_t seq_num, uint32_t msg_id,
+                            uint16_t index, uint16_t count, const uint8_t *data, size_t len) {
+    uint8_t *payload = frame + MESSAGE_HEADER_SIZE;
+    put_u32(payload, msg_id);
+    put_u16(payload + 4, index);
+    put_u16(payload + 6, count);
+    memcpy(payload + FRAG_HEADER_SIZE, data, len);
+    return message_write_header(frame, MSG_TYPE_FRAG, seq_num,
+                                (uint16_t)(FRAG_HEADER_SIZE + len));
+}
+
+int fragment_view_parse(const MessageView *view, FragmentView *frag) {
+    if (view->type != MSG_TYPE_FRAG || view->payload_len < FRAG_HEADER_SIZE) {
+        return -1;
+    }
+
+    frag->msg_id = get_u32(view->payload);
+    frag->index = get_u16(view->payload + 4);
+    frag->count = get_u16(view->payload + 6);
+    frag->data = view->payload + FRAG_HEADER_SIZE;
+    frag->len = (uint16_t)(view->payload_len - FRAG_HEADER_SIZE);
+
+    if (frag->count == 0 || frag->count > MAX_FRAGMENTS || frag->index >= frag->count ||
+        frag->len > MAX_FRAGMENT_DATA) {
+        return -1;
+    }
+    return 0;
+}
+
+// Only the last fragment may be short, so offsets stay index * stride
+int fragment_view_check(const FragmentView *frag, size_t stride) {
+    if (frag->index + 1 < frag->count ? frag->len != stride : frag->len > stride) {
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Handshake layout: a SYN carries the sender's first sequence number, the
+ * session it wants to resume (0 for a new one) and the largest payload it
+ * can send; the SYN-ACK carries the session the receiver settled on, the
+ * seq it expects next and the payload size both ends will use.
+ */
+int build_session_frame(uint8_t *buffer, size_t buffer_size, uint8_t type, uint32_t seq_num,
+                        uint64_t session_id, uint16_t max_payload) {
+    if (buffer_size < MESSAGE_HEADER_SIZE + SESSION_PAYLOAD_SIZE) {
+        return -1;
+    }
+    put_u64(buffer + MESSAGE_HEADER_SIZE, session_id);
+    put_u16(buffer + MESSAGE_HEADER_SIZE + 8, max_payload);
+    return (int)message_write_header(buffer, type, seq_num, SESSION_PAYLOAD_SIZE);
+}
+
+int parse_session_view(const MessageView *view, uint64_t *session_id, uint16_t *max_payload) {
+    if ((view->type != MSG_TYPE_SYN && view->type != MSG_TYPE_SYN_ACK) ||
+        view->payload_len < SESSION_PAYLOAD_SIZE) {
+        return -1;
+    }
+
+    *session_id = get_u64(view->payload);
+    *max_payload = get_u16(view->payload + 8);
+    if (*max_payload < MIN_WIRE_PAYLOAD) {
+        return -1;
+    }
+    return 0;
+}
+
+int sack_covers(uint32_t cum_ack, uint64_t sack_bitmap, uint32_t seq_num) {
+    if (seq_before(seq_num, cum_ack)) {
+        return 1;
+    }
+
+    uint32_t offset = seq_num - cum_ack;
+    if (offset == 0 || offset > SACK_BITMAP_BITS) {
+        return 0;
+    }
+    return (int)((sack_bitmap >> (offset - 1)) & 1);
+}
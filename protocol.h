@@ -7,11 +7,52 @@
 
 #define MAX_PAYLOAD_SIZE 512
 #define MAGIC_NUMBER 0x55AA
+#define SACK_BITMAP_BITS 64
+#define SACK_BITMAP_SIZE 8
+#define SACK_PAYLOAD_SIZE 10      // bitmap(8) + advertised window(2)
+#define SACK_WINDOW_NONE 0xFFFF   // SACK from a peer that does not advertise a window
+#define MAX_WINDOW SACK_BITMAP_BITS  // Senders keep at most this many sequence numbers in flight
+#define MESSAGE_HEADER_SIZE 9     // magic(2) + type(1) + seq_num(4) + payload_len(2)
+#define MSG_FLAG_CRC 0x80         // Type bit: a CRC32C trailer follows the payload
+#define MSG_TYPE_MASK 0x7F
+#define CRC_TRAILER_SIZE 4        // crc32c(header + payload), network byte order
+#define SESSION_PAYLOAD_SIZE 10   // SYN / SYN-ACK: session id(8) + max wire payload(2)
+
+// Every frame size below follows from the link MTU, which the build picks
+// (make PACKET=small|standard|jumbo). Frames, trailer included, fit one
+// datagram over UDP/IPv4 whether or not the sender checksums them; peers
+// settle on the smaller of their two limits in the handshake.
+#ifndef LINK_MTU
+#define LINK_MTU 1500
+#endif
+#define MIN_LINK_MTU 576          // Every IPv4 host must take a datagram this size
+#define MAX_LINK_MTU 9000
+#define UDP_IPV4_OVERHEAD 28
+#define WIRE_PAYLOAD_FOR_MTU(mtu) ((mtu) - UDP_IPV4_OVERHEAD - MESSAGE_HEADER_SIZE - CRC_TRAILER_SIZE)
+#define MAX_WIRE_PAYLOAD WIRE_PAYLOAD_FOR_MTU(LINK_MTU)
+#define MIN_WIRE_PAYLOAD WIRE_PAYLOAD_FOR_MTU(MIN_LINK_MTU)
+#define MAX_FRAME_SIZE (MESSAGE_HEADER_SIZE + MAX_WIRE_PAYLOAD + CRC_TRAILER_SIZE)
+#define CONTROL_FRAME_SIZE (MESSAGE_HEADER_SIZE + SESSION_PAYLOAD_SIZE + CRC_TRAILER_SIZE)  // ACK, SACK, SYN
+#define FRAG_HEADER_SIZE 8        // msg_id(4) + frag_index(2) + frag_count(2)
+#define MAX_FRAGMENT_DATA (MAX_WIRE_PAYLOAD - FRAG_HEADER_SIZE)
+#define MIN_FRAGMENT_DATA (MIN_WIRE_PAYLOAD - FRAG_HEADER_SIZE)
+#define MAX_RECORD_SIZE 65536
+// Enough for a record cut at the smallest stride any peer may negotiate
+#define MAX_FRAGMENTS ((MAX_RECORD_SIZE + MIN_FRAGMENT_DATA - 1) / MIN_FRAGMENT_DATA)
+
+_Static_assert(LINK_MTU >= MIN_LINK_MTU && LINK_MTU <= MAX_LINK_MTU, "LINK_MTU out of range");
+_Static_assert(MAX_PAYLOAD_SIZE <= MIN_WIRE_PAYLOAD, "DATA messages must fit the smallest frame");
+_Static_assert(SACK_PAYLOAD_SIZE <= SESSION_PAYLOAD_SIZE, "CONTROL_FRAME_SIZE must cover a SACK");
 
 // Message types
 typedef enum {
     MSG_TYPE_DATA = 1,
-    MSG_TYPE_ACK = 2
+    MSG_TYPE_ACK = 2,
+    MSG_TYPE_SACK = 3,        // Cumulative ACK + selective bitmap
+    MSG_TYPE_FRAG = 4,        // One MTU-sized piece of a record larger than MAX_PAYLOAD_SIZE
+    MSG_TYPE_STREAM = 5,      // Raw chunk of a bulk byte stream, up to MAX_WIRE_PAYLOAD bytes
+    MSG_TYPE_SYN = 6,         // Opens a session at seq_num, or resumes the one named in the payload
+    MSG_TYPE_SYN_ACK = 7      // Session accepted; seq_num is the next seq the receiver expects
 } MessageType;
 
 // Message structure
@@ -20,13 +61,68 @@ typedef struct __attribute__((packed)) {
     uint8_t type;             // Message type (DATA or ACK)
     uint32_t seq_num;         // Sequence number
     uint16_t payload_len;     // Length of payload
-    char payload[MAX_PAYLOAD_SIZE];  // Actual message data
+    char payload[MAX_PAYLOAD_SIZE + 1];  // Actual message data, NUL-terminated
 } Message;
 
+// Header decoded in place; payload points into the buffer it was parsed from
+typedef struct {
+    uint8_t type;             // MSG_FLAG_CRC stripped
+    uint8_t crc;              // Frame carries a CRC trailer
+    uint32_t seq_num;
+    uint16_t payload_len;
+    const uint8_t *payload;   // Not NUL-terminated
+} MessageView;
+
+// Fragment sub-header of a MSG_TYPE_FRAG payload, decoded in place
+typedef struct {
+    uint32_t msg_id;          // Record this fragment belongs to
+    uint16_t index;           // Position in the record, 0-based
+    uint16_t count;           // Total fragments in the record
+    const uint8_t *data;      // Record bytes [index * stride, + len)
+    uint16_t len;
+} FragmentView;
+
 // Function prototypes
 int serialize_message(const Message *msg, uint8_t *buffer, size_t buffer_size);
 int deserialize_message(const uint8_t *buffer, size_t buffer_len, Message *msg);
 void create_data_message(Message *msg, uint32_t seq_num, const char *payload);
 void create_ack_message(Message *msg, uint32_t seq_num);
+void create_sack_message(Message *msg, uint32_t cum_ack, uint64_t sack_bitmap, uint16_t window);
+int parse_sack_message(const Message *msg, uint32_t *cum_ack, uint64_t *sack_bitmap);
+int sack_covers(uint32_t cum_ack, uint64_t sack_bitmap, uint32_t seq_num);
+
+// Zero-copy API: frames are built and parsed where they sit in socket buffers
+int message_view_parse(const uint8_t *buffer, size_t buffer_len, MessageView *view);
+int parse_sack_view(const MessageView *view, uint32_t *cum_ack, uint64_t *sack_bitmap);
+size_t message_write_header(uint8_t *frame, uint8_t type, uint32_t seq_num, uint16_t payload_len);
+int build_ack_frame(uint8_t *buffer, size_t buffer_size, uint32_t seq_num);
+int build_sack_frame(uint8_t *buffer, size_t buffer_size, uint32_t cum_ack, uint64_t sack_bitmap,
+                     uint16_t window);
+uint16_t sack_view_window(const MessageView *view);
+uint16_t fragment_count(size_t record_len, size_t stride);
+size_t build_fragment_frame(uint8_t *frame, uint32_t seq_num, uint32_t msg_id,
+                            uint16_t index, uint16_t count, const uint8_t *data, size_t len);
+int fragment_view_parse(const MessageView *view, FragmentView *frag);
+int fragment_view_check(const FragmentView *frag, size_t stride);
+int build_session_frame(uint8_t *buffer, size_t buffer_size, uint8_t type, uint32_t seq_num,
+                        uint64_t session_id, uint16_t max_payload);
+int parse_session_view(const MessageView *view, uint64_t *session_id, uint16_t *max_payload);
+size_t message_seal(uint8_t *frame, size_t frame_len);
+int message_view_verify(const MessageView *view);
+
+// Bytes a parsed frame occupies, trailer included
+static inline size_t message_view_frame_len(const MessageView *view) {
+    return MESSAGE_HEADER_SIZE + (size_t)view->payload_len + (view->crc ? CRC_TRAILER_SIZE : 0);
+}
+
+// Framing bytes around the payload of a frame built with message_write_header()
+static inline size_t message_overhead(const uint8_t *frame) {
+    return MESSAGE_HEADER_SIZE + ((frame[2] & MSG_FLAG_CRC) ? CRC_TRAILER_SIZE : 0);
+}
+
+// Wraparound-safe sequence number comparison
+static inline int seq_before(uint32_t a, uint32_t b) {
+    return (int32_t)(a - b) < 0;
+}
 
 #endif //COMP7005PROJ1_PROTOCOL_H
\ No newline at end of file
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include "proxy.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -8,36 +9,103 @@
 #include <time.h>
 #include <errno.h>
 #include <signal.h>
-#include <sys/time.h>
-#include <sys/select.h>
+#include <sched.h>
 
 static volatile int running = 1;
+static EventLoop loop;
+
+static Metric m_received[2] = {
+    METRIC_COUNTER_INIT("proxy_client_packets_received_total", "Packets received from clients"),
+    METRIC_COUNTER_INIT("proxy_server_packets_received_total", "Packets received from the server")
+};
+static Metric m_dropped[2] = {
+    METRIC_COUNTER_INIT("proxy_client_packets_dropped_total", "Client packets dropped on purpose"),
+    METRIC_COUNTER_INIT("proxy_server_packets_dropped_total", "Server packets dropped on purpose")
+};
+static Metric m_forwarded[2] = {
+    METRIC_COUNTER_INIT("proxy_client_packets_forwarded_total", "Client packets sent on to the server"),
+    METRIC_COUNTER_INIT("proxy_server_packets_forwarded_total", "Server packets sent on to clients")
+};
+static Metric m_send_errors = METRIC_COUNTER_INIT("proxy_send_errors_total",
+                                                  "Packets the kernel refused to send");
+static Metric m_delayed = METRIC_COUNTER_INIT("proxy_packets_delayed_total",
+                                              "Packets given a random delay");
+static Metric m_reordered = METRIC_COUNTER_INIT("proxy_packets_reordered_total",
+                                                "Packets held back so later ones overtake them");
+static Metric m_duplicated = METRIC_COUNTER_INIT("proxy_packets_duplicated_total",
+                                                 "Packets forwarded twice");
+static Metric m_corrupted = METRIC_COUNTER_INIT("proxy_packets_corrupted_total",
+                                                "Packets forwarded with one bit flipped");
+static Metric m_bad_checksum = METRIC_COUNTER_INIT("proxy_checksum_failures_total",
+                                                   "Packets dropped by --verify-crc");
+static Metric m_rate_drops = METRIC_COUNTER_INIT("proxy_rate_queue_drops_total",
+                                                 "Packets dropped at a full rate-limited bottleneck");
+static Metric m_delay_full = METRIC_COUNTER_INIT("proxy_delay_queue_full_total",
+                                                 "Packets dropped because the delay queue was full");
+static Metric m_delay_depth = METRIC_GAUGE_INIT("proxy_delay_queue_depth",
+                                                "Packets currently waiting in the delay queue");
+static Metric m_delay_seconds = METRIC_HISTOGRAM_INIT("proxy_delay_seconds",
+                                                      "Delay applied to delayed packets",
+                                                      metrics_latency_bounds_ns, 1e-9);
+static Metric m_sessions = METRIC_GAUGE_INIT("proxy_sessions_active", "Client sessions open");
+static Metric m_sessions_rejected = METRIC_COUNTER_INIT("proxy_sessions_rejected_total",
+                                                        "Packets ignored because no session could be opened");
+
+static Metric m_backpressure = METRIC_COUNTER_INIT("proxy_pipeline_backpressure_total",
+                                                   "Times a pipeline stage waited for room in the next one");
+
+static Metric m_rx_overflow = METRIC_COUNTER_INIT("proxy_socket_overflow_drops_total",
+                                                  "Datagrams the kernel dropped on a full receive buffer");
+
+static Metric *const proxy_metrics[] = {
+    &m_received[DIR_CLIENT_TO_SERVER], &m_received[DIR_SERVER_TO_CLIENT],
+    &m_dropped[DIR_CLIENT_TO_SERVER], &m_dropped[DIR_SERVER_TO_CLIENT],
+    &m_forwarded[DIR_CLIENT_TO_SERVER], &m_forwarded[DIR_SERVER_TO_CLIENT],
+    &m_send_errors, &m_delayed, &m_reordered, &m_duplicated, &m_corrupted, &m_bad_checksum, &m_rate_drops,
+    &m_delay_full, &m_delay_depth, &m_delay_seconds,
+    &m_sessions, &m_sessions_rejected, &m_backpressure, &m_rx_overflow
+};
 
 void sigint_handler(int sig) {
     (void)sig;
     running = 0;
+    event_loop_wakeup(&loop);
+}
+
+// Sequence number for the event log; the proxy otherwise never looks inside packets
+static uint32_t frame_seq(const uint8_t *data, size_t len) {
+    MessageView view;
+    return message_view_parse(data, len, &view) == 0 ? view.seq_num : 0;
 }
 
 void log_proxy(FILE *log_fp, const char *format, ...) {
     va_list args;
-    time_t now = time(NULL);
-    char timestamp[64];
-    strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", localtime(&now));
-
-    fprintf(stderr, "[%s] ", timestamp);
     va_start(args, format);
-    vfprintf(stderr, format, args);
+    log_vwrite(LOG_LEVEL_INFO, log_fp, format, args);
     va_end(args);
-    fprintf(stderr, "\n");
+}
+
+// "--pin-cpus 2,3,4": one CPU per pipeline thread in stage order (C->S receive,
+// impair, transmit, then S->C). Returns the count, or -1 if malformed.
+static int parse_cpu_list(const char *list, int *cpus) {
+    int count = 0;
+    const char *p = list;
 
-    if (log_fp) {
-        fprintf(log_fp, "[%s] ", timestamp);
-        va_start(args, format);
-        vfprintf(log_fp, format, args);
-        va_end(args);
-        fprintf(log_fp, "\n");
-        fflush(log_fp);
+    while (*p) {
+        char *end;
+        long cpu = strtol(p, &end, 10);
+        if (end == p || cpu < 0 || cpu >= CPU_SETSIZE || count == PROXY_PIPELINE_THREADS) {
+            return -1;
+        }
+        cpus[count++] = (int)cpu;
+        if (*end == ',') {
+            end++;
+        } else if (*end) {
+            return -1;
+        }
+        p = end;
     }
+    return count > 0 ? count : -1;
 }
 
 int parse_proxy_args(int argc, char *argv[], ProxyConfig *config) {
@@ -45,15 +113,25 @@ int parse_proxy_args(int argc, char *argv[], ProxyConfig *config) {
     config->listen_port = 0;
     config->target_ip = NULL;
     config->target_port = 0;
-    config->client_drop = 0;
-    config->server_drop = 0;
-    config->client_delay = 0;
-    config->server_delay = 0;
-    config->client_delay_min = 0;
-    config->client_delay_max = 0;
-    config->server_delay_min = 0;
-    config->server_delay_max = 0;
+    impair_config_default(&config->impair[DIR_CLIENT_TO_SERVER]);
+    impair_config_default(&config->impair[DIR_SERVER_TO_CLIENT]);
+    config->seed = 0;
+    config->seed_set = 0;
+    config->delay_queue_size = DELAY_QUEUE_DEFAULT_CAPACITY;
+    config->max_sessions = 256;
+    config->session_timeout = 60;
+    config->batch = UDP_BATCH_DEFAULT;
+    config->pipeline = 0;
+    config->verify_crc = 0;
+    for (int i = 0; i < PROXY_PIPELINE_THREADS; i++) {
+        config->cpus[i] = PROXY_CPU_ANY;
+    }
+    config->cpu_count = 0;
+    sockopt_config_default(&config->sock);
     config->log_file = NULL;
+    log_config_default(&config->log);
+    metrics_config_default(&config->metrics);
+    evlog_config_default(&config->events);
 
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "--listen-ip") == 0 && i + 1 < argc) {
@@ -64,43 +142,62 @@ int parse_proxy_args(int argc, char *argv[], ProxyConfig *config) {
             config->target_ip = argv[++i];
         } else if (strcmp(argv[i], "--target-port") == 0 && i + 1 < argc) {
             config->target_port = atoi(argv[++i]);
-        } else if (strcmp(argv[i], "--client-drop") == 0 && i + 1 < argc) {
-            config->client_drop = atoi(argv[++i]);
-        } else if (strcmp(argv[i], "--server-drop") == 0 && i + 1 < argc) {
-            config->server_drop = atoi(argv[++i]);
-        } else if (strcmp(argv[i], "--client-delay") == 0 && i + 1 < argc) {
-            config->client_delay = atoi(argv[++i]);
-        } else if (strcmp(argv[i], "--server-delay") == 0 && i + 1 < argc) {
-            config->server_delay = atoi(argv[++i]);
-        } else if (strcmp(argv[i], "--client-delay-time-min") == 0 && i + 1 < argc) {
-            config->client_delay_min = atoi(argv[++i]);
-        } else if (strcmp(argv[i], "--client-delay-time-max") == 0 && i + 1 < argc) {
-            config->client_delay_max = atoi(argv[++i]);
-        } else if (strcmp(argv[i], "--server-delay-time-min") == 0 && i + 1 < argc) {
-            config->server_delay_min = atoi(argv[++i]);
-        } else if (strcmp(argv[i], "--server-delay-time-max") == 0 && i + 1 < argc) {
-            config->server_delay_max = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--delay-queue-size") == 0 && i + 1 < argc) {
+            config->delay_queue_size = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--max-sessions") == 0 && i + 1 < argc) {
+            config->max_sessions = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--session-timeout") == 0 && i + 1 < argc) {
+            config->session_timeout = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            config->batch = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--pipeline") == 0) {
+            config->pipeline = 1;
+        } else if (strcmp(argv[i], "--pin-cpus") == 0 && i + 1 < argc) {
+            config->cpu_count = parse_cpu_list(argv[++i], config->cpus);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            config->seed = strtoull(argv[++i], NULL, 0);
+            config->seed_set = 1;
+        } else if (strcmp(argv[i], "--verify-crc") == 0) {
+            config->verify_crc = 1;
+        } else if (strcmp(argv[i], "--gro") == 0) {
+            config->sock.gro = 1;
         } else if (strcmp(argv[i], "--log-file") == 0 && i + 1 < argc) {
             config->log_file = argv[++i];
+        } else if (!impair_parse_arg(argc, argv, &i, "--client-", &config->impair[DIR_CLIENT_TO_SERVER]) &&
+                   !impair_parse_arg(argc, argv, &i, "--server-", &config->impair[DIR_SERVER_TO_CLIENT]) &&
+                   !sockopt_parse_arg(argc, argv, &i, &config->sock) &&
+                   !log_parse_arg(argc, argv, &i, &config->log) &&
+                   !metrics_parse_arg(argc, argv, &i, &config->metrics)) {
+            evlog_parse_arg(argc, argv, &i, &config->events);
         }
     }
 
     if (!config->listen_ip || !config->target_ip ||
-        config->listen_port == 0 || config->target_port == 0) {
+        config->listen_port == 0 || config->target_port == 0 ||
+        config->delay_queue_size <= 0 || config->max_sessions <= 0 ||
+        config->session_timeout <= 0 || config->batch < 1 || config->batch > UDP_BATCH_MAX ||
+        config->cpu_count < 0 || (config->cpu_count > 0 && !config->pipeline) ||
+        !impair_config_valid(&config->impair[DIR_CLIENT_TO_SERVER]) ||
+        !impair_config_valid(&config->impair[DIR_SERVER_TO_CLIENT]) ||
+        !sockopt_config_valid(&config->sock) || !log_config_valid(&config->log) || !metrics_config_valid(&config->metrics)) {
         fprintf(stderr, "Usage: %s --listen-ip <ip> --listen-port <port> "
                        "--target-ip <ip> --target-port <port> "
                        "[--client-drop <%%>] [--server-drop <%%>] "
                        "[--client-delay <%%>] [--server-delay <%%>] "
                        "[--client-delay-time-min <ms>] [--client-delay-time-max <ms>] "
                        "[--server-delay-time-min <ms>] [--server-delay-time-max <ms>] "
-                       "[--log-file <file>]\n", argv[0]);
+                       "[--delay-queue-size <n>] [--max-sessions <n>] "
+                       "[--session-timeout <sec>] [--batch <1-%d>] "
+                       "[--pipeline [--pin-cpus <cpu,...>]] [--verify-crc] [--gro] " SOCKOPT_USAGE " "
+                       IMPAIR_USAGE " [--log-file <file>] " LOG_USAGE " " METRICS_USAGE " " EVLOG_USAGE "\n",
+                argv[0], UDP_BATCH_MAX);
         return -1;
     }
 
     return 0;
 }
 
-int create_and_bind_udp_socket(const char *ip, int port) {
+int create_and_bind_udp_socket(const char *ip, int port, const SocketConfig *sock, FILE *log_fp) {
     int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
     if (sockfd < 0) {
         perror("socket");
@@ -125,6 +222,8 @@ int create_and_bind_udp_socket(const char *ip, int port) {
         return -1;
     }
 
+    sockopt_apply(sockfd, sock, log_fp);
+
     if (bind(sockfd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
         perror("bind");
         close(sockfd);
@@ -134,184 +233,1094 @@ int create_and_bind_udp_socket(const char *ip, int port) {
     return sockfd;
 }
 
-int should_drop(int drop_percentage) {
-    if (drop_percentage <= 0) return 0;
-    if (drop_percentage >= 100) return 1;
-    return (rand() % 100) < drop_percentage;
+int proxy_tx_init(ProxyTx *tx, int direction, int batch_size) {
+    tx->direction = direction;
+    return udp_batch_init(&tx->batch, batch_size, PACKET_BUF_SIZE);
 }
 
-int get_delay_ms(int delay_percentage, int min_ms, int max_ms) {
-    if (delay_percentage <= 0) return 0;
-    if ((rand() % 100) >= delay_percentage) return 0;
+void proxy_tx_destroy(ProxyTx *tx) {
+    udp_batch_destroy(&tx->batch);
+}
+
+// Send everything queued for one direction, one sendmmsg() per socket
+void proxy_tx_flush(ProxyTx *tx, FILE *log_fp) {
+    const char *tag = tx->direction == DIR_CLIENT_TO_SERVER ? "C->S" : "S->C";
+    int queued = tx->batch.count;
+    int slots[UDP_BATCH_MAX];
+    uint64_t done = 0;
+
+    for (int first = 0; first < queued; first++) {
+        if (done & (1ULL << first)) {
+            continue;
+        }
 
-    if (min_ms >= max_ms) return min_ms;
-    return min_ms + (rand() % (max_ms - min_ms + 1));
+        // Gather every packet for this slot's socket, keeping their order
+        int fd = tx->fds[first];
+        int n = 0;
+        for (int i = first; i < queued; i++) {
+            if (!(done & (1ULL << i)) && tx->fds[i] == fd) {
+                slots[n++] = i;
+                done |= 1ULL << i;
+            }
+        }
+
+        int sent = udp_send_slots(fd, &tx->batch, slots, n);
+        metric_add(&m_forwarded[tx->direction], (uint64_t)sent);
+        metric_add(&m_send_errors, (uint64_t)(n - sent));
+        if (evlog_active) {
+            for (int k = 0; k < sent; k++) {
+                const uint8_t *data = udp_batch_buffer(&tx->batch, slots[k]);
+                evlog_emit(EV_PROXY_FORWARD, (uint8_t)tx->direction,
+                           frame_seq(data, tx->batch.len[slots[k]]), 0,
+                           (uint32_t)tx->batch.len[slots[k]], 0);
+            }
+        }
+        for (int k = 0; k < sent; k++) {
+            int i = slots[k];
+            char dest_ip[INET_ADDRSTRLEN];
+            inet_ntop(AF_INET, &tx->batch.addr[i].sin_addr, dest_ip, sizeof(dest_ip));
+            log_trace(log_fp, "%s: Forwarded %zu bytes to %s:%d",
+                     tag, tx->batch.len[i], dest_ip, ntohs(tx->batch.addr[i].sin_port));
+        }
+        if (sent < n) {
+            log_proxy(log_fp, "ERROR: sendto %s failed for %d of %d packets: %s",
+                     tx->direction == DIR_CLIENT_TO_SERVER ? "server" : "client",
+                     n - sent, n, strerror(errno));
+        }
+    }
+    tx->batch.count = 0;
 }
 
-int main(int argc, char *argv[]) {
-    ProxyConfig config;
-    FILE *log_fp = NULL;
+void forward_packet(ProxyTx *tx, int sockfd, const uint8_t *data, size_t len,
+                    const struct sockaddr_in *dest, socklen_t dest_len, FILE *log_fp) {
+    int slot = tx->batch.count;
 
-    if (parse_proxy_args(argc, argv, &config) < 0) {
-        return EXIT_FAILURE;
+    // Packets for different sockets share the batch until the next flush
+    if (udp_batch_add(&tx->batch, data, len, dest, dest_len) == 0) {
+        tx->fds[slot] = sockfd;
     }
+    if (tx->batch.count >= tx->batch.capacity) {
+        proxy_tx_flush(tx, log_fp);
+    }
+}
 
-    if (config.log_file) {
-        log_fp = fopen(config.log_file, "a");
-        if (!log_fp) {
-            fprintf(stderr, "Warning: Could not open log file %s\n", config.log_file);
+// --verify-crc: returns -1 for a frame whose trailer shows it was damaged
+// upstream. Frames without a trailer, or that are not ours, pass untouched.
+static int verify_packet(const ProxyContext *proxy, int direction, const uint8_t *data, size_t len) {
+    MessageView view;
+    if (!proxy->config->verify_crc || message_view_parse(data, len, &view) < 0 ||
+        message_view_verify(&view) == 0) {
+        return 0;
+    }
+    metric_inc(&m_bad_checksum);
+    evlog_emit(EV_PROXY_CRC_DROP, (uint8_t)direction, view.seq_num, 0, (uint32_t)len, 0);
+    log_proxy(proxy->log_fp, "%s: DROPPED (bad checksum)",
+              direction == DIR_CLIENT_TO_SERVER ? "C->S" : "S->C");
+    return -1;
+}
+
+// Run a direction's impairment models on one packet, logging and counting
+// what they chose. A corrupted packet is damaged in place. Returns -1 if
+// the packet is dropped.
+static int impair_packet(Impairment *imp, int direction, uint8_t *data, size_t len,
+                         uint64_t now_ns, ImpairDecision *d, FILE *log_fp) {
+    const char *tag = direction == DIR_CLIENT_TO_SERVER ? "C->S" : "S->C";
+
+    impair_decide(imp, len, now_ns, d);
+    if (d->verdict == IMPAIR_DROP) {
+        metric_inc(&m_dropped[direction]);
+        evlog_emit(EV_PROXY_DROP, (uint8_t)direction, frame_seq(data, len), 0, (uint32_t)len, 0);
+        log_proxy(log_fp, "%s: DROPPED", tag);
+        return -1;
+    }
+    if (d->verdict == IMPAIR_QUEUE_DROP) {
+        metric_inc(&m_rate_drops);
+        evlog_emit(EV_PROXY_RATE_DROP, (uint8_t)direction, frame_seq(data, len), 0,
+                   (uint32_t)len, 0);
+        log_proxy(log_fp, "%s: DROPPED (rate queue full)", tag);
+        return -1;
+    }
+
+    if (d->delay_ms > 0) {
+        metric_inc(&m_delayed);
+        metric_observe(&m_delay_seconds, (uint64_t)d->delay_ms * 1000000ULL);
+        evlog_emit(EV_PROXY_DELAY, (uint8_t)direction, frame_seq(data, len), 0,
+                   (uint32_t)len, (uint32_t)d->delay_ms);
+        log_proxy(log_fp, "%s: DELAYED %dms", tag, d->delay_ms);
+    } else if (d->reorder_ms > 0) {
+        metric_inc(&m_reordered);
+        evlog_emit(EV_PROXY_REORDER, (uint8_t)direction, frame_seq(data, len), 0,
+                   (uint32_t)len, (uint32_t)d->reorder_ms);
+        log_proxy(log_fp, "%s: REORDERED (held %dms)", tag, d->reorder_ms);
+    }
+    if (d->duplicate) {
+        metric_inc(&m_duplicated);
+        evlog_emit(EV_PROXY_DUPLICATE, (uint8_t)direction, frame_seq(data, len), 0,
+                   (uint32_t)len, 0);
+        log_proxy(log_fp, "%s: DUPLICATED", tag);
+    }
+    if (d->corrupt_bit > 0) {
+        uint32_t bit = d->corrupt_bit - 1;
+        metric_inc(&m_corrupted);
+        evlog_emit(EV_PROXY_CORRUPT, (uint8_t)direction, frame_seq(data, len), 0,
+                   (uint32_t)len, bit);
+        log_proxy(log_fp, "%s: CORRUPTED (bit %u)", tag, bit);
+        data[bit / 8] ^= (uint8_t)(1u << (bit % 8));
+    }
+    return 0;
+}
+
+// Count a packet parked in a delay queue, or report that it did not fit
+static void note_parked(int direction, int queued, const uint8_t *data, size_t len, FILE *log_fp) {
+    if (queued) {
+        metric_inc(&m_delay_depth);
+        return;
+    }
+    metric_inc(&m_delay_full);
+    evlog_emit(EV_PROXY_QUEUE_FULL, (uint8_t)direction, frame_seq(data, len), 0,
+               (uint32_t)len, 0);
+    log_proxy(log_fp, "%s: DROPPED (delay queue full)", direction == DIR_CLIENT_TO_SERVER ?
+              "C->S" : "S->C");
+}
+
+// Forward now, or park the packet (and its duplicate) in the delay queue
+// until its hold expires
+static void dispatch_packet(DelayQueue *delayed, ProxyTx *tx, int sockfd,
+                            uint64_t now_ns, const ImpairDecision *d,
+                            const uint8_t *data, size_t len,
+                            const struct sockaddr_in *dest, socklen_t dest_len, FILE *log_fp) {
+    uint64_t hold_ns = impair_hold_ns(d);
+
+    for (int copy = 0; copy <= d->duplicate; copy++) {
+        if (hold_ns == 0) {
+            forward_packet(tx, sockfd, data, len, dest, dest_len, log_fp);
+            continue;
         }
+        int queued = delay_queue_push(delayed, now_ns + hold_ns, sockfd, tx->direction,
+                                      dest, dest_len, data, len) == 0;
+        note_parked(tx->direction, queued, data, len, log_fp);
     }
+}
 
-    srand((unsigned int)time(NULL));
-    signal(SIGINT, sigint_handler);
+static void release_due_packets(DelayQueue *delayed, ProxyTx *tx, FILE *log_fp) {
+    uint64_t now = monotonic_ns();
+    uint64_t released = 0;
+    DelayedPacket *pkt;
 
-    log_proxy(log_fp, "PROXY STARTED: listen=%s:%d, target=%s:%d",
-             config.listen_ip, config.listen_port, config.target_ip, config.target_port);
-    log_proxy(log_fp, "CLIENT->SERVER: drop=%d%%, delay=%d%% (%d-%dms)",
-             config.client_drop, config.client_delay,
-             config.client_delay_min, config.client_delay_max);
-    log_proxy(log_fp, "SERVER->CLIENT: drop=%d%%, delay=%d%% (%d-%dms)",
-             config.server_drop, config.server_delay,
-             config.server_delay_min, config.server_delay_max);
-
-    int sockfd = create_and_bind_udp_socket(config.listen_ip, config.listen_port);
-    if (sockfd < 0) {
-        if (log_fp) fclose(log_fp);
-        return EXIT_FAILURE;
+    while ((pkt = delay_queue_peek(delayed)) && pkt->release_ns <= now) {
+        forward_packet(&tx[pkt->direction], pkt->fd, pkt->buf->data, pkt->buf->len,
+                       &pkt->dest, pkt->dest_len, log_fp);
+        delay_queue_pop(delayed);
+        released++;
     }
+    metric_sub(&m_delay_depth, released);
+}
 
-    // Set up target server address
-    struct sockaddr_in target_addr;
-    memset(&target_addr, 0, sizeof(target_addr));
-    target_addr.sin_family = AF_INET;
-    target_addr.sin_port = htons(config.target_port);
-    if (inet_pton(AF_INET, config.target_ip, &target_addr.sin_addr) <= 0) {
-        fprintf(stderr, "Invalid target IP address\n");
-        close(sockfd);
-        if (log_fp) fclose(log_fp);
-        return EXIT_FAILURE;
+int session_table_init(SessionTable *table, int capacity, EventLoop *loop,
+                       EventHandler on_readable, void *ctx) {
+    memset(table, 0, sizeof(*table));
+    table->loop = loop;
+    table->on_readable = on_readable;
+    table->ctx = ctx;
+
+    table->sessions = calloc((size_t)capacity, sizeof(ProxySession));
+    table->free_list = malloc((size_t)capacity * sizeof(int));
+    if (!table->sessions || !table->free_list ||
+        addr_table_init(&table->index, capacity) < 0) {
+        session_table_destroy(table);
+        return -1;
     }
 
-    // Store the last known client address (for sending ACKs back)
-    struct sockaddr_in last_client_addr;
-    socklen_t last_client_len = 0;
-    int have_client_addr = 0;
+    table->capacity = capacity;
+    for (int i = 0; i < capacity; i++) {
+        table->free_list[i] = capacity - 1 - i;
+    }
+    table->free_count = capacity;
+    return 0;
+}
 
-    struct sockaddr_in from_addr;
-    socklen_t from_len;
-    uint8_t buffer[2048];
+void session_table_destroy(SessionTable *table) {
+    if (table->sessions) {
+        for (int i = 0; i < table->capacity; i++) {
+            if (table->sessions[i].in_use) {
+                event_loop_remove(table->loop, &table->sessions[i].src);
+                close(table->sessions[i].upstream_fd);
+            }
+        }
+    }
+    free(table->sessions);
+    free(table->free_list);
+    addr_table_destroy(&table->index);
+    memset(table, 0, sizeof(*table));
+}
 
-    printf("Proxy running on %s:%d -> %s:%d\n",
-           config.listen_ip, config.listen_port,
-           config.target_ip, config.target_port);
-    printf("Press Ctrl+C to stop\n\n");
+// Returns -1 if the upstream socket's watcher cannot be told yet; try again later
+static int session_close(SessionTable *table, ProxySession *session) {
+    if (table->notices) {
+        SessionNotice notice = { 0, session->upstream_fd, session };
+        if (spsc_ring_push(table->notices, &notice) < 0) {
+            return -1;
+        }
+        event_loop_wakeup(table->loop);
+    } else {
+        event_loop_remove(table->loop, &session->src);
+        close(session->upstream_fd);
+        table->free_list[table->free_count++] = (int)(session - table->sessions);
+    }
+    addr_table_remove(&table->index, &session->client_addr);
+    session->in_use = 0;
+    metric_sub(&m_sessions, 1);
+    return 0;
+}
 
-    while (running) {
-        fd_set readfds;
-        struct timeval tv;
+ProxySession *session_lookup_or_create(SessionTable *table, const struct sockaddr_in *client_addr,
+                                       socklen_t client_len, FILE *log_fp) {
+    int idx = addr_table_get(&table->index, client_addr);
+    if (idx >= 0) {
+        return &table->sessions[idx];
+    }
 
-        FD_ZERO(&readfds);
-        FD_SET(sockfd, &readfds);
-        tv.tv_sec = 1;
-        tv.tv_usec = 0;
+    char client_ip[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &client_addr->sin_addr, client_ip, sizeof(client_ip));
 
-        int ready = select(sockfd + 1, &readfds, NULL, NULL, &tv);
+    // Slots closed earlier whose upstream sockets the watcher has since dropped
+    if (table->released) {
+        int released;
+        while (spsc_ring_pop(table->released, &released) == 0) {
+            table->free_list[table->free_count++] = released;
+        }
+    }
+    if (table->free_count == 0) {
+        log_proxy(log_fp, "ERROR: Session table full, ignoring client %s:%d",
+                 client_ip, ntohs(client_addr->sin_port));
+        return NULL;
+    }
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        log_proxy(log_fp, "ERROR: socket for %s:%d failed: %s",
+                 client_ip, ntohs(client_addr->sin_port), strerror(errno));
+        return NULL;
+    }
+    if (table->sock) {
+        sockopt_apply(fd, table->sock, log_fp);
+    }
+
+    idx = table->free_list[table->free_count - 1];
+    ProxySession *session = &table->sessions[idx];
+    if (!table->notices && event_loop_add(table->loop, &session->src, fd, table->on_readable,
+                                          table->ctx, session) < 0) {
+        log_proxy(log_fp, "ERROR: Cannot watch socket for %s:%d: %s",
+                 client_ip, ntohs(client_addr->sin_port), strerror(errno));
+        close(fd);
+        return NULL;
+    }
+    table->free_count--;
+    session->in_use = 1;
+    session->upstream_fd = fd;
+    session->rx_overflow = 0;
+    session->client_addr = *client_addr;
+    session->client_len = client_len;
+    atomic_store_explicit(&session->last_active_ns, monotonic_ns(), memory_order_relaxed);
+    addr_table_put(&table->index, client_addr, idx);
 
-        if (ready < 0 && errno != EINTR) {
-            log_proxy(log_fp, "ERROR: select failed: %s", strerror(errno));
+    // Published after the session is filled in, so the watcher sees it whole
+    if (table->notices) {
+        SessionNotice notice = { 1, fd, session };
+        if (spsc_ring_push(table->notices, &notice) < 0) {
+            log_proxy(log_fp, "ERROR: Cannot watch socket for %s:%d: notice queue full",
+                     client_ip, ntohs(client_addr->sin_port));
+            addr_table_remove(&table->index, client_addr);
+            session->in_use = 0;
+            table->free_count++;
+            close(fd);
+            return NULL;
+        }
+        event_loop_wakeup(table->loop);
+    }
+    metric_inc(&m_sessions);
+
+    log_proxy(log_fp, "SESSION OPEN: client=%s:%d, sessions=%d",
+             client_ip, ntohs(client_addr->sin_port),
+             table->capacity - table->free_count);
+    return session;
+}
+
+void session_evict_idle(SessionTable *table, uint64_t now_ns, uint64_t idle_ns, FILE *log_fp) {
+    for (int i = 0; i < table->capacity; i++) {
+        ProxySession *session = &table->sessions[i];
+        uint64_t last_active = atomic_load_explicit(&session->last_active_ns, memory_order_relaxed);
+        if (!session->in_use || now_ns - last_active < idle_ns) {
+            continue;
+        }
+
+        char client_ip[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &session->client_addr.sin_addr, client_ip, sizeof(client_ip));
+        if (session_close(table, session) < 0) {
             break;
         }
+        log_proxy(log_fp, "SESSION EVICT: client=%s:%d, idle=%llus",
+                 client_ip, ntohs(session->client_addr.sin_port),
+                 (unsigned long long)((now_ns - last_active) / 1000000000ULL));
+    }
+}
 
-        if (ready > 0 && FD_ISSET(sockfd, &readfds)) {
-            from_len = sizeof(from_addr);
-            ssize_t recv_len = recvfrom(sockfd, buffer, sizeof(buffer), 0,
-                                       (struct sockaddr *)&from_addr, &from_len);
+// Receive-side bookkeeping for a client datagram; returns its session, or NULL to ignore it
+static ProxySession *accept_client_packet(ProxyContext *proxy, const uint8_t *buffer, size_t recv_len,
+                                          const struct sockaddr_in *from_addr, socklen_t from_len) {
+    char from_ip[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &from_addr->sin_addr, from_ip, sizeof(from_ip));
+    log_trace(proxy->log_fp, "C->S: Received %zu bytes from %s:%d",
+             recv_len, from_ip, ntohs(from_addr->sin_port));
 
-            if (recv_len < 0) {
-                log_proxy(log_fp, "ERROR: recvfrom failed: %s", strerror(errno));
-                continue;
+    metric_inc(&m_received[DIR_CLIENT_TO_SERVER]);
+    evlog_emit(EV_PROXY_RECV, DIR_CLIENT_TO_SERVER, frame_seq(buffer, recv_len), 0,
+               (uint32_t)recv_len, 0);
+    ProxySession *session = session_lookup_or_create(&proxy->sessions, from_addr, from_len,
+                                                     proxy->log_fp);
+    if (!session) {
+        metric_inc(&m_sessions_rejected);
+        return NULL;
+    }
+    atomic_store_explicit(&session->last_active_ns, monotonic_ns(), memory_order_relaxed);
+    return session;
+}
+
+static void accept_server_packet(ProxyContext *proxy, ProxySession *session,
+                                 const uint8_t *buffer, size_t recv_len) {
+    log_trace(proxy->log_fp, "S->C: Received %zu bytes from server", recv_len);
+    metric_inc(&m_received[DIR_SERVER_TO_CLIENT]);
+    evlog_emit(EV_PROXY_RECV, DIR_SERVER_TO_CLIENT, frame_seq(buffer, recv_len), 0,
+               (uint32_t)recv_len, 0);
+    atomic_store_explicit(&session->last_active_ns, monotonic_ns(), memory_order_relaxed);
+}
+
+static void handle_client_packet(ProxyContext *proxy, uint8_t *buffer, size_t recv_len,
+                                 const struct sockaddr_in *from_addr, socklen_t from_len) {
+    ProxySession *session = accept_client_packet(proxy, buffer, recv_len, from_addr, from_len);
+    if (!session || verify_packet(proxy, DIR_CLIENT_TO_SERVER, buffer, recv_len) < 0) {
+        return;
+    }
+
+    ImpairDecision d;
+    uint64_t now = monotonic_ns();
+    if (impair_packet(&proxy->impair[DIR_CLIENT_TO_SERVER], DIR_CLIENT_TO_SERVER, buffer, recv_len,
+                      now, &d, proxy->log_fp) < 0) {
+        return;
+    }
+    dispatch_packet(&proxy->delayed, &proxy->tx[DIR_CLIENT_TO_SERVER], session->upstream_fd, now, &d,
+                    buffer, recv_len, &proxy->target_addr, sizeof(proxy->target_addr),
+                    proxy->log_fp);
+}
+
+static void handle_server_packet(ProxyContext *proxy, ProxySession *session,
+                                 uint8_t *buffer, size_t recv_len) {
+    accept_server_packet(proxy, session, buffer, recv_len);
+    if (verify_packet(proxy, DIR_SERVER_TO_CLIENT, buffer, recv_len) < 0) {
+        return;
+    }
+
+    ImpairDecision d;
+    uint64_t now = monotonic_ns();
+    if (impair_packet(&proxy->impair[DIR_SERVER_TO_CLIENT], DIR_SERVER_TO_CLIENT, buffer, recv_len,
+                      now, &d, proxy->log_fp) < 0) {
+        return;
+    }
+    dispatch_packet(&proxy->delayed, &proxy->tx[DIR_SERVER_TO_CLIENT], proxy->listen_fd, now, &d,
+                    buffer, recv_len, &session->client_addr, session->client_len,
+                    proxy->log_fp);
+}
+
+// Losses the kernel took on a full receive buffer look like impairment
+// drops downstream, so they are counted separately
+static void note_overflow(const UdpBatch *rx, uint32_t *seen, const char *which, FILE *log_fp) {
+    uint32_t overflow = udp_batch_overflow(rx, seen);
+    if (overflow > 0) {
+        metric_add(&m_rx_overflow, overflow);
+        log_proxy(log_fp, "WARN: %s socket receive buffer overran, kernel dropped %u datagrams "
+                 "(raise --rcvbuf)", which, overflow);
+    }
+}
+
+// Listen socket readable: a batch of client datagrams
+static void on_client_datagrams(EventSource *src, uint32_t events) {
+    ProxyContext *proxy = src->ctx;
+    (void)events;
+
+    int n = udp_recv_batch(proxy->listen_fd, &proxy->rx);
+    if (n < 0) {
+        log_proxy(proxy->log_fp, "ERROR: recvmmsg failed: %s", strerror(errno));
+        return;
+    }
+    note_overflow(&proxy->rx, &proxy->listen_overflow, "listen", proxy->log_fp);
+    for (int i = 0; i < n; i++) {
+        uint8_t *data = udp_batch_buffer(&proxy->rx, i);
+        size_t off = 0;
+        do {
+            size_t len = udp_batch_segment_len(&proxy->rx, i, off);
+            handle_client_packet(proxy, data + off, len, &proxy->rx.addr[i], proxy->rx.addr_len[i]);
+            off += len;
+        } while (off < proxy->rx.len[i]);
+    }
+}
+
+// Session socket readable: server replies for exactly one client
+static void on_server_datagrams(EventSource *src, uint32_t events) {
+    ProxyContext *proxy = src->ctx;
+    ProxySession *session = src->data;
+    (void)events;
+
+    int n = udp_recv_batch(session->upstream_fd, &proxy->rx);
+    if (n < 0) {
+        log_proxy(proxy->log_fp, "ERROR: recv from server failed: %s", strerror(errno));
+        return;
+    }
+    note_overflow(&proxy->rx, &session->rx_overflow, "upstream", proxy->log_fp);
+    for (int i = 0; i < n; i++) {
+        uint8_t *data = udp_batch_buffer(&proxy->rx, i);
+        size_t off = 0;
+        do {
+            size_t len = udp_batch_segment_len(&proxy->rx, i, off);
+            handle_server_packet(proxy, session, data + off, len);
+            off += len;
+        } while (off < proxy->rx.len[i]);
+    }
+}
+
+/*
+ * Pipeline mode. Each direction runs as three threads (receive, impair,
+ * transmit) joined by SPSC rings of StagePackets, so socket reads, the
+ * drop/delay decisions and socket writes overlap instead of taking turns.
+ * The C->S receive thread owns the session table; the S->C receive
+ * thread owns the loop watching upstream sockets and learns of new and
+ * closed sessions through the notice ring.
+ */
+
+// Pairs with the fence in stage_wait(): either the consumer sees what was
+// just pushed, or this sees it asleep and wakes it
+static void stage_wake(ProxyStage *stage) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&stage->sleeping, memory_order_relaxed)) {
+        event_loop_wakeup(&stage->loop);
+    }
+}
+
+// Yield briefly while the input ring is empty, then sleep until woken or the deadline
+static void stage_wait(ProxyStage *stage, uint64_t deadline_ns) {
+    for (int i = 0; i < PROXY_STAGE_SPIN; i++) {
+        if (!spsc_ring_empty(stage->in)) {
+            return;
+        }
+        sched_yield();
+    }
+
+    atomic_store_explicit(&stage->sleeping, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    if (running && spsc_ring_empty(stage->in)) {
+        event_loop_poll(&stage->loop, deadline_ns);
+    }
+    atomic_store_explicit(&stage->sleeping, 0, memory_order_relaxed);
+}
+
+// Hand a packet to the next stage. A full ring is waited out rather than
+// dropped, so overload backs up into the socket buffer as it does inline.
+static void stage_push(ProxyStage *stage, const StagePacket *pkt) {
+    if (spsc_ring_push(stage->out, pkt) == 0) {
+        return;
+    }
+
+    metric_inc(&m_backpressure);
+    stage_wake(stage->next);
+    while (spsc_ring_push(stage->out, pkt) < 0) {
+        if (!running) {
+            packet_free(pkt->buf);
+            return;
+        }
+        sched_yield();
+    }
+}
+
+static void stage_accept(ProxyStage *stage, const uint8_t *data, size_t len, int fd,
+                         const struct sockaddr_in *dest, socklen_t dest_len) {
+    if (len > PACKET_BUF_SIZE) {
+        return;
+    }
+    StagePacket pkt;
+    pkt.buf = packet_alloc();
+    if (!pkt.buf) {
+        return;               // Counted by the pool as exhausted
+    }
+    pkt.buf->len = len;
+    memcpy(pkt.buf->data, data, len);
+    pkt.fd = fd;
+    pkt.dest = *dest;
+    pkt.dest_len = dest_len;
+    stage_push(stage, &pkt);
+}
+
+static void on_client_datagrams_staged(EventSource *src, uint32_t events) {
+    ProxyStage *stage = src->ctx;
+    ProxyContext *proxy = stage->proxy;
+    UdpBatch *rx = &proxy->pipes[DIR_CLIENT_TO_SERVER].rx;
+    (void)events;
+
+    int n = udp_recv_batch(proxy->listen_fd, rx);
+    if (n < 0) {
+        log_proxy(proxy->log_fp, "ERROR: recvmmsg failed: %s", strerror(errno));
+        return;
+    }
+    note_overflow(rx, &proxy->listen_overflow, "listen", proxy->log_fp);
+    for (int i = 0; i < n; i++) {
+        const uint8_t *data = udp_batch_buffer(rx, i);
+        size_t off = 0;
+        do {
+            size_t len = udp_batch_segment_len(rx, i, off);
+            ProxySession *session = accept_client_packet(proxy, data + off, len,
+                                                         &rx->addr[i], rx->addr_len[i]);
+            if (session) {
+                stage_accept(stage, data + off, len, session->upstream_fd,
+                             &proxy->target_addr, sizeof(proxy->target_addr));
             }
+            off += len;
+        } while (off < rx->len[i]);
+    }
+    stage_wake(stage->next);
+}
 
-            char from_ip[INET_ADDRSTRLEN];
-            inet_ntop(AF_INET, &from_addr.sin_addr, from_ip, sizeof(from_ip));
-            int from_port = ntohs(from_addr.sin_port);
+static void on_server_datagrams_staged(EventSource *src, uint32_t events) {
+    ProxyStage *stage = src->ctx;
+    ProxyContext *proxy = stage->proxy;
+    ProxySession *session = src->data;
+    UdpBatch *rx = &proxy->pipes[DIR_SERVER_TO_CLIENT].rx;
+    (void)events;
 
-            // Determine direction: check if this is from the target server
-            int is_from_server = (strcmp(from_ip, config.target_ip) == 0 &&
-                                 from_port == config.target_port);
+    int n = udp_recv_batch(src->fd, rx);
+    if (n < 0) {
+        log_proxy(proxy->log_fp, "ERROR: recv from server failed: %s", strerror(errno));
+        return;
+    }
+    note_overflow(rx, &session->rx_overflow, "upstream", proxy->log_fp);
+    for (int i = 0; i < n; i++) {
+        const uint8_t *data = udp_batch_buffer(rx, i);
+        size_t off = 0;
+        do {
+            size_t len = udp_batch_segment_len(rx, i, off);
+            accept_server_packet(proxy, session, data + off, len);
+            stage_accept(stage, data + off, len, proxy->listen_fd,
+                         &session->client_addr, session->client_len);
+            off += len;
+        } while (off < rx->len[i]);
+    }
+    stage_wake(stage->next);
+}
 
-            if (!is_from_server) {
-                // Client -> Server
-                log_proxy(log_fp, "C->S: Received %zd bytes from %s:%d",
-                         recv_len, from_ip, from_port);
+// S->C receive thread (or main, once it has stopped): apply queued session changes
+static void apply_session_notices(ProxyContext *proxy) {
+    ProxyStage *stage = &proxy->pipes[DIR_SERVER_TO_CLIENT].stages[STAGE_RECEIVE];
+    SessionNotice notice;
 
-                // Store client address for later use
-                memcpy(&last_client_addr, &from_addr, sizeof(from_addr));
-                last_client_len = from_len;
-                have_client_addr = 1;
+    while (spsc_ring_pop(&proxy->notices, &notice) == 0) {
+        if (!notice.open) {
+            // Sized for every slot, so handing it back cannot fail
+            int released = (int)(notice.session - proxy->sessions.sessions);
+            event_loop_remove(&stage->loop, &notice.session->src);
+            close(notice.fd);
+            spsc_ring_push(&proxy->released, &released);
+        } else if (event_loop_add(&stage->loop, &notice.session->src, notice.fd,
+                                  on_server_datagrams_staged, stage, notice.session) < 0) {
+            log_proxy(proxy->log_fp, "ERROR: Cannot watch upstream socket: %s", strerror(errno));
+        }
+    }
+}
 
-                if (should_drop(config.client_drop)) {
-                    log_proxy(log_fp, "C->S: DROPPED");
-                    continue;
-                }
+static void run_receive_stage(ProxyStage *stage) {
+    ProxyContext *proxy = stage->proxy;
+    uint64_t next_sweep_ns = monotonic_ns() + 1000000000ULL;
 
-                int delay = get_delay_ms(config.client_delay,
-                                       config.client_delay_min,
-                                       config.client_delay_max);
-                if (delay > 0) {
-                    log_proxy(log_fp, "C->S: DELAYED %dms", delay);
-                    usleep(delay * 1000);
-                }
+    while (running) {
+        uint64_t deadline = stage->direction == DIR_CLIENT_TO_SERVER ?
+                            next_sweep_ns : EVENT_LOOP_NO_DEADLINE;
+        if (event_loop_poll(&stage->loop, deadline) < 0) {
+            log_proxy(proxy->log_fp, "ERROR: event loop failed: %s", strerror(errno));
+            running = 0;
+            event_loop_wakeup(&loop);
+            break;
+        }
 
-                // Forward to server
-                ssize_t sent = sendto(sockfd, buffer, recv_len, 0,
-                                    (struct sockaddr *)&target_addr, sizeof(target_addr));
-                if (sent < 0) {
-                    log_proxy(log_fp, "ERROR: sendto server failed: %s", strerror(errno));
-                } else {
-                    log_proxy(log_fp, "C->S: Forwarded %zd bytes to %s:%d",
-                             sent, config.target_ip, config.target_port);
-                }
-            } else {
-                // Server -> Client
-                log_proxy(log_fp, "S->C: Received %zd bytes from server", recv_len);
+        if (stage->direction == DIR_SERVER_TO_CLIENT) {
+            apply_session_notices(proxy);
+            continue;
+        }
+        uint64_t now = monotonic_ns();
+        if (now >= next_sweep_ns) {
+            session_evict_idle(&proxy->sessions, now, proxy->idle_ns, proxy->log_fp);
+            next_sweep_ns = now + 1000000000ULL;
+        }
+    }
+}
 
-                if (!have_client_addr) {
-                    log_proxy(log_fp, "ERROR: No client address known, cannot forward");
-                    continue;
-                }
+// Pass a packet on now, or park it in the stage's delay queue until release_ns
+static void stage_hold(ProxyStage *stage, DelayQueue *delayed, StagePacket *pkt,
+                       uint64_t release_ns, uint64_t now_ns) {
+    if (release_ns <= now_ns) {
+        stage_push(stage, pkt);
+        return;
+    }
+    int queued = delay_queue_push_buf(delayed, release_ns, pkt->fd, stage->direction,
+                                      &pkt->dest, pkt->dest_len, pkt->buf) == 0;
+    note_parked(stage->direction, queued, pkt->buf->data, pkt->buf->len, stage->proxy->log_fp);
+    if (!queued) {
+        packet_free(pkt->buf);
+    }
+}
 
-                if (should_drop(config.server_drop)) {
-                    log_proxy(log_fp, "S->C: DROPPED");
-                    continue;
-                }
+static void run_impair_stage(ProxyStage *stage) {
+    ProxyContext *proxy = stage->proxy;
+    DelayQueue *delayed = &proxy->pipes[stage->direction].delayed;
+    StagePacket pkt;
 
-                int delay = get_delay_ms(config.server_delay,
-                                       config.server_delay_min,
-                                       config.server_delay_max);
-                if (delay > 0) {
-                    log_proxy(log_fp, "S->C: DELAYED %dms", delay);
-                    usleep(delay * 1000);
-                }
+    while (running) {
+        int moved = 0;
+
+        while (moved < PROXY_RING_SIZE && spsc_ring_pop(stage->in, &pkt) == 0) {
+            ImpairDecision d;
+            uint64_t now = monotonic_ns();
+            moved++;
+            if (verify_packet(proxy, stage->direction, pkt.buf->data, pkt.buf->len) < 0 ||
+                impair_packet(&proxy->impair[stage->direction], stage->direction,
+                              pkt.buf->data, pkt.buf->len, now, &d, proxy->log_fp) < 0) {
+                packet_free(pkt.buf);
+                continue;
+            }
 
-                // Forward to client
-                ssize_t sent = sendto(sockfd, buffer, recv_len, 0,
-                                    (struct sockaddr *)&last_client_addr, last_client_len);
-                if (sent < 0) {
-                    log_proxy(log_fp, "ERROR: sendto client failed: %s", strerror(errno));
-                } else {
-                    char client_ip[INET_ADDRSTRLEN];
-                    inet_ntop(AF_INET, &last_client_addr.sin_addr, client_ip, sizeof(client_ip));
-                    log_proxy(log_fp, "S->C: Forwarded %zd bytes to %s:%d",
-                             sent, client_ip, ntohs(last_client_addr.sin_port));
+            uint64_t release_ns = now + impair_hold_ns(&d);
+            if (d.duplicate) {
+                StagePacket copy = pkt;
+                copy.buf = packet_alloc();
+                if (copy.buf) {
+                    copy.buf->len = pkt.buf->len;
+                    memcpy(copy.buf->data, pkt.buf->data, pkt.buf->len);
+                    stage_hold(stage, delayed, &copy, release_ns, now);
                 }
             }
+            stage_hold(stage, delayed, &pkt, release_ns, now);
+        }
+
+        uint64_t now = monotonic_ns();
+        uint64_t released = 0;
+        DelayedPacket *next;
+        while ((next = delay_queue_peek(delayed)) && next->release_ns <= now) {
+            pkt.fd = next->fd;
+            pkt.dest = next->dest;
+            pkt.dest_len = next->dest_len;
+            pkt.buf = delay_queue_take(delayed);
+            stage_push(stage, &pkt);
+            released++;
+        }
+        metric_sub(&m_delay_depth, released);
+
+        if (moved || released) {
+            stage_wake(stage->next);
+            continue;
+        }
+        next = delay_queue_peek(delayed);
+        stage_wait(stage, next ? next->release_ns : EVENT_LOOP_NO_DEADLINE);
+    }
+}
+
+static void run_transmit_stage(ProxyStage *stage) {
+    ProxyContext *proxy = stage->proxy;
+    ProxyTx *tx = &proxy->pipes[stage->direction].tx;
+    StagePacket pkt;
+
+    while (running) {
+        int moved = 0;
+
+        while (moved < PROXY_RING_SIZE && spsc_ring_pop(stage->in, &pkt) == 0) {
+            forward_packet(tx, pkt.fd, pkt.buf->data, pkt.buf->len, &pkt.dest, pkt.dest_len,
+                           proxy->log_fp);
+            packet_free(pkt.buf);
+            moved++;
+        }
+        proxy_tx_flush(tx, proxy->log_fp);
+
+        if (!moved) {
+            stage_wait(stage, EVENT_LOOP_NO_DEADLINE);
         }
     }
+}
+
+static void *stage_main(void *arg) {
+    static const char *const names[2][PROXY_STAGES] = {
+        { "c2s-recv", "c2s-impair", "c2s-send" },
+        { "s2c-recv", "s2c-impair", "s2c-send" }
+    };
+    ProxyStage *stage = arg;
+    const char *name = names[stage->direction][stage->kind];
+
+    pthread_setname_np(pthread_self(), name);
+    if (stage->cpu != PROXY_CPU_ANY) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(stage->cpu, &cpus);
+        int rc = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        if (rc != 0) {
+            log_proxy(stage->proxy->log_fp, "WARN: Cannot pin %s to cpu %d: %s",
+                     name, stage->cpu, strerror(rc));
+        }
+    }
+
+    switch (stage->kind) {
+    case STAGE_RECEIVE:
+        run_receive_stage(stage);
+        break;
+    case STAGE_IMPAIR:
+        run_impair_stage(stage);
+        break;
+    default:
+        run_transmit_stage(stage);
+        break;
+    }
+
+    evlog_thread_flush();
+    packet_pool_thread_release();
+    return NULL;
+}
+
+// With GRO a single read can return a burst coalesced into one buffer
+static size_t proxy_rx_size(const ProxyConfig *config) {
+    return config->sock.gro ? SOCKOPT_GRO_BUF_SIZE : PACKET_BUF_SIZE;
+}
+
+int proxy_pipeline_init(ProxyContext *proxy) {
+    const ProxyConfig *config = proxy->config;
+
+    for (int d = 0; d < 2; d++) {
+        ProxyPipeline *pipe = &proxy->pipes[d];
+        for (int k = 0; k < PROXY_STAGES; k++) {
+            ProxyStage *stage = &pipe->stages[k];
+            stage->direction = d;
+            stage->kind = k;
+            stage->cpu = config->cpus[d * PROXY_STAGES + k];
+            stage->in = k == STAGE_IMPAIR ? &pipe->to_impair :
+                        k == STAGE_TRANSMIT ? &pipe->to_transmit : NULL;
+            stage->out = k == STAGE_RECEIVE ? &pipe->to_impair :
+                         k == STAGE_IMPAIR ? &pipe->to_transmit : NULL;
+            stage->next = k < STAGE_TRANSMIT ? &pipe->stages[k + 1] : NULL;
+            atomic_init(&stage->sleeping, 0);
+            if (event_loop_init(&stage->loop) < 0) {
+                return -1;
+            }
+            stage->proxy = proxy;  // Marks the loop as initialized
+        }
+
+        if (spsc_ring_init(&pipe->to_impair, PROXY_RING_SIZE, sizeof(StagePacket)) < 0 ||
+            spsc_ring_init(&pipe->to_transmit, PROXY_RING_SIZE, sizeof(StagePacket)) < 0 ||
+            udp_batch_init(&pipe->rx, config->batch, proxy_rx_size(config)) < 0 ||
+            delay_queue_init(&pipe->delayed, config->delay_queue_size) < 0 ||
+            proxy_tx_init(&pipe->tx, d, config->batch) < 0) {
+            return -1;
+        }
+    }
+
+    ProxyStage *c2s_rx = &proxy->pipes[DIR_CLIENT_TO_SERVER].stages[STAGE_RECEIVE];
+    ProxyStage *s2c_rx = &proxy->pipes[DIR_SERVER_TO_CLIENT].stages[STAGE_RECEIVE];
+    if (spsc_ring_init(&proxy->notices, PROXY_NOTICE_RING_SIZE, sizeof(SessionNotice)) < 0 ||
+        spsc_ring_init(&proxy->released, (unsigned)config->max_sessions, sizeof(int)) < 0 ||
+        session_table_init(&proxy->sessions, config->max_sessions, &s2c_rx->loop,
+                           on_server_datagrams_staged, s2c_rx) < 0) {
+        return -1;
+    }
+    proxy->sessions.notices = &proxy->notices;
+    proxy->sessions.released = &proxy->released;
+    proxy->sessions.sock = &config->sock;
+    return event_loop_add(&c2s_rx->loop, &proxy->listen_src, proxy->listen_fd,
+                          on_client_datagrams_staged, c2s_rx, NULL);
+}
+
+// Call once every stage thread has been joined
+void proxy_pipeline_destroy(ProxyContext *proxy) {
+    StagePacket pkt;
+
+    // Upstream sockets closed or opened at shutdown are still owed their notices
+    if (proxy->notices.slots && proxy->pipes[DIR_SERVER_TO_CLIENT].stages[STAGE_RECEIVE].proxy) {
+        apply_session_notices(proxy);
+    }
+    session_table_destroy(&proxy->sessions);
+    spsc_ring_destroy(&proxy->notices);
+    spsc_ring_destroy(&proxy->released);
+
+    for (int d = 0; d < 2; d++) {
+        ProxyPipeline *pipe = &proxy->pipes[d];
+        if (pipe->to_impair.slots) {
+            while (spsc_ring_pop(&pipe->to_impair, &pkt) == 0) packet_free(pkt.buf);
+        }
+        if (pipe->to_transmit.slots) {
+            while (spsc_ring_pop(&pipe->to_transmit, &pkt) == 0) packet_free(pkt.buf);
+        }
+        if (pipe->delayed.size > 0) {
+            log_proxy(proxy->log_fp, "Discarding %d delayed packets", pipe->delayed.size);
+        }
+        spsc_ring_destroy(&pipe->to_impair);
+        spsc_ring_destroy(&pipe->to_transmit);
+        udp_batch_destroy(&pipe->rx);
+        delay_queue_destroy(&pipe->delayed);
+        proxy_tx_destroy(&pipe->tx);
+        for (int k = 0; k < PROXY_STAGES; k++) {
+            if (pipe->stages[k].proxy) {
+                event_loop_destroy(&pipe->stages[k].loop);
+            }
+        }
+    }
+}
+
+static int proxy_inline_init(ProxyContext *proxy) {
+    const ProxyConfig *config = proxy->config;
+
+    if (delay_queue_init(&proxy->delayed, config->delay_queue_size) < 0 ||
+        session_table_init(&proxy->sessions, config->max_sessions, &loop,
+                           on_server_datagrams, proxy) < 0 ||
+        udp_batch_init(&proxy->rx, config->batch, proxy_rx_size(config)) < 0 ||
+        proxy_tx_init(&proxy->tx[DIR_CLIENT_TO_SERVER], DIR_CLIENT_TO_SERVER, config->batch) < 0 ||
+        proxy_tx_init(&proxy->tx[DIR_SERVER_TO_CLIENT], DIR_SERVER_TO_CLIENT, config->batch) < 0) {
+        return -1;
+    }
+    proxy->sessions.sock = &config->sock;
+    return event_loop_add(&loop, &proxy->listen_src, proxy->listen_fd,
+                          on_client_datagrams, proxy, NULL);
+}
+
+static void proxy_context_destroy(ProxyContext *proxy) {
+    if (proxy->config->pipeline) {
+        proxy_pipeline_destroy(proxy);
+        return;
+    }
+    if (proxy->delayed.size > 0) {
+        log_proxy(proxy->log_fp, "Discarding %d delayed packets", proxy->delayed.size);
+    }
+    delay_queue_destroy(&proxy->delayed);
+    session_table_destroy(&proxy->sessions);
+    udp_batch_destroy(&proxy->rx);
+    proxy_tx_destroy(&proxy->tx[DIR_CLIENT_TO_SERVER]);
+    proxy_tx_destroy(&proxy->tx[DIR_SERVER_TO_CLIENT]);
+}
+
+// Held buffers: delayed packets inline; in pipeline mode also everything
+// queued between stages and the pool caches of six threads
+static size_t proxy_pool_size(const ProxyConfig *config) {
+    if (!config->pipeline) {
+        return (size_t)config->delay_queue_size;
+    }
+    return 2 * ((size_t)config->delay_queue_size + 2 * PROXY_RING_SIZE + config->batch) +
+           PROXY_PIPELINE_THREADS * PACKET_CACHE_MAX;
+}
+
+static void run_inline(ProxyContext *proxy) {
+    uint64_t next_sweep_ns = monotonic_ns() + 1000000000ULL;
+
+    while (running) {
+        // Sleep until traffic arrives, a delayed packet is due, or the sweep timer fires
+        uint64_t deadline = next_sweep_ns;
+        DelayedPacket *next = delay_queue_peek(&proxy->delayed);
+        if (next && next->release_ns < deadline) {
+            deadline = next->release_ns;
+        }
+
+        if (event_loop_poll(&loop, deadline) < 0) {
+            log_proxy(proxy->log_fp, "ERROR: event loop failed: %s", strerror(errno));
+            break;
+        }
+
+        release_due_packets(&proxy->delayed, proxy->tx, proxy->log_fp);
+
+        // Everything forwarded this round goes out in one call per direction
+        proxy_tx_flush(&proxy->tx[DIR_CLIENT_TO_SERVER], proxy->log_fp);
+        proxy_tx_flush(&proxy->tx[DIR_SERVER_TO_CLIENT], proxy->log_fp);
+
+        uint64_t now = monotonic_ns();
+        if (now >= next_sweep_ns) {
+            session_evict_idle(&proxy->sessions, now, proxy->idle_ns, proxy->log_fp);
+            next_sweep_ns = now + 1000000000ULL;
+        }
+    }
+}
+
+// Main thread only waits for Ctrl+C, then stops and joins the stages
+static void run_pipeline(ProxyContext *proxy) {
+    int pinned = 0;
+
+    for (int d = 0; d < 2 && running; d++) {
+        for (int k = 0; k < PROXY_STAGES; k++) {
+            ProxyStage *stage = &proxy->pipes[d].stages[k];
+            if (pthread_create(&stage->thread, NULL, stage_main, stage) != 0) {
+                log_proxy(proxy->log_fp, "ERROR: Failed to start pipeline thread");
+                running = 0;
+                break;
+            }
+            stage->started = 1;
+            pinned += stage->cpu != PROXY_CPU_ANY;
+        }
+    }
+    log_proxy(proxy->log_fp, "PIPELINE: %d stage threads, %d pinned", PROXY_PIPELINE_THREADS, pinned);
+
+    while (running) {
+        event_loop_poll(&loop, EVENT_LOOP_NO_DEADLINE);
+    }
+
+    for (int d = 0; d < 2; d++) {
+        for (int k = 0; k < PROXY_STAGES; k++) {
+            event_loop_wakeup(&proxy->pipes[d].stages[k].loop);
+        }
+    }
+    for (int d = 0; d < 2; d++) {
+        for (int k = 0; k < PROXY_STAGES; k++) {
+            if (proxy->pipes[d].stages[k].started) {
+                pthread_join(proxy->pipes[d].stages[k].thread, NULL);
+            }
+        }
+    }
+}
+
+static void log_impairment(FILE *log_fp, const char *label, const ImpairConfig *c) {
+    char burst[96] = "off";
+    char rate[64] = "unlimited";
+
+    if (c->burst_enter > 0) {
+        snprintf(burst, sizeof(burst), "enter %.2f%%/exit %.2f%% (loss %.1f%% / %d%%)",
+                 c->burst_enter, c->burst_exit, c->burst_loss, c->drop);
+    }
+    if (c->rate_kbps > 0) {
+        snprintf(rate, sizeof(rate), "%ldkbit/s (queue %d bytes)", c->rate_kbps, c->queue_bytes);
+    }
+    log_proxy(log_fp, "%s: drop=%d%%, delay=%d%% (%d-%dms), burst=%s, reorder=%d%% (%dms), "
+             "duplicate=%d%%, rate=%s", label, c->drop, c->delay, c->delay_min, c->delay_max,
+             burst, c->reorder, c->reorder_ms, c->duplicate, rate);
+}
+
+int main(int argc, char *argv[]) {
+    ProxyConfig config;
+    FILE *log_fp = NULL;
+
+    if (parse_proxy_args(argc, argv, &config) < 0) {
+        return EXIT_FAILURE;
+    }
+
+    if (config.log_file) {
+        log_fp = log_open_file(config.log_file);
+        if (!log_fp) {
+            fprintf(stderr, "Warning: Could not open log file %s\n", config.log_file);
+        }
+    }
+
+    if (log_init(&config.log) < 0) {
+        fprintf(stderr, "Warning: Could not start log writer, logging synchronously\n");
+    }
+
+    if (!config.seed_set) {
+        config.seed = (uint64_t)time(NULL) ^ ((uint64_t)getpid() << 32) ^ monotonic_ns();
+    }
+
+    log_proxy(log_fp, "PROXY STARTED: listen=%s:%d, target=%s:%d",
+             config.listen_ip, config.listen_port, config.target_ip, config.target_port);
+    log_impairment(log_fp, "CLIENT->SERVER", &config.impair[DIR_CLIENT_TO_SERVER]);
+    log_impairment(log_fp, "SERVER->CLIENT", &config.impair[DIR_SERVER_TO_CLIENT]);
+    log_proxy(log_fp, "SEED: %llu (pass --seed to repeat these impairment decisions)",
+             (unsigned long long)config.seed);
+
+    ProxyContext proxy;
+    memset(&proxy, 0, sizeof(proxy));
+    proxy.config = &config;
+    proxy.log_fp = log_fp;
+    for (int d = 0; d < 2; d++) {
+        impair_init(&proxy.impair[d], &config.impair[d], config.seed, (uint64_t)d);
+    }
+
+    proxy.listen_fd = create_and_bind_udp_socket(config.listen_ip, config.listen_port,
+                                                 &config.sock, log_fp);
+    if (proxy.listen_fd < 0) {
+        log_shutdown();
+        if (log_fp) fclose(log_fp);
+        return EXIT_FAILURE;
+    }
+
+    // Set up target server address
+    proxy.target_addr.sin_family = AF_INET;
+    proxy.target_addr.sin_port = htons(config.target_port);
+    if (inet_pton(AF_INET, config.target_ip, &proxy.target_addr.sin_addr) <= 0) {
+        fprintf(stderr, "Invalid target IP address\n");
+        close(proxy.listen_fd);
+        log_shutdown();
+        if (log_fp) fclose(log_fp);
+        return EXIT_FAILURE;
+    }
+
+    if (event_loop_init(&loop) < 0) {
+        log_proxy(log_fp, "ERROR: Failed to create event loop: %s", strerror(errno));
+        close(proxy.listen_fd);
+        log_shutdown();
+        if (log_fp) fclose(log_fp);
+        return EXIT_FAILURE;
+    }
+
+    if (packet_pool_init(proxy_pool_size(&config)) < 0 ||
+        (config.pipeline ? proxy_pipeline_init(&proxy) : proxy_inline_init(&proxy)) < 0) {
+        log_proxy(log_fp, "ERROR: Failed to allocate proxy state");
+        proxy_context_destroy(&proxy);
+        packet_pool_destroy();
+        event_loop_destroy(&loop);
+        close(proxy.listen_fd);
+        log_shutdown();
+        if (log_fp) fclose(log_fp);
+        return EXIT_FAILURE;
+    }
+
+    metrics_register_all(proxy_metrics, sizeof(proxy_metrics) / sizeof(proxy_metrics[0]));
+    if (metrics_start(&config.metrics, log_fp) < 0) {
+        log_proxy(log_fp, "WARN: Continuing without a metrics endpoint");
+    }
+    if (evlog_open(&config.events, EVLOG_ROLE_PROXY) < 0) {
+        log_proxy(log_fp, "WARN: Could not open event log %s: %s",
+                 config.events.path, strerror(errno));
+    }
+
+    // Installed only once the loop exists, so the handler can wake it
+    signal(SIGINT, sigint_handler);
+
+    // Never evict a session that may still have packets in the delay queue
+    uint64_t max_hold_ns = impair_max_hold_ns(&config.impair[DIR_CLIENT_TO_SERVER]);
+    if (impair_max_hold_ns(&config.impair[DIR_SERVER_TO_CLIENT]) > max_hold_ns) {
+        max_hold_ns = impair_max_hold_ns(&config.impair[DIR_SERVER_TO_CLIENT]);
+    }
+    proxy.idle_ns = (uint64_t)config.session_timeout * 1000000000ULL;
+    if (proxy.idle_ns < max_hold_ns + 1000000000ULL) {
+        proxy.idle_ns = max_hold_ns + 1000000000ULL;
+    }
+
+    printf("Proxy running on %s:%d -> %s:%d\n",
+           config.listen_ip, config.listen_port,
+           config.target_ip, config.target_port);
+    printf("Press Ctrl+C to stop\n\n");
+
+    if (config.pipeline) {
+        run_pipeline(&proxy);
+    } else {
+        run_inline(&proxy);
+    }
+
+    metrics_stop();
+    proxy_context_destroy(&proxy);
+    evlog_close();
+    event_loop_destroy(&loop);
+
+    PacketPoolStats pool;
+    packet_pool_stats(&pool);
+    log_proxy(log_fp, "PACKET POOL: high_water=%zu of %zu buffers, exhausted=%llu",
+             pool.high_water, pool.max_buffers, pool.exhausted);
+    packet_pool_destroy();
 
     log_proxy(log_fp, "PROXY SHUTDOWN");
-    close(sockfd);
+    close(proxy.listen_fd);
+    log_shutdown();
     if (log_fp) fclose(log_fp);
 
     return EXIT_SUCCESS;
@@ -4,28 +4,179 @@
 #include <stdio.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "addr_table.h"
+#include "batch_io.h"
+#include "delay_queue.h"
+#include "spsc_ring.h"
+#include "event_loop.h"
+#include "log.h"
+#include "metrics.h"
+#include "evlog.h"
+#include "impair.h"
+#include "sockopt.h"
+
+#define PROXY_PIPELINE_THREADS 6       // Receive, impair and transmit for each direction
 
 typedef struct {
     char *listen_ip;
     int listen_port;
     char *target_ip;
     int target_port;
-    int client_drop;           // Drop percentage for client->server
-    int server_drop;           // Drop percentage for server->client
-    int client_delay;          // Delay percentage for client->server
-    int server_delay;          // Delay percentage for server->client
-    int client_delay_min;      // Min delay in ms
-    int client_delay_max;      // Max delay in ms
-    int server_delay_min;      // Min delay in ms
-    int server_delay_max;      // Max delay in ms
+    ImpairConfig impair[2];    // --client-* and --server-* impairments, indexed by direction
+    uint64_t seed;             // Seeds every impairment decision; logged so a run can be repeated
+    int seed_set;
+    int delay_queue_size;      // Max packets held for delayed release
+    int max_sessions;          // Max concurrent clients
+    int session_timeout;       // Idle seconds before a session is evicted
+    int batch;                 // Max datagrams per recvmmsg()/sendmmsg()
+    int pipeline;              // Receive, impair and transmit on separate threads per direction
+    int verify_crc;            // Drop frames whose CRC32C trailer does not match before impairing
+    int cpus[PROXY_PIPELINE_THREADS];  // --pin-cpus, in stage order; PROXY_CPU_ANY where unset
+    int cpu_count;             // Entries given to --pin-cpus, -1 if the list was malformed
+    SocketConfig sock;         // Applied to the listen socket and every upstream socket
     char *log_file;
+    LogConfig log;
+    MetricsConfig metrics;
+    EventLogConfig events;
 } ProxyConfig;
 
+// Forwarding direction
+enum {
+    DIR_CLIENT_TO_SERVER = 0,
+    DIR_SERVER_TO_CLIENT = 1
+};
+
+// Pipeline stages of one direction, in the order packets pass through them
+enum {
+    STAGE_RECEIVE = 0,
+    STAGE_IMPAIR = 1,
+    STAGE_TRANSMIT = 2,
+    PROXY_STAGES = 3
+};
+
+#define PROXY_CPU_ANY -1
+#define PROXY_RING_SIZE 1024           // Packets queued between two stages
+#define PROXY_NOTICE_RING_SIZE 256     // Session opens/closes awaiting the S->C receive thread
+#define PROXY_STAGE_SPIN 2000          // Empty polls of the input queue before a stage sleeps
+
+// Per-client state: each client gets its own upstream socket, so replies
+// from the server arrive on a socket that already identifies the client
+typedef struct {
+    int in_use;
+    int upstream_fd;
+    struct sockaddr_in client_addr;
+    socklen_t client_len;
+    _Atomic uint64_t last_active_ns;  // Written by both receive threads in pipeline mode
+    uint32_t rx_overflow;     // Kernel drop count last reported for upstream_fd
+    EventSource src;          // Registration of upstream_fd
+} ProxySession;
+
+// Pipeline mode: only the S->C receive thread touches the loop that watches
+// upstream sockets, so the session owner asks it to (un)register them. A
+// closed slot is reused only once that thread hands it back, since until
+// then it may still be forwarding replies to the slot's client_addr.
+typedef struct {
+    int open;                 // 1: register session, 0: unregister and close fd
+    int fd;
+    ProxySession *session;
+} SessionNotice;
+
+typedef struct {
+    ProxySession *sessions;
+    int *free_list;
+    int free_count;
+    int capacity;
+    AddrTable index;          // Client address -> sessions[] slot
+    EventLoop *loop;          // New upstream sockets are registered here
+    EventHandler on_readable;
+    void *ctx;
+    SpscRing *notices;        // Pipeline mode: requests for loop's thread instead
+    SpscRing *released;       // Pipeline mode: closed slots loop's thread is done with
+    const SocketConfig *sock; // Tuning for new upstream sockets
+} SessionTable;
+
+// Outgoing datagrams for one direction. Packets for different sockets
+// share the batch; a flush sends each socket's with one sendmmsg().
+typedef struct {
+    int direction;
+    int fds[UDP_BATCH_MAX];   // Socket each queued packet goes out on
+    UdpBatch batch;
+} ProxyTx;
+
+// A packet in flight between two pipeline stages, copied through the rings by value
+typedef struct {
+    PacketBuf *buf;           // Owned by whichever stage holds the record
+    int fd;                   // Socket to forward on
+    struct sockaddr_in dest;
+    socklen_t dest_len;
+} StagePacket;
+
+struct ProxyContext;
+
+// One thread of a pipeline. Stages with an input ring sleep on their loop's
+// wake pipe once it runs dry; the producer wakes them only while asleep.
+typedef struct ProxyStage {
+    int direction;
+    int kind;                 // STAGE_RECEIVE, STAGE_IMPAIR or STAGE_TRANSMIT
+    int cpu;                  // PROXY_CPU_ANY to let the scheduler place the thread
+    EventLoop loop;           // Sockets for receive stages; only the wake pipe otherwise
+    SpscRing *in;             // NULL for receive stages
+    SpscRing *out;            // NULL for transmit stages
+    struct ProxyStage *next;  // Consumer of out
+    _Atomic int sleeping;
+    struct ProxyContext *proxy;
+    pthread_t thread;
+    int started;
+} ProxyStage;
+
+// Stages, queues and per-stage state for one direction
+typedef struct {
+    ProxyStage stages[PROXY_STAGES];
+    SpscRing to_impair;
+    SpscRing to_transmit;
+    UdpBatch rx;              // Receive stage
+    DelayQueue delayed;       // Impair stage
+    ProxyTx tx;               // Transmit stage
+} ProxyPipeline;
+
+// Everything the proxy's event handlers share
+typedef struct ProxyContext {
+    const ProxyConfig *config;
+    int listen_fd;
+    uint32_t listen_overflow; // Kernel drop count last reported for listen_fd
+    struct sockaddr_in target_addr;
+    SessionTable sessions;
+    DelayQueue delayed;
+    UdpBatch rx;
+    ProxyTx tx[2];            // Indexed by direction
+    EventSource listen_src;
+    ProxyPipeline pipes[2];   // Pipeline mode only, indexed by direction
+    SpscRing notices;
+    SpscRing released;        // Slot indexes, S->C receive thread to C->S
+    Impairment impair[2];     // Owned by the impair stage, or the main loop inline
+    uint64_t idle_ns;         // Sessions quiet this long are evicted
+    FILE *log_fp;
+} ProxyContext;
+
 // Function prototypes
 int parse_proxy_args(int argc, char *argv[], ProxyConfig *config);
-int create_and_bind_udp_socket(const char *ip, int port);
-int should_drop(int drop_percentage);
-int get_delay_ms(int delay_percentage, int min_ms, int max_ms);
+int create_and_bind_udp_socket(const char *ip, int port, const SocketConfig *sock, FILE *log_fp);
+int session_table_init(SessionTable *table, int capacity, EventLoop *loop,
+                       EventHandler on_readable, void *ctx);
+void session_table_destroy(SessionTable *table);
+ProxySession *session_lookup_or_create(SessionTable *table, const struct sockaddr_in *client_addr,
+                                       socklen_t client_len, FILE *log_fp);
+void session_evict_idle(SessionTable *table, uint64_t now_ns, uint64_t idle_ns, FILE *log_fp);
+int proxy_pipeline_init(ProxyContext *proxy);
+void proxy_pipeline_destroy(ProxyContext *proxy);
+int proxy_tx_init(ProxyTx *tx, int direction, int batch_size);
+void proxy_tx_destroy(ProxyTx *tx);
+void proxy_tx_flush(ProxyTx *tx, FILE *log_fp);
+void forward_packet(ProxyTx *tx, int sockfd, const uint8_t *data, size_t len,
+                    const struct sockaddr_in *dest, socklen_t dest_len, FILE *log_fp);
 void log_proxy(FILE *log_fp, const char *format, ...);
 
 #endif //COMP7005PROJ1_PROXY_H
\ No newline at end of file
@@ -0,0 +1,155 @@
+#include "reassembly.h"
+#include "event_loop.h"
+#include <stdlib.h>
+#include <string.h>
+
+int reassembly_init(ReassemblyTable *t, int capacity, int timeout_sec) {
+    memset(t, 0, sizeof(*t));
+    if (capacity <= 0 || timeout_sec <= 0) {
+        return -1;
+    }
+
+    t->slots = calloc((size_t)capacity, sizeof(Reassembly));
+    t->arena = malloc((size_t)capacity * MAX_RECORD_SIZE);
+    if (!t->slots || !t->arena) {
+        reassembly_destroy(t);
+        return -1;
+    }
+
+    for (int i = 0; i < capacity; i++) {
+        t->slots[i].data = t->arena + (size_t)i * MAX_RECORD_SIZE;
+    }
+    t->capacity = capacity;
+    t->timeout_ns = (uint64_t)timeout_sec * 1000000000ULL;
+    return 0;
+}
+
+void reassembly_destroy(ReassemblyTable *t) {
+    free(t->slots);
+    free(t->arena);
+    memset(t, 0, sizeof(*t));
+}
+
+static int same_sender(const struct sockaddr_in *a, const struct sockaddr_in *b) {
+    return a->sin_addr.s_addr == b->sin_addr.s_addr && a->sin_port == b->sin_port;
+}
+
+static const CompletedRecord *find_recent(const ReassemblyTable *t,
+                                          const struct sockaddr_in *addr, uint32_t msg_id) {
+    for (int i = 0; i < REASSEMBLY_RECENT; i++) {
+        const CompletedRecord *c = &t->recent[i];
+        if (c->msg_id == msg_id && c->ip == addr->sin_addr.s_addr && c->port == addr->sin_port) {
+            return c;
+        }
+    }
+    return NULL;
+}
+
+static void remember(ReassemblyTable *t, const Reassembly *r, int dropped) {
+    CompletedRecord *c = &t->recent[t->recent_next++ % REASSEMBLY_RECENT];
+    c->ip = r->addr.sin_addr.s_addr;
+    c->port = r->addr.sin_port;
+    c->msg_id = r->msg_id;
+    c->dropped = dropped;
+}
+
+FragResult reassembly_add(ReassemblyTable *t, const struct sockaddr_in *addr, uint32_t seq_num,
+                          const FragmentView *frag, size_t stride, uint64_t now_ns,
+                          Reassembly **record) {
+    Reassembly *r = NULL;
+    Reassembly *free_slot = NULL;
+
+    for (int i = 0; i < t->capacity; i++) {
+        Reassembly *s = &t->slots[i];
+        if (!s->in_use) {
+            if (!free_slot) free_slot = s;
+        } else if (s->msg_id == frag->msg_id && same_sender(&s->addr, addr)) {
+            r = s;
+            break;
+        }
+    }
+
+    if (!r) {
+        const CompletedRecord *done = find_recent(t, addr, frag->msg_id);
+        if (done) {
+            return done->dropped ? FRAG_EXPIRED : FRAG_DUPLICATE;
+        }
+        if (!free_slot) {
+            return FRAG_NO_SPACE;
+        }
+
+        r = free_slot;
+        r->in_use = 1;
+        r->addr = *addr;
+        r->msg_id = frag->msg_id;
+        r->first_seq = seq_num - frag->index;
+        r->count = frag->count;
+        r->stride = stride;
+        r->received = 0;
+        r->len = 0;
+        memset(r->have, 0, sizeof(r->have));
+    }
+
+    size_t offset = (size_t)frag->index * stride;
+    if (frag->count != r->count || stride != r->stride || seq_num - frag->index != r->first_seq ||
+        offset + frag->len > MAX_RECORD_SIZE) {
+        if (r->received == 0) r->in_use = 0;
+        return FRAG_INVALID;
+    }
+
+    uint64_t bit = (uint64_t)1 << (frag->index % 64);
+    if (r->have[frag->index / 64] & bit) {
+        return FRAG_DUPLICATE;
+    }
+
+    memcpy(r->data + offset, frag->data, frag->len);
+    r->have[frag->index / 64] |= bit;
+    r->received++;
+    r->last_ns = now_ns;
+    if (frag->index + 1 == frag->count) {
+        r->len = offset + frag->len;
+    }
+
+    if (r->received < r->count) {
+        return FRAG_STORED;
+    }
+
+    // Remember it so retransmissions after a lost ACK are not reassembled again
+    remember(t, r, 0);
+
+    *record = r;
+    return FRAG_COMPLETE;
+}
+
+void reassembly_release(ReassemblyTable *t, Reassembly *r) {
+    (void)t;
+    r->in_use = 0;
+}
+
+// Returns one stalled record at a time; the caller logs and releases it
+Reassembly *reassembly_next_expired(ReassemblyTable *t, uint64_t now_ns) {
+    for (int i = 0; i < t->capacity; i++) {
+        Reassembly *r = &t->slots[i];
+        if (r->in_use && now_ns - r->last_ns >= t->timeout_ns) {
+            return r;
+        }
+    }
+    return NULL;
+}
+
+// Frees a stalled record; its late fragments are discarded rather than restarted
+void reassembly_drop(ReassemblyTable *t, Reassembly *r) {
+    remember(t, r, 1);
+    r->in_use = 0;
+}
+
+uint64_t reassembly_next_deadline(const ReassemblyTable *t) {
+    uint64_t deadline = EVENT_LOOP_NO_DEADLINE;
+    for (int i = 0; i < t->capacity; i++) {
+        const Reassembly *r = &t->slots[i];
+        if (r->in_use && r->last_ns + t->timeout_ns < deadline) {
+            deadline = r->last_ns + t->timeout_ns;
+        }
+    }
+    return deadline;
+}
@@ -0,0 +1,66 @@
+#ifndef COMP7005PROJ1_REASSEMBLY_H
+#define COMP7005PROJ1_REASSEMBLY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <netinet/in.h>
+#include "protocol.h"
+
+#define REASSEMBLY_DEFAULT_SLOTS 64
+#define REASSEMBLY_DEFAULT_TIMEOUT 60  // Seconds without progress before a record is dropped
+#define REASSEMBLY_RECENT 256          // Finished records remembered to classify late fragments
+#define REASSEMBLY_BITMAP_WORDS ((MAX_FRAGMENTS + 63) / 64)
+
+// One record being put back together
+typedef struct {
+    int in_use;
+    struct sockaddr_in addr;
+    uint32_t msg_id;
+    uint32_t first_seq;       // seq_num of fragment 0
+    uint16_t count;
+    uint16_t received;
+    size_t stride;            // Data in every fragment but the last
+    size_t len;               // Known once the last fragment has arrived
+    uint64_t have[REASSEMBLY_BITMAP_WORDS];
+    uint64_t last_ns;         // Monotonic time of the last new fragment
+    uint8_t *data;            // MAX_RECORD_SIZE bytes carved from the table's arena
+} Reassembly;
+
+typedef struct {
+    uint32_t ip;
+    uint16_t port;
+    uint32_t msg_id;
+    int dropped;              // Timed out rather than delivered
+} CompletedRecord;
+
+// Fixed set of reassembly slots; memory is capacity * MAX_RECORD_SIZE, allocated once
+typedef struct {
+    Reassembly *slots;
+    uint8_t *arena;
+    int capacity;
+    uint64_t timeout_ns;
+    CompletedRecord recent[REASSEMBLY_RECENT];
+    unsigned recent_next;
+} ReassemblyTable;
+
+typedef enum {
+    FRAG_STORED,              // New fragment kept, record still incomplete
+    FRAG_COMPLETE,            // Record finished; deliver it, then reassembly_release()
+    FRAG_DUPLICATE,           // Already have it (or the whole record)
+    FRAG_NO_SPACE,            // Every slot busy; leave unacknowledged so it is resent
+    FRAG_EXPIRED,             // Record already timed out; acknowledge so the sender moves on
+    FRAG_INVALID              // Inconsistent with earlier fragments of the record
+} FragResult;
+
+// Function prototypes
+int reassembly_init(ReassemblyTable *t, int capacity, int timeout_sec);
+void reassembly_destroy(ReassemblyTable *t);
+FragResult reassembly_add(ReassemblyTable *t, const struct sockaddr_in *addr, uint32_t seq_num,
+                          const FragmentView *frag, size_t stride, uint64_t now_ns,
+                          Reassembly **record);
+void reassembly_release(ReassemblyTable *t, Reassembly *r);
+Reassembly *reassembly_next_expired(ReassemblyTable *t, uint64_t now_ns);
+void reassembly_drop(ReassemblyTable *t, Reassembly *r);
+uint64_t reassembly_next_deadline(const ReassemblyTable *t);
+
+#endif //COMP7005PROJ1_REASSEMBLY_H
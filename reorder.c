@@ -0,0 +1,151 @@
+#include "reorder.h"
+#include "event_loop.h"
+#include <stdlib.h>
+#include <string.h>
+
+int reorder_pool_init(ReorderPool *pool, int max_buffers) {
+    memset(pool, 0, sizeof(*pool));
+    if (max_buffers <= 0) {
+        return -1;
+    }
+
+    pool->tables = calloc((size_t)max_buffers * REORDER_WINDOW, sizeof(PacketBuf *));
+    pool->free = malloc((size_t)max_buffers * sizeof(PacketBuf **));
+    if (!pool->tables || !pool->free) {
+        reorder_pool_destroy(pool);
+        return -1;
+    }
+
+    for (int i = 0; i < max_buffers; i++) {
+        pool->free[i] = pool->tables + (size_t)(max_buffers - 1 - i) * REORDER_WINDOW;
+    }
+    pool->free_count = max_buffers;
+    pool->max_buffers = max_buffers;
+    return 0;
+}
+
+// Tables still lent to clients must be returned with reorder_reset() first
+void reorder_pool_destroy(ReorderPool *pool) {
+    free(pool->tables);
+    free(pool->free);
+    memset(pool, 0, sizeof(*pool));
+}
+
+static void release_slots(ReorderBuffer *rb, ReorderPool *pool) {
+    if (rb->slots) {
+        pool->free[pool->free_count++] = rb->slots;
+        rb->slots = NULL;
+    }
+}
+
+void reorder_reset(ReorderBuffer *rb, ReorderPool *pool) {
+    for (uint32_t i = 0; i < REORDER_WINDOW; i++) {
+        if ((rb->buffered >> i) & 1) {
+            packet_free(rb->slots[(rb->next_seq + i) % REORDER_WINDOW]);
+        }
+    }
+    release_slots(rb, pool);
+    memset(rb, 0, sizeof(*rb));
+}
+
+// Moves next_seq up by one, delivering the head frame if it was held
+static void step(ReorderBuffer *rb, ReorderDeliverFn deliver, void *ctx) {
+    if (rb->buffered & 1) {
+        PacketBuf *held = rb->slots[rb->next_seq % REORDER_WINDOW];
+        deliver(ctx, held->data, held->len);
+        packet_free(held);
+    } else {
+        rb->skipped++;
+    }
+    rb->buffered >>= 1;
+    rb->next_seq++;
+}
+
+static void drain(ReorderBuffer *rb, ReorderPool *pool, ReorderDeliverFn deliver, void *ctx) {
+    while (rb->buffered & 1) {
+        step(rb, deliver, ctx);
+    }
+    if (!rb->buffered) {
+        release_slots(rb, pool);
+    }
+}
+
+ReorderResult reorder_accept(ReorderBuffer *rb, ReorderPool *pool, uint32_t seq_num,
+                             const uint8_t *frame, size_t len, uint64_t now_ns,
+                             ReorderDeliverFn deliver, void *ctx) {
+    if (!rb->started) {
+        // State was evicted or never seen this sender's start; pick up from here,
+        // wherever in the sequence space that is
+        rb->next_seq = seq_num;
+    } else if (seq_before(seq_num, rb->next_seq)) {
+        return REORDER_DUPLICATE;
+    } else if (seq_num - rb->next_seq >= REORDER_WINDOW) {
+        // A sender never has more than MAX_WINDOW seqs in flight, so it has
+        // already given up on everything this far behind the new arrival
+        uint32_t target = seq_num - REORDER_WINDOW + 1;
+        if (seq_num - rb->next_seq >= 2 * REORDER_WINDOW) {
+            // Far ahead: everything held falls below target, so release it in
+            // one pass and count the rest as skipped instead of stepping to it
+            while (rb->buffered) {
+                step(rb, deliver, ctx);
+            }
+            rb->skipped += target - rb->next_seq;
+            rb->next_seq = target;
+        }
+        while (seq_num - rb->next_seq >= REORDER_WINDOW) {
+            step(rb, deliver, ctx);
+        }
+        drain(rb, pool, deliver, ctx);
+        rb->progress_ns = now_ns;
+    }
+    rb->started = 1;
+
+    uint32_t offset = seq_num - rb->next_seq;
+    uint64_t bit = (uint64_t)1 << offset;
+    if (rb->buffered & bit) {
+        return REORDER_DUPLICATE;
+    }
+
+    if (offset == 0) {
+        // Fast path: in-order frames are delivered straight from the receive buffer
+        deliver(ctx, frame, len);
+        rb->buffered >>= 1;
+        rb->next_seq++;
+        rb->progress_ns = now_ns;
+        drain(rb, pool, deliver, ctx);
+        return REORDER_DELIVERED;
+    }
+
+    if (len > PACKET_BUF_SIZE || (!rb->slots && pool->free_count == 0)) {
+        return REORDER_NO_SPACE;
+    }
+    PacketBuf *held = packet_alloc();
+    if (!held) {
+        return REORDER_NO_SPACE;
+    }
+    if (!rb->slots) {
+        rb->slots = pool->free[--pool->free_count];
+        rb->progress_ns = now_ns;
+    }
+
+    memcpy(held->data, frame, len);
+    held->len = len;
+    rb->slots[seq_num % REORDER_WINDOW] = held;
+    rb->buffered |= bit;
+    return REORDER_BUFFERED;
+}
+
+uint64_t reorder_deadline(const ReorderBuffer *rb, uint64_t timeout_ns) {
+    if (!rb->buffered) {
+        return EVENT_LOOP_NO_DEADLINE;
+    }
+    return rb->progress_ns + timeout_ns;
+}
+
+// The sender has gone quiet with gaps still open: release what is held, skipping the holes
+void reorder_flush(ReorderBuffer *rb, ReorderPool *pool, ReorderDeliverFn deliver, void *ctx) {
+    while (rb->buffered) {
+        step(rb, deliver, ctx);
+    }
+    release_slots(rb, pool);
+}
@@ -0,0 +1,53 @@
+#ifndef COMP7005PROJ1_REORDER_H
+#define COMP7005PROJ1_REORDER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "protocol.h"
+#include "packet_pool.h"
+
+#define REORDER_WINDOW MAX_WINDOW        // Sequence numbers held ahead of the next one due
+#define REORDER_DEFAULT_BUFFERS 256      // Clients with a gap open at once, per worker
+#define REORDER_DEFAULT_TIMEOUT 60       // Seconds a gap may stall delivery before it is skipped
+
+// Per-client receive window. In-order traffic holds nothing; a slot table
+// is borrowed from the pool only while a gap is open, and each held frame
+// sits whole in a packet buffer until its turn comes.
+typedef struct {
+    uint32_t next_seq;        // Next seq to deliver; everything below it is done
+    uint64_t buffered;        // Bit i set => next_seq + i is held in slots
+    PacketBuf **slots;        // Indexed by seq % REORDER_WINDOW, NULL when no gap
+    uint64_t progress_ns;     // Last time the head gap moved
+    uint64_t skipped;         // Seqs the sender gave up on, never delivered
+    int started;              // Anything delivered or buffered yet
+} ReorderBuffer;
+
+// Slot tables for max_buffers clients with an open gap, allocated up front
+typedef struct {
+    PacketBuf **tables;       // max_buffers * REORDER_WINDOW slots in one block
+    PacketBuf ***free;        // Unused tables
+    int free_count;
+    int max_buffers;
+} ReorderPool;
+
+typedef enum {
+    REORDER_DELIVERED,        // Released in order, with anything it unblocked
+    REORDER_BUFFERED,         // Held until the gap before it fills
+    REORDER_DUPLICATE,        // Already delivered or held; acknowledge again only
+    REORDER_NO_SPACE          // No slot table or packet buffer; leave unacknowledged so it is resent
+} ReorderResult;
+
+// Called once per frame, in sequence order
+typedef void (*ReorderDeliverFn)(void *ctx, const uint8_t *frame, size_t len);
+
+// Function prototypes
+int reorder_pool_init(ReorderPool *pool, int max_buffers);
+void reorder_pool_destroy(ReorderPool *pool);
+void reorder_reset(ReorderBuffer *rb, ReorderPool *pool);
+ReorderResult reorder_accept(ReorderBuffer *rb, ReorderPool *pool, uint32_t seq_num,
+                             const uint8_t *frame, size_t len, uint64_t now_ns,
+                             ReorderDeliverFn deliver, void *ctx);
+uint64_t reorder_deadline(const ReorderBuffer *rb, uint64_t timeout_ns);
+void reorder_flush(ReorderBuffer *rb, ReorderPool *pool, ReorderDeliverFn deliver, void *ctx);
+
+#endif //COMP7005PROJ1_REORDER_H
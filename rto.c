@@ -0,0 +1,39 @@
+#include "rto.h"
+
+double rto_clamp(const RtoEstimator *est, double rto) {
+    if (rto < est->min_rto) return est->min_rto;
+    if (rto > est->max_rto) return est->max_rto;
+    return rto;
+}
+
+// --timeout is only the starting point; it is replaced by the first RTT sample
+void rto_init(RtoEstimator *est, double initial, double min_rto, double max_rto) {
+    est->srtt = 0.0;
+    est->rttvar = 0.0;
+    est->min_rto = min_rto;
+    est->max_rto = max_rto;
+    est->rto = initial;
+    est->have_sample = 0;
+}
+
+// Callers must only feed samples from messages that were sent exactly once
+// (Karn's algorithm), since an ACK for a retransmission is ambiguous.
+void rto_sample(RtoEstimator *est, double rtt) {
+    if (!est->have_sample) {
+        est->srtt = rtt;
+        est->rttvar = rtt / 2.0;
+        est->have_sample = 1;
+    } else {
+        double err = est->srtt - rtt;
+        if (err < 0) err = -err;
+        est->rttvar = 0.75 * est->rttvar + 0.25 * err;
+        est->srtt = 0.875 * est->srtt + 0.125 * rtt;
+    }
+
+    // A fresh sample also clears any exponential backoff
+    est->rto = rto_clamp(est, est->srtt + 4.0 * est->rttvar);
+}
+
+void rto_backoff(RtoEstimator *est) {
+    est->rto = rto_clamp(est, est->rto * 2.0);
+}
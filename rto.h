@@ -0,0 +1,20 @@
+#ifndef COMP7005PROJ1_RTO_H
+#define COMP7005PROJ1_RTO_H
+
+// Jacobson/Karn retransmission timeout estimator (RFC 6298)
+typedef struct {
+    double srtt;
+    double rttvar;
+    double rto;
+    double min_rto;
+    double max_rto;
+    int have_sample;
+} RtoEstimator;
+
+// Function prototypes
+void rto_init(RtoEstimator *est, double initial, double min_rto, double max_rto);
+void rto_sample(RtoEstimator *est, double rtt);
+void rto_backoff(RtoEstimator *est);
+double rto_clamp(const RtoEstimator *est, double rto);
+
+#endif //COMP7005PROJ1_RTO_H
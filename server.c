@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include "server.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -8,44 +9,89 @@
 #include <time.h>
 #include <errno.h>
 #include <signal.h>
-#include <sys/select.h>
 
 
 static volatile int running = 1;
+static ServerState *workers;
+static int worker_count;
+
+// Shared by every worker; see metrics.h
+static Metric m_datagrams = METRIC_COUNTER_INIT("server_datagrams_received_total",
+                                                "Datagrams read from the socket");
+static Metric m_bytes = METRIC_COUNTER_INIT("server_bytes_received_total",
+                                            "Bytes read from the socket");
+static Metric m_invalid = METRIC_COUNTER_INIT("server_datagrams_invalid_total",
+                                              "Datagrams rejected as malformed or unexpected");
+static Metric m_bad_checksum = METRIC_COUNTER_INIT("server_checksum_failures_total",
+                                                   "Datagrams dropped because their CRC32C did not match");
+static Metric m_rx_overflow = METRIC_COUNTER_INIT("server_socket_overflow_drops_total",
+                                                  "Datagrams the kernel dropped on a full receive buffer");
+static Metric m_acks = METRIC_COUNTER_INIT("server_acks_sent_total",
+                                           "ACK and SACK frames handed to the kernel");
+static Metric m_delivered = METRIC_COUNTER_INIT("server_messages_delivered_total",
+                                                "Messages written to the output in sequence order");
+static Metric m_duplicates = METRIC_COUNTER_INIT("server_duplicates_total",
+                                                 "Retransmissions of messages already accepted");
+static Metric m_skipped = METRIC_COUNTER_INIT("server_gap_seqs_skipped_total",
+                                              "Sequence numbers given up on by their senders");
+static Metric m_reorder_held = METRIC_GAUGE_INIT("server_reorder_held",
+                                                 "Out-of-order messages held back, all clients");
+static Metric m_reorder_full = METRIC_COUNTER_INIT("server_reorder_no_space_total",
+                                                   "Messages left unacknowledged for lack of reorder buffers");
+static Metric m_clients = METRIC_GAUGE_INIT("server_clients_active", "Clients with live state");
+static Metric m_clients_rejected = METRIC_COUNTER_INIT("server_clients_rejected_total",
+                                                       "Packets ignored because the client table was full");
+static Metric m_clients_evicted = METRIC_COUNTER_INIT("server_clients_evicted_total",
+                                                      "Clients dropped after going idle");
+static Metric m_sessions = METRIC_COUNTER_INIT("server_sessions_opened_total",
+                                                "Sessions started by a client SYN");
+static Metric m_resumed = METRIC_COUNTER_INIT("server_sessions_resumed_total",
+                                              "SYNs that picked up an existing session");
+static Metric m_reassembled = METRIC_COUNTER_INIT("server_records_reassembled_total",
+                                                  "Fragmented records completed");
+static Metric m_reassembly_timeouts = METRIC_COUNTER_INIT("server_reassembly_timeouts_total",
+                                                          "Partial records dropped after stalling");
+
+static Metric *const server_metrics[] = {
+    &m_datagrams, &m_bytes, &m_invalid, &m_bad_checksum, &m_rx_overflow,
+    &m_acks, &m_delivered, &m_duplicates, &m_skipped,
+    &m_reorder_held, &m_reorder_full, &m_clients, &m_clients_rejected, &m_clients_evicted,
+    &m_sessions, &m_resumed, &m_reassembled, &m_reassembly_timeouts
+};
 
 void sigint_handler(int sig) {
     (void)sig;
     running = 0;
+    for (int i = 0; i < worker_count; i++) {
+        event_loop_wakeup(&workers[i].loop);
+    }
 }
 
 void log_server(FILE *log_fp, const char *format, ...) {
     va_list args;
-    time_t now = time(NULL);
-    char timestamp[64];
-    strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", localtime(&now));
-
-    // Print to stderr
-    fprintf(stderr, "[%s] ", timestamp);
     va_start(args, format);
-    vfprintf(stderr, format, args);
+    log_vwrite(LOG_LEVEL_INFO, log_fp, format, args);
     va_end(args);
-    fprintf(stderr, "\n");
-
-    // Print to log file if provided
-    if (log_fp) {
-        fprintf(log_fp, "[%s] ", timestamp);
-        va_start(args, format);
-        vfprintf(log_fp, format, args);
-        va_end(args);
-        fprintf(log_fp, "\n");
-        fflush(log_fp);
-    }
 }
 
 int parse_server_args(int argc, char *argv[], ServerConfig *config) {
     config->listen_ip = NULL;
     config->listen_port = 0;
     config->log_file = NULL;
+    log_config_default(&config->log);
+    metrics_config_default(&config->metrics);
+    evlog_config_default(&config->events);
+    config->sack = 0;
+    config->batch = UDP_BATCH_DEFAULT;
+    config->workers = 1;
+    config->reassembly_slots = REASSEMBLY_DEFAULT_SLOTS;
+    config->reassembly_timeout = REASSEMBLY_DEFAULT_TIMEOUT;
+    config->reorder_buffers = REORDER_DEFAULT_BUFFERS;
+    config->reorder_timeout = REORDER_DEFAULT_TIMEOUT;
+    config->max_clients = SERVER_DEFAULT_MAX_CLIENTS;
+    config->client_timeout = SERVER_DEFAULT_CLIENT_TIMEOUT;
+    sockopt_config_default(&config->sock);
+    sink_config_default(&config->output);
 
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "--listen-ip") == 0 && i + 1 < argc) {
@@ -54,18 +100,58 @@ int parse_server_args(int argc, char *argv[], ServerConfig *config) {
             config->listen_port = atoi(argv[++i]);
         } else if (strcmp(argv[i], "--log-file") == 0 && i + 1 < argc) {
             config->log_file = argv[++i];
+        } else if (strcmp(argv[i], "--sack") == 0) {
+            config->sack = 1;
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            config->batch = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            config->workers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--reassembly-slots") == 0 && i + 1 < argc) {
+            config->reassembly_slots = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--reassembly-timeout") == 0 && i + 1 < argc) {
+            config->reassembly_timeout = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--reorder-buffers") == 0 && i + 1 < argc) {
+            config->reorder_buffers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--reorder-timeout") == 0 && i + 1 < argc) {
+            config->reorder_timeout = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--max-clients") == 0 && i + 1 < argc) {
+            config->max_clients = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--client-timeout") == 0 && i + 1 < argc) {
+            config->client_timeout = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--gro") == 0) {
+            config->sock.gro = 1;
+        } else if (!sockopt_parse_arg(argc, argv, &i, &config->sock) &&
+                   !sink_parse_arg(argc, argv, &i, &config->output) &&
+                   !log_parse_arg(argc, argv, &i, &config->log) &&
+                   !metrics_parse_arg(argc, argv, &i, &config->metrics)) {
+            evlog_parse_arg(argc, argv, &i, &config->events);
         }
     }
 
-    if (!config->listen_ip || config->listen_port == 0) {
-        fprintf(stderr, "Usage: %s --listen-ip <ip> --listen-port <port> [--log-file <file>]\n", argv[0]);
+    if (!config->listen_ip || config->listen_port == 0 ||
+        config->batch < 1 || config->batch > UDP_BATCH_MAX ||
+        config->workers < 1 || config->workers > MAX_WORKERS ||
+        config->reassembly_slots < 1 || config->reassembly_timeout < 1 ||
+        config->reorder_buffers < 1 || config->reorder_timeout < 1 ||
+        config->max_clients < 1 || config->client_timeout < 1 ||
+        !sockopt_config_valid(&config->sock) || !sink_config_valid(&config->output) ||
+        !log_config_valid(&config->log) || !metrics_config_valid(&config->metrics)) {
+        fprintf(stderr, "Usage: %s --listen-ip <ip> --listen-port <port> [--log-file <file>] "
+                       "[--sack] [--batch <1-%d>] [--workers <1-%d>] "
+                       "[--reassembly-slots <n>] [--reassembly-timeout <sec>] "
+                       "[--reorder-buffers <n>] [--reorder-timeout <sec>] "
+                       "[--max-clients <n>] [--client-timeout <sec>] [--gro] "
+                       SOCKOPT_USAGE " " SINK_USAGE " " LOG_USAGE " "
+                       METRICS_USAGE " " EVLOG_USAGE "\n",
+                argv[0], UDP_BATCH_MAX, MAX_WORKERS);
         return -1;
     }
 
     return 0;
 }
 
-int create_and_bind_udp_socket(const char *ip, int port) {
+int create_and_bind_udp_socket(const char *ip, int port, int reuse_port,
+                               const SocketConfig *sock, FILE *log_fp) {
     int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
     if (sockfd < 0) {
         perror("socket");
@@ -79,6 +165,13 @@ int create_and_bind_udp_socket(const char *ip, int port) {
         return -1;
     }
 
+    // Lets every worker bind the same port; the kernel spreads flows by 4-tuple
+    if (reuse_port && setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse)) < 0) {
+        perror("setsockopt SO_REUSEPORT");
+        close(sockfd);
+        return -1;
+    }
+
     struct sockaddr_in server_addr;
     memset(&server_addr, 0, sizeof(server_addr));
     server_addr.sin_family = AF_INET;
@@ -90,6 +183,8 @@ int create_and_bind_udp_socket(const char *ip, int port) {
         return -1;
     }
 
+    sockopt_apply(sockfd, sock, log_fp);
+
     if (bind(sockfd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
         perror("bind");
         close(sockfd);
@@ -99,59 +194,617 @@ int create_and_bind_udp_socket(const char *ip, int port) {
     return sockfd;
 }
 
-void handle_message(int sockfd, FILE *log_fp) {
-    uint8_t buffer[1024];
-    struct sockaddr_in client_addr;
-    socklen_t client_len = sizeof(client_addr);
+// Hands frames released by a client's reorder window to the output
+typedef struct {
+    ServerState *state;
+    const ClientState *client;
+} Delivery;
+
+static void deliver_fragment(ServerState *state, const MessageView *msg, const ClientState *c) {
+    FragmentView frag;
+    fragment_view_parse(msg, &frag);  // Validated on arrival
+
+    Reassembly *record = NULL;
+    switch (reassembly_add(&state->reassembly, &c->addr, msg->seq_num, &frag,
+                           (size_t)c->wire_payload - FRAG_HEADER_SIZE, monotonic_ns(), &record)) {
+        case FRAG_STORED:
+        case FRAG_DUPLICATE:
+            break;
+        case FRAG_COMPLETE:
+            metric_inc(&m_reassembled);
+            log_server(state->log_fp, "REASSEMBLED: msg=%u, seq=%u-%u, len=%zu",
+                      record->msg_id, record->first_seq,
+                      record->first_seq + record->count - 1, record->len);
+            sink_write_message(state->sink, record->first_seq, record->data, record->len);
+            reassembly_release(&state->reassembly, record);
+            break;
+        case FRAG_NO_SPACE:
+            log_server(state->log_fp, "WARN: Reassembly slots full, fragment seq=%u of msg=%u dropped",
+                      msg->seq_num, frag.msg_id);
+            break;
+        case FRAG_EXPIRED:
+            log_server(state->log_fp, "WARN: Fragment seq=%u belongs to timed-out msg=%u, discarded",
+                      msg->seq_num, frag.msg_id);
+            break;
+        case FRAG_INVALID:
+        default:
+            log_server(state->log_fp, "WARN: Fragment seq=%u inconsistent with msg=%u",
+                      msg->seq_num, frag.msg_id);
+            break;
+    }
+}
+
+static void deliver_frame(void *ctx, const uint8_t *frame, size_t len) {
+    Delivery *d = ctx;
+    MessageView msg;
+    message_view_parse(frame, len, &msg);
+    metric_inc(&m_delivered);
+
+    if (msg.type == MSG_TYPE_FRAG) {
+        deliver_fragment(d->state, &msg, d->client);
+    } else if (msg.type == MSG_TYPE_STREAM) {
+        sink_write_stream(d->state->sink, msg.payload, msg.payload_len);
+    } else {
+        // Print message to stdout (as required)
+        sink_write_message(d->state->sink, msg.seq_num, msg.payload, msg.payload_len);
+    }
+}
 
-    ssize_t recv_len = recvfrom(sockfd, buffer, sizeof(buffer), 0,
-                                (struct sockaddr *)&client_addr, &client_len);
+static void log_skipped(ServerState *state, const ClientState *c, uint64_t before) {
+    metric_add(&m_skipped, c->rx.skipped - before);
+
+    char client_ip[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &c->addr.sin_addr, client_ip, sizeof(client_ip));
+    log_server(state->log_fp, "GAP SKIPPED: %llu seqs below seq=%u never arrived, from=%s:%d",
+              (unsigned long long)(c->rx.skipped - before), c->rx.next_seq,
+              client_ip, ntohs(c->addr.sin_port));
+}
 
-    if (recv_len < 0) {
-        log_server(log_fp, "ERROR: recvfrom failed: %s", strerror(errno));
+// Messages a client's window currently holds back
+static uint64_t held_count(const ClientState *c) {
+    return (uint64_t)__builtin_popcountll(c->rx.buffered);
+}
+
+// Releases whatever a client still holds back, holes and all
+static void flush_client(ServerState *state, ClientState *c) {
+    uint64_t skipped = c->rx.skipped;
+    Delivery d = {state, c};
+    metric_sub(&m_reorder_held, held_count(c));
+    reorder_flush(&c->rx, &state->reorder, deliver_frame, &d);
+    if (c->rx.skipped != skipped) {
+        log_skipped(state, c, skipped);
+    }
+}
+
+int client_table_init(ClientTable *table, int capacity) {
+    memset(table, 0, sizeof(*table));
+
+    table->clients = calloc((size_t)capacity, sizeof(ClientState));
+    table->free_list = malloc((size_t)capacity * sizeof(int));
+    table->pending = malloc((size_t)capacity * sizeof(int));
+    if (!table->clients || !table->free_list || !table->pending ||
+        addr_table_init(&table->index, capacity) < 0) {
+        client_table_destroy(table);
+        return -1;
+    }
+
+    table->capacity = capacity;
+    for (int i = 0; i < capacity; i++) {
+        table->free_list[i] = capacity - 1 - i;
+    }
+    table->free_count = capacity;
+    return 0;
+}
+
+void client_table_destroy(ClientTable *table) {
+    free(table->clients);
+    free(table->free_list);
+    free(table->pending);
+    addr_table_destroy(&table->index);
+    memset(table, 0, sizeof(*table));
+}
+
+static ClientState *client_lookup_or_create(ServerState *state, const struct sockaddr_in *addr,
+                                            FILE *log_fp) {
+    ClientTable *table = &state->clients;
+    int idx = addr_table_get(&table->index, addr);
+    if (idx >= 0) {
+        return &table->clients[idx];
+    }
+
+    if (table->free_count == 0) {
+        metric_inc(&m_clients_rejected);
+        char client_ip[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &addr->sin_addr, client_ip, sizeof(client_ip));
+        log_server(log_fp, "ERROR: Client table full, ignoring client %s:%d",
+                  client_ip, ntohs(addr->sin_port));
+        return NULL;
+    }
+
+    idx = table->free_list[--table->free_count];
+    ClientState *c = &table->clients[idx];
+    memset(c, 0, sizeof(*c));
+    c->in_use = 1;
+    c->addr = *addr;
+    c->wire_payload = MAX_WIRE_PAYLOAD;  // Until a SYN says otherwise
+    addr_table_put(&table->index, addr, idx);
+    metric_inc(&m_clients);
+    return c;
+}
+
+// Held messages are still delivered, in order, before the state goes away
+static void client_close(ServerState *state, ClientState *c) {
+    ClientTable *table = &state->clients;
+    flush_client(state, c);
+    reorder_reset(&c->rx, &state->reorder);
+    addr_table_remove(&table->index, &c->addr);
+    c->in_use = 0;
+    table->free_list[table->free_count++] = (int)(c - table->clients);
+    metric_sub(&m_clients, 1);
+}
+
+// Once-a-second pass: drop idle clients and release gaps their senders gave up on
+static void client_sweep(ServerState *state, uint64_t now_ns) {
+    ClientTable *table = &state->clients;
+
+    for (int i = 0; i < table->capacity; i++) {
+        ClientState *c = &table->clients[i];
+        if (!c->in_use) continue;
+
+        if (now_ns - c->last_active_ns >= state->client_timeout_ns) {
+            char client_ip[INET_ADDRSTRLEN];
+            inet_ntop(AF_INET, &c->addr.sin_addr, client_ip, sizeof(client_ip));
+            log_server(state->log_fp, "CLIENT EVICT: client=%s:%d, idle=%llus, received=%llu, "
+                      "duplicates=%llu, skipped=%llu",
+                      client_ip, ntohs(c->addr.sin_port),
+                      (unsigned long long)((now_ns - c->last_active_ns) / 1000000000ULL),
+                      (unsigned long long)c->received, (unsigned long long)c->duplicates,
+                      (unsigned long long)c->rx.skipped);
+            metric_inc(&m_clients_evicted);
+            client_close(state, c);
+        } else if (reorder_deadline(&c->rx, state->reorder_timeout_ns) <= now_ns) {
+            // A sender that stops short of filling a gap has given up on it
+            log_server(state->log_fp, "REORDER TIMEOUT: releasing held messages past seq=%u",
+                      c->rx.next_seq);
+            flush_client(state, c);
+        }
+    }
+}
+
+static void send_acks(ServerState *state, UdpBatch *tx) {
+    int queued = tx->count;
+    int sent = udp_send_batch(state->sockfd, tx);
+    metric_add(&m_acks, (uint64_t)sent);
+    if (sent < queued) {
+        log_server(state->log_fp, "ERROR: sendmmsg sent %d of %d ACKs: %s",
+                  sent, queued, strerror(errno));
+    }
+}
+
+void flush_pending_acks(ServerState *state, UdpBatch *tx, FILE *log_fp) {
+    ClientTable *table = &state->clients;
+    if (table->pending_count == 0) {
         return;
     }
+    uint16_t window = sink_window(state->sink, REORDER_WINDOW);
 
-    // Deserialize message
-    Message msg;
-    if (deserialize_message(buffer, recv_len, &msg) < 0) {
-        log_server(log_fp, "ERROR: Failed to deserialize message");
+    // Only the clients heard from in this batch, not the whole table
+    while (table->pending_count > 0) {
+        ClientState *t = &table->clients[table->pending[table->pending_count - 1]];
+
+        // More clients than the batch holds: send what is queued and carry on
+        if (tx->count == tx->capacity) {
+            send_acks(state, tx);
+        }
+        uint8_t *buffer = udp_batch_next(tx);
+        if (!buffer) {
+            log_server(log_fp, "ERROR: ACK batch full, SACK deferred");
+            return;
+        }
+        table->pending_count--;
+        t->ack_pending = 0;
+        if (!t->in_use) {
+            continue;         // Closed by a SYN later in the batch
+        }
+
+        uint64_t bitmap = t->rx.buffered >> 1;
+        int sack_len = build_sack_frame(buffer, tx->buf_size, t->rx.next_seq, bitmap, window);
+        if (sack_len < 0) {
+            log_server(log_fp, "ERROR: Failed to serialize SACK");
+            continue;
+        }
+        if (t->crc) {
+            sack_len = (int)message_seal(buffer, (size_t)sack_len);
+        }
+
+        udp_batch_commit(tx, (size_t)sack_len, &t->addr, sizeof(t->addr));
+        evlog_emit_flow(ntohs(t->addr.sin_port), EV_SACK_SEND, 0, t->rx.next_seq, 0, window, (uint32_t)bitmap);
+
+        if (log_trace_enabled()) {
+            char client_ip[INET_ADDRSTRLEN];
+            inet_ntop(AF_INET, &t->addr.sin_addr, client_ip, sizeof(client_ip));
+            log_trace(log_fp, "SACK_SEND: cum=%u, sack=0x%016llx, win=%u, to=%s:%d",
+                      t->rx.next_seq, (unsigned long long)bitmap, (unsigned)window,
+                      client_ip, ntohs(t->addr.sin_port));
+        }
+    }
+}
+
+// Linear scan; only a resuming SYN from a new address gets here
+static ClientState *session_find(ServerState *state, uint64_t session_id) {
+    ClientTable *table = &state->clients;
+    for (int i = 0; i < table->capacity; i++) {
+        ClientState *c = &table->clients[i];
+        if (c->in_use && c->session_id == session_id) {
+            return c;
+        }
+    }
+    return NULL;
+}
+
+// Re-keys a resumed session under the address its restarted client sends from
+static void session_move(ServerState *state, ClientState *c, const struct sockaddr_in *addr) {
+    ClientTable *table = &state->clients;
+    int idx = addr_table_get(&table->index, addr);
+    if (idx >= 0) {
+        client_close(state, &table->clients[idx]);
+    }
+    addr_table_remove(&table->index, &c->addr);
+    c->addr = *addr;
+    addr_table_put(&table->index, addr, (int)(c - table->clients));
+}
+
+/*
+ * SYN: a client opening a session at its ISN, or asking for one it had
+ * before a restart. A new session discards whatever the address held, so
+ * a restarted client is never taken for one retransmitting; a resumed one
+ * keeps its window and is told the seq it is owed next. Either way the
+ * answer is a SYN-ACK naming the session.
+ */
+static void handle_syn(ServerState *state, const MessageView *msg,
+                       const struct sockaddr_in *client_addr, socklen_t client_len,
+                       UdpBatch *tx, FILE *log_fp) {
+    uint64_t requested;
+    uint16_t proposed;
+    if (parse_session_view(msg, &requested, &proposed) < 0) {
+        metric_inc(&m_invalid);
+        log_server(log_fp, "ERROR: Malformed SYN");
         return;
     }
+    uint16_t wire_payload = proposed < MAX_WIRE_PAYLOAD ? proposed : MAX_WIRE_PAYLOAD;
 
     char client_ip[INET_ADDRSTRLEN];
-    inet_ntop(AF_INET, &client_addr.sin_addr, client_ip, sizeof(client_ip));
+    inet_ntop(AF_INET, &client_addr->sin_addr, client_ip, sizeof(client_ip));
 
-    if (msg.type == MSG_TYPE_DATA) {
-        log_server(log_fp, "RECV: seq=%u, from=%s:%d, payload=\"%s\"",
-                  msg.seq_num, client_ip, ntohs(client_addr.sin_port), msg.payload);
+    ClientState *c = requested != 0 ? session_find(state, requested) : NULL;
+    if (c) {
+        if (memcmp(&c->addr, client_addr, sizeof(*client_addr)) != 0) {
+            session_move(state, c, client_addr);
+        }
+        metric_inc(&m_resumed);
+        log_server(log_fp, "SESSION RESUMED: id=%016llx, next_seq=%u, payload=%u, from=%s:%d",
+                  (unsigned long long)c->session_id, c->rx.next_seq, (unsigned)wire_payload,
+                  client_ip, ntohs(client_addr->sin_port));
+    } else {
+        c = client_lookup_or_create(state, client_addr, log_fp);
+        if (!c) {
+            return;
+        }
+        // A retransmitted SYN gets the answer its first copy did
+        if (c->session_id == 0 || c->isn != msg->seq_num) {
+            flush_client(state, c);
+            reorder_reset(&c->rx, &state->reorder);
+            c->rx.next_seq = msg->seq_num;
+            c->rx.started = 1;
+            c->session_id = session_new_id();
+            c->isn = msg->seq_num;
+            c->received = 0;
+            c->duplicates = 0;
+            metric_inc(&m_sessions);
+            log_server(log_fp, "SESSION OPEN: id=%016llx, isn=%u, payload=%u, from=%s:%d%s",
+                      (unsigned long long)c->session_id, c->isn, (unsigned)wire_payload,
+                      client_ip, ntohs(client_addr->sin_port),
+                      requested != 0 ? " (requested session unknown)" : "");
+        }
+    }
+    c->last_active_ns = monotonic_ns();
+    c->crc = msg->crc;
+    c->wire_payload = wire_payload;
 
-        // Print message to stdout (as required)
-        printf("Message (seq=%u): %s\n", msg.seq_num, msg.payload);
-        fflush(stdout);
+    uint8_t *reply = udp_batch_next(tx);
+    if (!reply) {
+        log_server(log_fp, "ERROR: ACK batch full, SYN-ACK dropped");
+        return;
+    }
+    int len = build_session_frame(reply, tx->buf_size, MSG_TYPE_SYN_ACK, c->rx.next_seq,
+                                  c->session_id, c->wire_payload);
+    if (len < 0) {
+        log_server(log_fp, "ERROR: Failed to serialize SYN-ACK");
+        return;
+    }
+    if (c->crc) {
+        len = (int)message_seal(reply, (size_t)len);
+    }
+    udp_batch_commit(tx, (size_t)len, client_addr, client_len);
+}
+
+void handle_message(ServerState *state, const uint8_t *buffer, size_t recv_len,
+                    const struct sockaddr_in *client_addr, socklen_t client_len,
+                    UdpBatch *tx, FILE *log_fp) {
+    // Decode the header in place; the payload stays in the receive buffer
+    MessageView msg;
+    if (message_view_parse(buffer, recv_len, &msg) < 0) {
+        metric_inc(&m_invalid);
+        log_server(log_fp, "ERROR: Failed to deserialize message");
+        return;
+    }
 
-        // Send ACK
-        Message ack;
-        create_ack_message(&ack, msg.seq_num);
+    // Damaged in transit: drop it unacknowledged and let the sender retransmit
+    if (message_view_verify(&msg) < 0) {
+        metric_inc(&m_bad_checksum);
+        log_server(log_fp, "WARN: seq=%u failed its checksum, dropped", msg.seq_num);
+        return;
+    }
 
-        int ack_len = serialize_message(&ack, buffer, sizeof(buffer));
-        if (ack_len < 0) {
-            log_server(log_fp, "ERROR: Failed to serialize ACK");
-            return;
+    if (msg.type == MSG_TYPE_SYN) {
+        handle_syn(state, &msg, client_addr, client_len, tx, log_fp);
+        return;
+    }
+
+    if (msg.type != MSG_TYPE_DATA && msg.type != MSG_TYPE_FRAG && msg.type != MSG_TYPE_STREAM) {
+        metric_inc(&m_invalid);
+        log_server(log_fp, "WARN: Unexpected message type %d", msg.type);
+        return;
+    }
+
+    if (msg.type == MSG_TYPE_DATA && msg.payload_len > MAX_PAYLOAD_SIZE) {
+        metric_inc(&m_invalid);
+        log_server(log_fp, "ERROR: DATA payload of %u bytes exceeds %d",
+                  (unsigned)msg.payload_len, MAX_PAYLOAD_SIZE);
+        return;
+    }
+
+    FragmentView frag;
+    if (msg.type == MSG_TYPE_FRAG && fragment_view_parse(&msg, &frag) < 0) {
+        metric_inc(&m_invalid);
+        log_server(log_fp, "ERROR: Malformed fragment seq=%u", msg.seq_num);
+        return;
+    }
+
+    evlog_emit_flow(ntohs(client_addr->sin_port), EV_RECV, 0, msg.seq_num, 0, msg.payload_len, msg.type);
+
+    char client_ip[INET_ADDRSTRLEN] = "";
+    if (log_trace_enabled()) {
+        inet_ntop(AF_INET, &client_addr->sin_addr, client_ip, sizeof(client_ip));
+        if (msg.type == MSG_TYPE_FRAG) {
+            log_trace(log_fp, "RECV: seq=%u, from=%s:%d, frag=%u/%u, msg=%u",
+                      msg.seq_num, client_ip, ntohs(client_addr->sin_port),
+                      (unsigned)frag.index + 1, (unsigned)frag.count, frag.msg_id);
+        } else if (msg.type == MSG_TYPE_STREAM) {
+            log_trace(log_fp, "RECV: seq=%u, from=%s:%d, stream=%u bytes",
+                      msg.seq_num, client_ip, ntohs(client_addr->sin_port),
+                      (unsigned)msg.payload_len);
+        } else {
+            log_trace(log_fp, "RECV: seq=%u, from=%s:%d, payload=\"%.*s\"",
+                      msg.seq_num, client_ip, ntohs(client_addr->sin_port),
+                      (int)msg.payload_len, (const char *)msg.payload);
         }
+    }
+
+    ClientState *client = client_lookup_or_create(state, client_addr, log_fp);
+    if (!client) {
+        return;
+    }
+
+    // Frames are held to the payload size the client's handshake settled on
+    if (msg.payload_len > client->wire_payload ||
+        (msg.type == MSG_TYPE_FRAG &&
+         fragment_view_check(&frag, (size_t)client->wire_payload - FRAG_HEADER_SIZE) < 0)) {
+        metric_inc(&m_invalid);
+        log_server(log_fp, "ERROR: seq=%u does not fit the %u-byte payload of its session",
+                  msg.seq_num, (unsigned)client->wire_payload);
+        return;
+    }
+
+    uint64_t now = monotonic_ns();
+    client->last_active_ns = now;
+    client->received++;
+    client->crc = msg.crc;
+
+    // Retransmissions are acknowledged again but delivered once, in seq order
+    uint64_t skipped = client->rx.skipped;
+    uint64_t held = held_count(client);
+    Delivery d = {state, client};
+    ReorderResult result = reorder_accept(&client->rx, &state->reorder, msg.seq_num, buffer,
+                                          message_view_frame_len(&msg),
+                                          now, deliver_frame, &d);
+    metric_add(&m_reorder_held, held_count(client) - held);
+    if (client->rx.skipped != skipped) {
+        log_skipped(state, client, skipped);
+    }
 
-        ssize_t sent = sendto(sockfd, buffer, ack_len, 0,
-                             (struct sockaddr *)&client_addr, client_len);
-        if (sent < 0) {
-            log_server(log_fp, "ERROR: sendto ACK failed: %s", strerror(errno));
+    switch (result) {
+        case REORDER_NO_SPACE:
+            metric_inc(&m_reorder_full);
+            log_server(log_fp, "WARN: Reorder buffers exhausted, seq=%u not acknowledged",
+                      msg.seq_num);
             return;
+        case REORDER_DUPLICATE:
+            client->duplicates++;
+            metric_inc(&m_duplicates);
+            evlog_emit_flow(ntohs(client_addr->sin_port), EV_DUPLICATE, 0, msg.seq_num, 0, msg.payload_len, 0);
+            log_trace(log_fp, "DUPLICATE: seq=%u, from=%s:%d",
+                      msg.seq_num, client_ip, ntohs(client_addr->sin_port));
+            break;
+        case REORDER_BUFFERED:
+            log_trace(log_fp, "BUFFERED: seq=%u, waiting for seq=%u",
+                      msg.seq_num, client->rx.next_seq);
+            break;
+        case REORDER_DELIVERED:
+            break;
+    }
+
+    if (state->sack) {
+        // Acknowledged together with the rest of the batch
+        if (!client->ack_pending) {
+            client->ack_pending = 1;
+            state->clients.pending[state->clients.pending_count++] =
+                (int)(client - state->clients.clients);
         }
+        return;
+    }
 
-        log_server(log_fp, "ACK_SEND: seq=%u, to=%s:%d",
-                  msg.seq_num, client_ip, ntohs(client_addr.sin_port));
-    } else {
-        log_server(log_fp, "WARN: Unexpected message type %d", msg.type);
+    // Build the ACK straight into the send batch; the whole batch goes out in one call
+    uint8_t *ack_buf = udp_batch_next(tx);
+    if (!ack_buf) {
+        log_server(log_fp, "ERROR: ACK batch full, ACK dropped");
+        return;
+    }
+
+    int ack_len = build_ack_frame(ack_buf, tx->buf_size, msg.seq_num);
+    if (ack_len < 0) {
+        log_server(log_fp, "ERROR: Failed to serialize ACK");
+        return;
+    }
+    if (msg.crc) {
+        ack_len = (int)message_seal(ack_buf, (size_t)ack_len);
+    }
+    udp_batch_commit(tx, (size_t)ack_len, client_addr, client_len);
+    evlog_emit_flow(ntohs(client_addr->sin_port), EV_ACK_SEND, 0, msg.seq_num, 0, 0, 0);
+
+    log_trace(log_fp, "ACK_SEND: seq=%u, to=%s:%d",
+              msg.seq_num, client_ip, ntohs(client_addr->sin_port));
+}
+
+// Socket readable: drain a batch, then send every ACK it produced in one call
+static void on_datagrams(EventSource *src, uint32_t events) {
+    ServerState *state = src->ctx;
+    (void)events;
+
+    int n = udp_recv_batch(state->sockfd, &state->rx);
+    if (n < 0) {
+        log_server(state->log_fp, "ERROR: recvmmsg failed: %s", strerror(errno));
+        return;
+    }
+
+    uint32_t overflow = udp_batch_overflow(&state->rx, &state->rx_overflow);
+    if (overflow > 0) {
+        metric_add(&m_rx_overflow, overflow);
+        log_server(state->log_fp, "WARN: worker %d receive buffer overran, kernel dropped %u "
+                  "datagrams (raise --rcvbuf)", state->id, overflow);
+    }
+
+    for (int i = 0; i < n; i++) {
+        const uint8_t *data = udp_batch_buffer(&state->rx, i);
+        metric_add(&m_bytes, state->rx.len[i]);
+        size_t off = 0;
+        do {
+            // A coalesced read can carry more messages than the ACK batch holds
+            if (state->tx.count == state->tx.capacity) {
+                send_acks(state, &state->tx);
+            }
+            size_t len = udp_batch_segment_len(&state->rx, i, off);
+            metric_inc(&m_datagrams);
+            handle_message(state, data + off, len, &state->rx.addr[i], state->rx.addr_len[i],
+                           &state->tx, state->log_fp);
+            off += len;
+        } while (off < state->rx.len[i]);
+    }
+
+    // In SACK mode the whole batch is confirmed with one SACK per client
+    if (state->sack) {
+        flush_pending_acks(state, &state->tx, state->log_fp);
     }
+    send_acks(state, &state->tx);
+}
+
+static void *worker_main(void *arg) {
+    ServerState *state = arg;
+
+    while (running) {
+        uint64_t deadline = reassembly_next_deadline(&state->reassembly);
+        uint64_t output_due = sink_deadline(state->sink);
+        if (state->next_sweep_ns < deadline) {
+            deadline = state->next_sweep_ns;
+        }
+        if (output_due < deadline) {
+            deadline = output_due;
+        }
+        if (event_loop_poll(&state->loop, deadline) < 0) {
+            log_server(state->log_fp, "ERROR: worker %d event loop failed: %s",
+                      state->id, strerror(errno));
+            break;
+        }
+
+        Reassembly *stale;
+        while ((stale = reassembly_next_expired(&state->reassembly, monotonic_ns()))) {
+            log_server(state->log_fp, "REASSEMBLY TIMEOUT: msg=%u, %u/%u fragments, dropped",
+                      stale->msg_id, (unsigned)stale->received, (unsigned)stale->count);
+            metric_inc(&m_reassembly_timeouts);
+            reassembly_drop(&state->reassembly, stale);
+        }
+
+        uint64_t now = monotonic_ns();
+        sink_poll(state->sink, now);
+        if (now >= state->next_sweep_ns) {
+            client_sweep(state, now);
+            state->next_sweep_ns = now + SERVER_SWEEP_INTERVAL_NS;
+        }
+    }
+    packet_pool_thread_release();
+    evlog_thread_flush();
+    return NULL;
+}
+
+static int worker_init(ServerState *state, int id, const ServerConfig *config,
+                       OutputSink *sink, FILE *log_fp) {
+    memset(state, 0, sizeof(*state));
+    state->id = id;
+    state->sack = config->sack;
+    state->sink = sink;
+    state->log_fp = log_fp;
+    state->reorder_timeout_ns = (uint64_t)config->reorder_timeout * 1000000000ULL;
+    state->client_timeout_ns = (uint64_t)config->client_timeout * 1000000000ULL;
+    state->next_sweep_ns = monotonic_ns() + SERVER_SWEEP_INTERVAL_NS;
+    state->loop.epfd = -1;
+    state->loop.wake_pipe[0] = state->loop.wake_pipe[1] = -1;
+
+    state->sockfd = create_and_bind_udp_socket(config->listen_ip, config->listen_port,
+                                               config->workers > 1, &config->sock, log_fp);
+    if (state->sockfd < 0) {
+        return -1;
+    }
+
+    // With GRO one read may return a whole burst from a client coalesced into one buffer
+    size_t rx_size = config->sock.gro ? SOCKOPT_GRO_BUF_SIZE : MAX_FRAME_SIZE;
+    if (udp_batch_init(&state->rx, config->batch, rx_size) < 0 ||
+        udp_batch_init(&state->tx, config->batch, CONTROL_FRAME_SIZE) < 0 ||
+        reassembly_init(&state->reassembly, config->reassembly_slots,
+                        config->reassembly_timeout) < 0 ||
+        reorder_pool_init(&state->reorder, config->reorder_buffers) < 0 ||
+        client_table_init(&state->clients, config->max_clients) < 0 ||
+        event_loop_init(&state->loop) < 0 ||
+        event_loop_add(&state->loop, &state->sock_src, state->sockfd,
+                       on_datagrams, state, NULL) < 0) {
+        log_server(log_fp, "ERROR: Failed to set up worker %d: %s", id, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+static void worker_destroy(ServerState *state) {
+    for (int i = 0; i < state->clients.capacity; i++) {
+        if (state->clients.clients[i].in_use) {
+            client_close(state, &state->clients.clients[i]);
+        }
+    }
+    client_table_destroy(&state->clients);
+    reorder_pool_destroy(&state->reorder);
+    event_loop_destroy(&state->loop);
+    udp_batch_destroy(&state->rx);
+    udp_batch_destroy(&state->tx);
+    reassembly_destroy(&state->reassembly);
+    if (state->sockfd >= 0) close(state->sockfd);
 }
 
 int main(int argc, char *argv[]) {
@@ -163,49 +816,108 @@ int main(int argc, char *argv[]) {
     }
 
     if (config.log_file) {
-        log_fp = fopen(config.log_file, "a");
+        log_fp = log_open_file(config.log_file);
         if (!log_fp) {
             fprintf(stderr, "Warning: Could not open log file %s\n", config.log_file);
         }
     }
 
-    signal(SIGINT, sigint_handler);
+    if (log_init(&config.log) < 0) {
+        fprintf(stderr, "Warning: Could not start log writer, logging synchronously\n");
+    }
 
-    log_server(log_fp, "SERVER STARTED: listening on %s:%d",
-              config.listen_ip, config.listen_port);
+    log_server(log_fp, "SERVER STARTED: listening on %s:%d, ack_mode=%s, workers=%d",
+              config.listen_ip, config.listen_port, config.sack ? "sack" : "single",
+              config.workers);
 
-    int sockfd = create_and_bind_udp_socket(config.listen_ip, config.listen_port);
-    if (sockfd < 0) {
+    OutputSink sink;
+    if (sink_init(&sink, &config.output, log_fp) < 0) {
+        log_shutdown();
         if (log_fp) fclose(log_fp);
         return EXIT_FAILURE;
     }
 
-    printf("Server listening on %s:%d\n", config.listen_ip, config.listen_port);
-    printf("Press Ctrl+C to stop\n\n");
+    // Out-of-order messages are the server's only held packets
+    size_t pool_buffers = (size_t)config.workers * (size_t)config.reorder_buffers * REORDER_WINDOW;
+    ServerState *states = calloc((size_t)config.workers, sizeof(ServerState));
+    if (!states || packet_pool_init(pool_buffers) < 0) {
+        free(states);
+        log_server(log_fp, "ERROR: Failed to allocate workers");
+        sink_destroy(&sink);
+        log_shutdown();
+        if (log_fp) fclose(log_fp);
+        return EXIT_FAILURE;
+    }
 
-    while (running) {
-        fd_set readfds;
-        struct timeval tv;
+    // Bind every socket before any traffic is served so the kernel can shard across all of them
+    int ready = 0;
+    while (ready < config.workers) {
+        if (worker_init(&states[ready], ready, &config, &sink, log_fp) < 0) {
+            worker_destroy(&states[ready]);
+            break;
+        }
+        ready++;
+    }
+    if (ready < config.workers) {
+        for (int i = 0; i < ready; i++) worker_destroy(&states[i]);
+        free(states);
+        packet_pool_destroy();
+        sink_destroy(&sink);
+        log_shutdown();
+        if (log_fp) fclose(log_fp);
+        return EXIT_FAILURE;
+    }
 
-        FD_ZERO(&readfds);
-        FD_SET(sockfd, &readfds);
-        tv.tv_sec = 1;
-        tv.tv_usec = 0;
+    metrics_register_all(server_metrics, sizeof(server_metrics) / sizeof(server_metrics[0]));
+    if (metrics_start(&config.metrics, log_fp) < 0) {
+        log_server(log_fp, "WARN: Continuing without a metrics endpoint");
+    }
+    if (evlog_open(&config.events, EVLOG_ROLE_SERVER) < 0) {
+        log_server(log_fp, "WARN: Could not open event log %s: %s",
+                  config.events.path, strerror(errno));
+    }
 
-        int ready = select(sockfd + 1, &readfds, NULL, NULL, &tv);
+    // Installed only once the loops exist, so the handler can wake them
+    workers = states;
+    worker_count = config.workers;
+    signal(SIGINT, sigint_handler);
 
-        if (ready < 0 && errno != EINTR) {
-            log_server(log_fp, "ERROR: select failed: %s", strerror(errno));
+    printf("Server listening on %s:%d\n", config.listen_ip, config.listen_port);
+    printf("Press Ctrl+C to stop\n\n");
+    fflush(stdout);
+
+    // Worker 0 runs on the main thread
+    for (int i = 1; i < config.workers; i++) {
+        if (pthread_create(&states[i].thread, NULL, worker_main, &states[i]) != 0) {
+            log_server(log_fp, "ERROR: Failed to start worker %d", i);
+            running = 0;
+            for (int j = 1; j < i; j++) event_loop_wakeup(&states[j].loop);
+            worker_count = i;
             break;
         }
+    }
+    worker_main(&states[0]);
 
-        if (ready > 0 && FD_ISSET(sockfd, &readfds)) {
-            handle_message(sockfd, log_fp);
-        }
+    for (int i = 1; i < worker_count; i++) {
+        pthread_join(states[i].thread, NULL);
     }
 
     log_server(log_fp, "SERVER SHUTDOWN");
-    close(sockfd);
+    metrics_stop();
+    evlog_close();
+    worker_count = 0;
+    for (int i = 0; i < config.workers; i++) {
+        worker_destroy(&states[i]);
+    }
+    free(states);
+
+    PacketPoolStats pool;
+    packet_pool_stats(&pool);
+    log_server(log_fp, "PACKET POOL: high_water=%zu of %zu buffers, exhausted=%llu",
+              pool.high_water, pool.max_buffers, pool.exhausted);
+    packet_pool_destroy();
+    sink_destroy(&sink);
+    log_shutdown();
     if (log_fp) fclose(log_fp);
 
     return EXIT_SUCCESS;
@@ -3,19 +3,104 @@
 
 #include <stdio.h>
 #include "protocol.h"
+#include "log.h"
+#include "addr_table.h"
+#include "batch_io.h"
+#include "event_loop.h"
+#include "reassembly.h"
+#include "reorder.h"
+#include "metrics.h"
+#include "evlog.h"
+#include "sockopt.h"
+#include "sink.h"
+#include "session.h"
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <pthread.h>
 
 typedef struct {
     char *listen_ip;
     int listen_port;
     char *log_file;
+    int sack;                 // Coalesce ACKs into cumulative/selective ACKs
+    int batch;                // Max datagrams per recvmmsg()/sendmmsg()
+    int workers;              // Threads, each with its own SO_REUSEPORT socket
+    int reassembly_slots;     // Fragmented records in progress at once, per worker
+    int reassembly_timeout;   // Seconds without progress before a partial record is dropped
+    int reorder_buffers;      // Clients that may hold out-of-order messages at once, per worker
+    int reorder_timeout;      // Seconds a gap may hold back delivery before it is skipped
+    int max_clients;          // Concurrent clients tracked per worker
+    int client_timeout;       // Idle seconds before a client's state is evicted
+    SocketConfig sock;
+    SinkConfig output;        // Where and how delivered messages are written
+    LogConfig log;
+    MetricsConfig metrics;
+    EventLogConfig events;
 } ServerConfig;
 
+#define SERVER_DEFAULT_MAX_CLIENTS 16384
+#define SERVER_DEFAULT_CLIENT_TIMEOUT 60
+#define SERVER_SWEEP_INTERVAL_NS 1000000000ULL
+#define MAX_WORKERS 64
+
+// Per-client receive state: the in-order delivery window, which also
+// supplies the cumulative/selective ACK point
+typedef struct {
+    int in_use;
+    int ack_pending;
+    int crc;                  // Client checksums its frames, so ACKs to it are sealed too
+    uint64_t session_id;      // From the client's SYN; 0 for a sender that skipped the handshake
+    uint32_t isn;             // Seq the session opened at
+    uint16_t wire_payload;    // Largest payload the client may send, settled in the handshake
+    struct sockaddr_in addr;
+    ReorderBuffer rx;
+    uint64_t last_active_ns;
+    uint64_t received;        // Messages accepted, retransmissions included
+    uint64_t duplicates;
+} ClientState;
+
+// Dense array of client states indexed by an open-addressed address table
+typedef struct {
+    ClientState *clients;
+    int *free_list;           // Unused clients[] slots
+    int free_count;
+    int capacity;
+    AddrTable index;          // Client address -> clients[] slot
+    int *pending;             // Slots with a SACK owed for the current batch
+    int pending_count;
+} ClientTable;
+
+// One worker: its own socket, event loop and client state, touched by one thread only
+typedef struct {
+    int id;
+    int sack;
+    ClientTable clients;
+    ReorderPool reorder;
+    uint64_t reorder_timeout_ns;
+    uint64_t client_timeout_ns;
+    uint64_t next_sweep_ns;   // Idle eviction and stalled-gap checks, once a second
+    int sockfd;
+    uint32_t rx_overflow;     // Kernel drop count last reported for sockfd
+    UdpBatch rx;
+    UdpBatch tx;
+    EventSource sock_src;
+    EventLoop loop;
+    ReassemblyTable reassembly;
+    OutputSink *sink;
+    pthread_t thread;
+    FILE *log_fp;
+} ServerState;
+
 // Function prototypes
 int parse_server_args(int argc, char *argv[], ServerConfig *config);
-int create_and_bind_udp_socket(const char *ip, int port);
-void handle_message(int sockfd, FILE *log_fp);
+int create_and_bind_udp_socket(const char *ip, int port, int reuse_port,
+                               const SocketConfig *sock, FILE *log_fp);
+int client_table_init(ClientTable *table, int capacity);
+void client_table_destroy(ClientTable *table);
+void handle_message(ServerState *state, const uint8_t *buffer, size_t recv_len,
+                    const struct sockaddr_in *client_addr, socklen_t client_len,
+                    UdpBatch *tx, FILE *log_fp);
+void flush_pending_acks(ServerState *state, UdpBatch *tx, FILE *log_fp);
 void log_server(FILE *log_fp, const char *format, ...);
 
 #endif //COMP7005PROJ1_SERVER_H
\ No newline at end of file
@@ -0,0 +1,104 @@
+#define _GNU_SOURCE
+#include "session.h"
+#include "event_loop.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/random.h>
+
+// Kernel randomness; should that ever fail, the clock and pid still make
+// a collision between two sessions unlikely, which is all this needs
+void session_random(void *buf, size_t len) {
+    uint8_t *p = buf;
+    while (len > 0) {
+        ssize_t n = getrandom(p, len, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+
+    uint64_t x = monotonic_ns() ^ ((uint64_t)getpid() << 32);
+    for (size_t i = 0; i < len; i++) {
+        // splitmix64 step
+        x += 0x9E3779B97F4A7C15ULL;
+        uint64_t z = x;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        p[i] = (uint8_t)(z ^ (z >> 31));
+    }
+}
+
+// Never 0, which a SYN uses to ask for a new session
+uint64_t session_new_id(void) {
+    uint64_t id = 0;
+    while (id == 0) {
+        session_random(&id, sizeof(id));
+    }
+    return id;
+}
+
+uint32_t session_new_isn(void) {
+    uint32_t isn;
+    session_random(&isn, sizeof(isn));
+    return isn;
+}
+
+// 0 on success, -1 if the file is missing or unreadable
+int checkpoint_load(const char *path, SessionCheckpoint *cp) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        return -1;
+    }
+
+    unsigned long long id, offset, size;
+    unsigned int seq, port;
+    int fields = fscanf(fp, "session=%llx seq=%u offset=%llu port=%u size=%llu",
+                        &id, &seq, &offset, &port, &size);
+    fclose(fp);
+    if (fields != 5 || id == 0 || port > 65535) {
+        return -1;
+    }
+
+    cp->session_id = id;
+    cp->seq = seq;
+    cp->offset = offset;
+    cp->local_port = (uint16_t)port;
+    cp->file_size = size;
+    return 0;
+}
+
+// Written beside the target and renamed over it, so a client killed
+// mid-save leaves the previous checkpoint rather than half of a new one
+int checkpoint_save(const char *path, const SessionCheckpoint *cp) {
+    char tmp[4096];
+    char line[160];
+    if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    int len = snprintf(line, sizeof(line), "session=%016llx seq=%u offset=%llu port=%u size=%llu\n",
+                       (unsigned long long)cp->session_id, cp->seq,
+                       (unsigned long long)cp->offset, (unsigned)cp->local_port,
+                       (unsigned long long)cp->file_size);
+
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+    if (write(fd, line, (size_t)len) != len) {
+        close(fd);
+        unlink(tmp);
+        return -1;
+    }
+    close(fd);
+    return rename(tmp, path);
+}
+
+void checkpoint_remove(const char *path) {
+    unlink(path);
+}
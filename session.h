@@ -0,0 +1,32 @@
+#ifndef COMP7005PROJ1_SESSION_H
+#define COMP7005PROJ1_SESSION_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "protocol.h"
+
+#define SESSION_CHECKPOINT_INTERVAL_NS 100000000ULL  // Progress a killed client may have to resend
+
+/*
+ * What a client needs to pick a --file transfer up where it left off: the
+ * server's session, the first sequence number not yet acknowledged and how
+ * much of the file came before it. local_port brings a restarted client
+ * back to the server worker that holds the session.
+ */
+typedef struct {
+    uint64_t session_id;
+    uint32_t seq;
+    uint64_t offset;
+    uint16_t local_port;
+    uint64_t file_size;       // The file the checkpoint was taken against
+} SessionCheckpoint;
+
+// Function prototypes
+void session_random(void *buf, size_t len);
+uint64_t session_new_id(void);
+uint32_t session_new_isn(void);
+int checkpoint_load(const char *path, SessionCheckpoint *cp);
+int checkpoint_save(const char *path, const SessionCheckpoint *cp);
+void checkpoint_remove(const char *path);
+
+#endif //COMP7005PROJ1_SESSION_H
@@ -0,0 +1,316 @@
+#define _GNU_SOURCE
+#include "sink.h"
+#include "event_loop.h"
+#include "log.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+static void log_sink(FILE *log_fp, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    log_vwrite(LOG_LEVEL_INFO, log_fp, format, args);
+    va_end(args);
+}
+
+void sink_config_default(SinkConfig *config) {
+    config->path = NULL;
+    config->thread = 0;
+    config->buffer_bytes = SINK_DEFAULT_BUFFER;
+    config->flush_bytes = SINK_DEFAULT_FLUSH_BYTES;
+    config->flush_ms = SINK_DEFAULT_FLUSH_MS;
+}
+
+int sink_parse_arg(int argc, char *argv[], int *i, SinkConfig *config) {
+    if (strcmp(argv[*i], "--output-thread") == 0) {
+        config->thread = 1;
+        return 1;
+    }
+    if (*i + 1 >= argc) {
+        return 0;
+    }
+    if (strcmp(argv[*i], "--output") == 0) {
+        config->path = argv[++*i];
+    } else if (strcmp(argv[*i], "--output-buffer") == 0) {
+        config->buffer_bytes = strtoul(argv[++*i], NULL, 10);
+    } else if (strcmp(argv[*i], "--flush-bytes") == 0) {
+        config->flush_bytes = strtoul(argv[++*i], NULL, 10);
+    } else if (strcmp(argv[*i], "--flush-ms") == 0) {
+        config->flush_ms = atoi(argv[++*i]);
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+int sink_config_valid(const SinkConfig *config) {
+    return config->buffer_bytes >= SINK_MIN_BUFFER && config->flush_bytes > 0 &&
+           config->flush_bytes <= config->buffer_bytes && config->flush_ms >= 0;
+}
+
+static int flush_due(const OutputSink *sink, uint64_t now_ns) {
+    return sink->used > 0 && (sink->used >= sink->flush_bytes || sink->stop || sink->waiters > 0 ||
+                              now_ns >= sink->first_ns + sink->flush_ns);
+}
+
+// Write out what is buffered now; bytes appended meanwhile wait for the
+// next flush, so a busy worker is never kept writing on the others' behalf.
+// Called with the lock held and returns with it held.
+static void drain_locked(OutputSink *sink) {
+    size_t remaining = sink->used;
+    sink->flushing = 1;
+
+    while (remaining > 0) {
+        size_t head = sink->head;
+        size_t first = sink->capacity - head < remaining ? sink->capacity - head : remaining;
+        struct iovec iov[2] = {
+            { sink->ring + head, first },
+            { sink->ring, remaining - first }
+        };
+        pthread_mutex_unlock(&sink->lock);
+
+        ssize_t written;
+        if (sink->write_failed) {
+            written = (ssize_t)remaining;   // Discard rather than stall every worker
+        } else {
+            written = writev(sink->fd, iov, remaining > first ? 2 : 1);
+        }
+        pthread_mutex_lock(&sink->lock);
+
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            log_sink(sink->log_fp, "ERROR: output write failed: %s; discarding further output",
+                    strerror(errno));
+            sink->write_failed = 1;
+            continue;
+        }
+        if (!sink->write_failed) {
+            sink->writes++;
+            sink->bytes += (uint64_t)written;
+        }
+        sink->head = (head + (size_t)written) % sink->capacity;
+        sink->used -= (size_t)written;
+        remaining -= (size_t)written;
+        pthread_cond_broadcast(&sink->space_cond);
+    }
+
+    sink->flushing = 0;
+    sink->first_ns = monotonic_ns();
+}
+
+static void *writer_main(void *arg) {
+    OutputSink *sink = arg;
+
+    pthread_mutex_lock(&sink->lock);
+    for (;;) {
+        while (!flush_due(sink, monotonic_ns())) {
+            if (sink->stop) {
+                pthread_mutex_unlock(&sink->lock);
+                return NULL;
+            }
+            if (sink->used == 0) {
+                pthread_cond_wait(&sink->data_cond, &sink->lock);
+                continue;
+            }
+            uint64_t due = sink->first_ns + sink->flush_ns;
+            struct timespec ts = { (time_t)(due / 1000000000ULL), (long)(due % 1000000000ULL) };
+            pthread_cond_timedwait(&sink->data_cond, &sink->lock, &ts);
+        }
+        drain_locked(sink);
+    }
+}
+
+int sink_init(OutputSink *sink, const SinkConfig *config, FILE *log_fp) {
+    memset(sink, 0, sizeof(*sink));
+    sink->log_fp = log_fp;
+    sink->fd = STDOUT_FILENO;
+    sink->capacity = config->buffer_bytes;
+    sink->flush_bytes = config->flush_bytes;
+    sink->flush_ns = (uint64_t)config->flush_ms * 1000000ULL;
+
+    if (config->path) {
+        sink->fd = open(config->path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (sink->fd < 0) {
+            log_sink(log_fp, "ERROR: Cannot open output %s: %s", config->path, strerror(errno));
+            return -1;
+        }
+        sink->owns_fd = 1;
+    }
+
+    struct stat st;
+    if (fstat(sink->fd, &st) == 0 && S_ISFIFO(st.st_mode)) {
+        int size = fcntl(sink->fd, F_GETPIPE_SZ);
+        if (size > 0) {
+            sink->pipe_size = size;
+        }
+    }
+
+    // The writer's timed waits are on the monotonic clock, like every deadline here
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_mutex_init(&sink->lock, NULL);
+    pthread_cond_init(&sink->data_cond, &attr);
+    pthread_cond_init(&sink->space_cond, NULL);
+    pthread_condattr_destroy(&attr);
+
+    sink->ring = malloc(sink->capacity);
+    if (!sink->ring) {
+        log_sink(log_fp, "ERROR: Cannot allocate %zu-byte output buffer", sink->capacity);
+        if (sink->owns_fd) {
+            close(sink->fd);
+        }
+        return -1;
+    }
+    if (config->thread) {
+        if (pthread_create(&sink->writer, NULL, writer_main, sink) != 0) {
+            log_sink(log_fp, "WARN: Cannot start output thread, writing from the workers");
+        } else {
+            sink->threaded = 1;
+        }
+    }
+    return 0;
+}
+
+// Writes out everything still buffered
+void sink_destroy(OutputSink *sink) {
+    pthread_mutex_lock(&sink->lock);
+    sink->stop = 1;
+    if (sink->threaded) {
+        pthread_cond_signal(&sink->data_cond);
+        pthread_mutex_unlock(&sink->lock);
+        pthread_join(sink->writer, NULL);
+        pthread_mutex_lock(&sink->lock);
+    }
+    while (sink->used > 0) {
+        drain_locked(sink);
+    }
+    pthread_mutex_unlock(&sink->lock);
+
+    if (sink->writes > 0) {
+        log_sink(sink->log_fp, "OUTPUT: %llu bytes in %llu writes (%.0f bytes/write), %llu stalls",
+                (unsigned long long)sink->bytes, (unsigned long long)sink->writes,
+                (double)sink->bytes / (double)sink->writes, (unsigned long long)sink->stalls);
+    }
+    if (sink->owns_fd) {
+        close(sink->fd);
+    }
+    free(sink->ring);
+    pthread_cond_destroy(&sink->data_cond);
+    pthread_cond_destroy(&sink->space_cond);
+    pthread_mutex_destroy(&sink->lock);
+}
+
+// Wait, with the lock held, until len more bytes fit. Without a writer
+// thread the caller does the write itself unless another worker already is.
+static void reserve_locked(OutputSink *sink, size_t len) {
+    int stalled = 0;
+    while (sink->capacity - sink->used < len) {
+        stalled = 1;
+        if (!sink->threaded && !sink->flushing) {
+            drain_locked(sink);
+            continue;
+        }
+        sink->waiters++;
+        pthread_cond_signal(&sink->data_cond);
+        pthread_cond_wait(&sink->space_cond, &sink->lock);
+        sink->waiters--;
+    }
+    sink->stalls += (uint64_t)stalled;
+    if (sink->used == 0) {
+        sink->first_ns = monotonic_ns();
+    }
+}
+
+static void put_locked(OutputSink *sink, const void *data, size_t len) {
+    size_t tail = (sink->head + sink->used) % sink->capacity;
+    size_t first = sink->capacity - tail < len ? sink->capacity - tail : len;
+    memcpy(sink->ring + tail, data, first);
+    memcpy(sink->ring, (const uint8_t *)data + first, len - first);
+    sink->used += len;
+}
+
+// Size threshold: hand a full batch to the writer, or write it here
+static void appended_locked(OutputSink *sink) {
+    if (sink->used < sink->flush_bytes) {
+        return;
+    }
+    if (sink->threaded) {
+        pthread_cond_signal(&sink->data_cond);
+    } else if (!sink->flushing) {
+        drain_locked(sink);
+    }
+}
+
+void sink_write_message(OutputSink *sink, uint32_t seq_num, const uint8_t *payload, size_t len) {
+    char prefix[32];
+    int plen = snprintf(prefix, sizeof(prefix), "Message (seq=%u): ", seq_num);
+
+    pthread_mutex_lock(&sink->lock);
+    reserve_locked(sink, (size_t)plen + len + 1);
+    put_locked(sink, prefix, (size_t)plen);
+    put_locked(sink, payload, len);
+    put_locked(sink, "\n", 1);
+    appended_locked(sink);
+    pthread_mutex_unlock(&sink->lock);
+}
+
+// Bulk streams are written raw, without the per-message framing
+void sink_write_stream(OutputSink *sink, const uint8_t *data, size_t len) {
+    pthread_mutex_lock(&sink->lock);
+    reserve_locked(sink, len);
+    put_locked(sink, data, len);
+    appended_locked(sink);
+    pthread_mutex_unlock(&sink->lock);
+}
+
+// When buffered output falls due on a worker, EVENT_LOOP_NO_DEADLINE if
+// nothing is waiting or the writer thread owns the flushing
+uint64_t sink_deadline(OutputSink *sink) {
+    uint64_t deadline = EVENT_LOOP_NO_DEADLINE;
+    pthread_mutex_lock(&sink->lock);
+    if (!sink->threaded && sink->used > 0) {
+        deadline = sink->first_ns + sink->flush_ns;
+    }
+    pthread_mutex_unlock(&sink->lock);
+    return deadline;
+}
+
+// Time threshold, checked by each worker after every wakeup
+void sink_poll(OutputSink *sink, uint64_t now_ns) {
+    pthread_mutex_lock(&sink->lock);
+    if (!sink->threaded && !sink->flushing && flush_due(sink, now_ns)) {
+        drain_locked(sink);
+    }
+    pthread_mutex_unlock(&sink->lock);
+}
+
+// Window to advertise in SACKs: span shrunk in proportion to how full the
+// output buffer, and a pipe reading from it, are, so a slow reader
+// throttles the senders before the workers stall
+uint16_t sink_window(OutputSink *sink, uint16_t span) {
+    pthread_mutex_lock(&sink->lock);
+    size_t free_bytes = sink->capacity - sink->used;
+    pthread_mutex_unlock(&sink->lock);
+    uint64_t window = (uint64_t)span * free_bytes / sink->capacity;
+
+    int queued;
+    if (sink->pipe_size > 0 && ioctl(sink->fd, FIONREAD, &queued) == 0 && queued >= 0) {
+        uint64_t pipe_window = queued >= sink->pipe_size ? 0 :
+                               (uint64_t)span * (uint64_t)(sink->pipe_size - queued) /
+                               (uint64_t)sink->pipe_size;
+        if (pipe_window < window) {
+            window = pipe_window;
+        }
+    }
+    return (uint16_t)window;
+}
@@ -0,0 +1,69 @@
+#ifndef COMP7005PROJ1_SINK_H
+#define COMP7005PROJ1_SINK_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "protocol.h"
+
+#define SINK_USAGE "[--output <path>] [--output-thread] [--output-buffer <bytes>] " \
+                   "[--flush-bytes <n>] [--flush-ms <ms>]"
+#define SINK_DEFAULT_BUFFER (4 * 1024 * 1024)
+#define SINK_DEFAULT_FLUSH_BYTES 65536
+#define SINK_DEFAULT_FLUSH_MS 1
+#define SINK_MIN_BUFFER (2 * MAX_RECORD_SIZE + 256)  // The largest record and its framing, twice
+
+typedef struct {
+    const char *path;          // Write here instead of stdout
+    int thread;                // Leave the writes to a background thread
+    size_t buffer_bytes;       // Delivered output held before writers stall
+    size_t flush_bytes;        // Write out once this much is buffered
+    int flush_ms;              // ... or once the oldest buffered byte is this old
+} SinkConfig;
+
+/*
+ * Delivered messages from every worker, buffered in one byte ring and
+ * written out with writev() in large pieces. Workers only copy into the
+ * ring under the lock; the write itself happens outside it, on the worker
+ * whose flush is due or on the writer thread.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t data_cond;  // Writer thread: output is due, or stop
+    pthread_cond_t space_cond; // Stalled workers: the ring has drained
+    uint8_t *ring;
+    size_t capacity;
+    size_t head;               // Oldest unwritten byte
+    size_t used;
+    uint64_t first_ns;         // When the ring last went from empty to non-empty
+    int flushing;              // A writev() is in progress outside the lock
+    int waiters;               // Workers stalled in an append
+    int stop;
+    int fd;
+    int owns_fd;               // Opened from --output, closed on destroy
+    int pipe_size;             // Capacity when fd is a pipe, else 0
+    int write_failed;          // Output is being discarded after a write error
+    size_t flush_bytes;
+    uint64_t flush_ns;
+    int threaded;
+    pthread_t writer;
+    FILE *log_fp;
+    uint64_t writes;
+    uint64_t bytes;
+    uint64_t stalls;           // Appends that waited for room in the ring
+} OutputSink;
+
+// Function prototypes
+void sink_config_default(SinkConfig *config);
+int sink_parse_arg(int argc, char *argv[], int *i, SinkConfig *config);
+int sink_config_valid(const SinkConfig *config);
+int sink_init(OutputSink *sink, const SinkConfig *config, FILE *log_fp);
+void sink_destroy(OutputSink *sink);
+void sink_write_message(OutputSink *sink, uint32_t seq_num, const uint8_t *payload, size_t len);
+void sink_write_stream(OutputSink *sink, const uint8_t *data, size_t len);
+uint64_t sink_deadline(OutputSink *sink);
+void sink_poll(OutputSink *sink, uint64_t now_ns);
+uint16_t sink_window(OutputSink *sink, uint16_t span);
+
+#endif //COMP7005PROJ1_SINK_H
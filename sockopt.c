@@ -0,0 +1,195 @@
+#include "sockopt.h"
+#include "log.h"
+#include <errno.h>
+#include <netinet/in.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef __linux__
+#include <netinet/udp.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#endif
+
+/*
+ * Socket-level tuning shared by the client, server and proxy. Every option
+ * is best-effort: a kernel or privilege level that refuses one is logged
+ * and the program carries on with the default behaviour.
+ */
+
+static void log_sockopt(FILE *log_fp, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    log_vwrite(LOG_LEVEL_INFO, log_fp, format, args);
+    va_end(args);
+}
+
+void sockopt_config_default(SocketConfig *config) {
+    memset(config, 0, sizeof(*config));
+}
+
+int sockopt_parse_arg(int argc, char *argv[], int *i, SocketConfig *config) {
+    if (*i + 1 >= argc) {
+        return 0;
+    }
+    if (strcmp(argv[*i], "--rcvbuf") == 0) {
+        config->rcvbuf = atoi(argv[++*i]);
+    } else if (strcmp(argv[*i], "--sndbuf") == 0) {
+        config->sndbuf = atoi(argv[++*i]);
+    } else if (strcmp(argv[*i], "--busy-poll") == 0) {
+        config->busy_poll = atoi(argv[++*i]);
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+int sockopt_config_valid(const SocketConfig *config) {
+    return config->rcvbuf >= 0 && config->sndbuf >= 0 && config->busy_poll >= 0;
+}
+
+static int get_int_opt(int fd, int level, int name) {
+    int value = 0;
+    socklen_t len = sizeof(value);
+    if (getsockopt(fd, level, name, &value, &len) < 0) {
+        return -1;
+    }
+    return value;
+}
+
+// The kernel doubles the request for its own bookkeeping and clamps it to
+// net.core.{r,w}mem_max; the *FORCE variant skips the clamp for root
+static void set_buffer(int fd, int name, int force_name, int bytes, const char *label,
+                       FILE *log_fp) {
+    setsockopt(fd, SOL_SOCKET, name, &bytes, sizeof(bytes));
+    if (get_int_opt(fd, SOL_SOCKET, name) / 2 < bytes) {
+        setsockopt(fd, SOL_SOCKET, force_name, &bytes, sizeof(bytes));
+    }
+    int effective = get_int_opt(fd, SOL_SOCKET, name);
+    if (effective / 2 < bytes) {
+        log_sockopt(log_fp, "WARN: %s capped at %d of %d bytes; raise net.core.%s_max or run as root",
+                   label, effective / 2, bytes, name == SO_RCVBUF ? "rmem" : "wmem");
+    }
+}
+
+void sockopt_apply(int fd, const SocketConfig *config, FILE *log_fp) {
+    int on = 1;
+
+#ifdef SO_RXQ_OVFL
+    // Reports the socket's running drop count with each datagram, which is
+    // how receive-buffer overruns show up as udp_batch_overflow()
+    setsockopt(fd, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof(on));
+#endif
+
+    if (config->rcvbuf > 0) {
+        set_buffer(fd, SO_RCVBUF, SO_RCVBUFFORCE, config->rcvbuf, "SO_RCVBUF", log_fp);
+    }
+    if (config->sndbuf > 0) {
+        set_buffer(fd, SO_SNDBUF, SO_SNDBUFFORCE, config->sndbuf, "SO_SNDBUF", log_fp);
+    }
+
+    if (config->busy_poll > 0) {
+#ifdef SO_BUSY_POLL
+        if (setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &config->busy_poll,
+                       sizeof(config->busy_poll)) < 0) {
+            log_sockopt(log_fp, "WARN: SO_BUSY_POLL unavailable: %s", strerror(errno));
+        }
+#else
+        log_sockopt(log_fp, "WARN: SO_BUSY_POLL not supported on this platform");
+#endif
+    }
+
+    if (config->gro) {
+#ifdef UDP_GRO
+        if (setsockopt(fd, IPPROTO_UDP, UDP_GRO, &on, sizeof(on)) < 0) {
+            log_sockopt(log_fp, "WARN: UDP_GRO unavailable: %s", strerror(errno));
+        }
+#else
+        log_sockopt(log_fp, "WARN: UDP_GRO not supported on this platform");
+#endif
+    }
+
+    if (config->timestamps) {
+#ifdef SO_TIMESTAMPING
+        int flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+        if (setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) < 0) {
+            log_sockopt(log_fp, "WARN: SO_TIMESTAMPING unavailable: %s", strerror(errno));
+        }
+#else
+        log_sockopt(log_fp, "WARN: SO_TIMESTAMPING not supported on this platform");
+#endif
+    }
+
+    if (config->rcvbuf > 0 || config->sndbuf > 0 || config->busy_poll > 0 ||
+        config->gro || config->timestamps) {
+        log_sockopt(log_fp, "SOCKET: fd=%d, rcvbuf=%d, sndbuf=%d, busy_poll=%dus%s%s%s", fd,
+                   get_int_opt(fd, SOL_SOCKET, SO_RCVBUF), get_int_opt(fd, SOL_SOCKET, SO_SNDBUF),
+                   config->busy_poll, config->gso ? ", gso" : "",
+                   config->gro ? ", gro" : "", config->timestamps ? ", timestamps" : "");
+    }
+}
+
+// Kernel receive time of a datagram read with recvmsg(), on the monotonic
+// clock, or 0 if it carries no software timestamp
+uint64_t sockopt_rx_timestamp(struct msghdr *msg) {
+#ifdef SO_TIMESTAMPING
+    for (struct cmsghdr *c = CMSG_FIRSTHDR(msg); c; c = CMSG_NXTHDR(msg, c)) {
+        if (c->cmsg_level != SOL_SOCKET || c->cmsg_type != SCM_TIMESTAMPING) {
+            continue;
+        }
+        struct scm_timestamping ts;
+        memcpy(&ts, CMSG_DATA(c), sizeof(ts));
+        if (ts.ts[0].tv_sec == 0 && ts.ts[0].tv_nsec == 0) {
+            return 0;
+        }
+
+        // Software stamps are CLOCK_REALTIME; shift them onto the monotonic clock
+        struct timespec real, mono;
+        clock_gettime(CLOCK_REALTIME, &real);
+        clock_gettime(CLOCK_MONOTONIC, &mono);
+        int64_t age = ((int64_t)real.tv_sec - ts.ts[0].tv_sec) * 1000000000LL +
+                      (real.tv_nsec - ts.ts[0].tv_nsec);
+        uint64_t now = (uint64_t)mono.tv_sec * 1000000000ULL + (uint64_t)mono.tv_nsec;
+        if (age < 0 || (uint64_t)age > now) {
+            return 0;         // Clock stepped; fall back to the caller's own reading
+        }
+        return now - (uint64_t)age;
+    }
+#else
+    (void)msg;
+#endif
+    return 0;
+}
+
+// One sendmsg() of several messages laid out back to back, which the
+// kernel cuts into datagrams of segment bytes (only the last may be shorter)
+ssize_t sockopt_send_gso(int fd, const struct iovec *iov, int iovcnt, uint16_t segment,
+                         const struct sockaddr *dest, socklen_t dest_len) {
+#ifdef UDP_SEGMENT
+    union {
+        char buf[CMSG_SPACE(sizeof(uint16_t))];
+        struct cmsghdr align;
+    } control;
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    memset(&control, 0, sizeof(control));
+    msg.msg_name = (void *)dest;
+    msg.msg_namelen = dest_len;
+    msg.msg_iov = (struct iovec *)iov;
+    msg.msg_iovlen = (size_t)iovcnt;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    struct cmsghdr *c = CMSG_FIRSTHDR(&msg);
+    c->cmsg_level = IPPROTO_UDP;
+    c->cmsg_type = UDP_SEGMENT;
+    c->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+    memcpy(CMSG_DATA(c), &segment, sizeof(segment));
+    return sendmsg(fd, &msg, 0);
+#else
+    (void)fd; (void)iov; (void)iovcnt; (void)segment; (void)dest; (void)dest_len;
+    errno = ENOPROTOOPT;
+    return -1;
+#endif
+}
@@ -0,0 +1,33 @@
+#ifndef COMP7005PROJ1_SOCKOPT_H
+#define COMP7005PROJ1_SOCKOPT_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#define SOCKOPT_USAGE "[--rcvbuf <bytes>] [--sndbuf <bytes>] [--busy-poll <usec>]"
+#define SOCKOPT_GSO_MAX_SEGMENTS 64       // Kernel limit on segments per UDP_SEGMENT send
+#define SOCKOPT_GSO_MAX_BYTES 65000       // A GSO send must still fit one IP datagram
+#define SOCKOPT_GRO_BUF_SIZE 65536        // Receive slot able to hold a coalesced datagram
+
+// Optional tuning applied to every UDP socket a program opens
+typedef struct {
+    int rcvbuf;               // Requested SO_RCVBUF bytes, 0 = kernel default
+    int sndbuf;               // Requested SO_SNDBUF bytes, 0 = kernel default
+    int busy_poll;            // SO_BUSY_POLL usec, 0 = off
+    int gso;                  // Client: send runs of equal-size messages as one UDP_SEGMENT write
+    int gro;                  // Server/proxy: let the kernel coalesce arrivals (UDP_GRO)
+    int timestamps;           // Client: take RTT samples from kernel receive timestamps
+} SocketConfig;
+
+// Function prototypes
+void sockopt_config_default(SocketConfig *config);
+int sockopt_parse_arg(int argc, char *argv[], int *i, SocketConfig *config);
+int sockopt_config_valid(const SocketConfig *config);
+void sockopt_apply(int fd, const SocketConfig *config, FILE *log_fp);
+uint64_t sockopt_rx_timestamp(struct msghdr *msg);
+ssize_t sockopt_send_gso(int fd, const struct iovec *iov, int iovcnt, uint16_t segment,
+                         const struct sockaddr *dest, socklen_t dest_len);
+
+#endif //COMP7005PROJ1_SOCKOPT_H
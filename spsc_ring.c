@@ -0,0 +1,71 @@
+#include "spsc_ring.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Capacity is rounded up to a power of two
+int spsc_ring_init(SpscRing *ring, unsigned capacity, size_t elem_size) {
+    memset(ring, 0, sizeof(*ring));
+    if (capacity == 0 || capacity > (1u << 30) || elem_size == 0) {
+        return -1;
+    }
+
+    unsigned size = 1;
+    while (size < capacity) {
+        size <<= 1;
+    }
+
+    ring->slots = malloc((size_t)size * elem_size);
+    if (!ring->slots) {
+        return -1;
+    }
+    ring->mask = size - 1;
+    ring->elem_size = elem_size;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    return 0;
+}
+
+void spsc_ring_destroy(SpscRing *ring) {
+    free(ring->slots);
+    memset(ring, 0, sizeof(*ring));
+}
+
+// Producer only. Returns -1 when the ring is full.
+int spsc_ring_push(SpscRing *ring, const void *elem) {
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    if (tail - ring->cached_head > ring->mask) {
+        ring->cached_head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        if (tail - ring->cached_head > ring->mask) {
+            return -1;
+        }
+    }
+
+    memcpy(ring->slots + (size_t)(tail & ring->mask) * ring->elem_size, elem, ring->elem_size);
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return 0;
+}
+
+// Consumer only. Returns -1 when the ring is empty.
+int spsc_ring_pop(SpscRing *ring, void *elem) {
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    if (head == ring->cached_tail) {
+        ring->cached_tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        if (head == ring->cached_tail) {
+            return -1;
+        }
+    }
+
+    memcpy(elem, ring->slots + (size_t)(head & ring->mask) * ring->elem_size, ring->elem_size);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return 0;
+}
+
+// Consumer only
+int spsc_ring_empty(SpscRing *ring) {
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    if (head != ring->cached_tail) {
+        return 0;
+    }
+    ring->cached_tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    return head == ring->cached_tail;
+}
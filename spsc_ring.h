@@ -0,0 +1,35 @@
+#ifndef COMP7005PROJ1_SPSC_RING_H
+#define COMP7005PROJ1_SPSC_RING_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Bounded lock-free queue between exactly one producer thread and one
+ * consumer thread. Elements are fixed-size records copied in and out.
+ * Each side keeps a private copy of the other side's index and only
+ * reloads it when the ring looks full (or empty), so in steady state the
+ * two threads touch each other's cache line once per lap, not per element.
+ */
+typedef struct {
+    // Producer side
+    _Alignas(64) _Atomic unsigned tail;   // Next slot the producer fills
+    unsigned cached_head;
+    // Consumer side
+    _Alignas(64) _Atomic unsigned head;   // Next slot the consumer reads
+    unsigned cached_tail;
+    // Read-only after init
+    _Alignas(64) unsigned mask;           // Capacity - 1 (capacity is a power of two)
+    size_t elem_size;
+    uint8_t *slots;
+} SpscRing;
+
+// Function prototypes
+int spsc_ring_init(SpscRing *ring, unsigned capacity, size_t elem_size);
+void spsc_ring_destroy(SpscRing *ring);
+int spsc_ring_push(SpscRing *ring, const void *elem);
+int spsc_ring_pop(SpscRing *ring, void *elem);
+int spsc_ring_empty(SpscRing *ring);
+
+#endif //COMP7005PROJ1_SPSC_RING_H
@@ -7,6 +7,7 @@ Reads log files and generates visual statistics
 import re
 import sys
 import glob
+import math
 from collections import defaultdict
 from datetime import datetime
 
@@ -23,20 +24,54 @@ def find_log_files():
     }
 
 def parse_log_file(filename):
-    """Parse a log file and extract events"""
+    """Parse a log file and extract events
+
+    Lines are stamped "[seconds.nanoseconds]" with the monotonic clock; each
+    run starts with a CLOCK line anchoring that clock to the wall clock.
+    Older logs stamped "[YYYY-mm-dd HH:MM:SS]" are still read, at one-second
+    resolution. Every event gets 'ts_ns' (for intervals within a file) and
+    'timestamp' (wall clock, a datetime).
+    """
     events = []
+    offset_ns = None    # realtime_ns - monotonic_ns from the latest CLOCK line
 
     try:
         with open(filename, 'r') as f:
             for line in f:
-                match = re.match(r'\[([\d\-: ]+)\] (.+)', line.strip())
+                line = line.strip()
+                match = re.match(r'\[(\d+)\.(\d{9})\] (.+)', line)
+                if match:
+                    seconds, nanos, message = match.groups()
+                    ts_ns = int(seconds) * 1000000000 + int(nanos)
+
+                    clock = re.match(r'CLOCK: monotonic_ns=(\d+), realtime=([\d\-: ]+)\.(\d{9}) ([+-]\d{4})', message)
+                    if clock:
+                        mono, wall, wall_nanos, zone = clock.groups()
+                        try:
+                            anchor = datetime.strptime(f"{wall} {zone}", '%Y-%m-%d %H:%M:%S %z')
+                        except ValueError:
+                            continue
+                        offset_ns = int(anchor.timestamp()) * 1000000000 + int(wall_nanos) - int(mono)
+                        continue
+
+                    wall_ns = ts_ns + offset_ns if offset_ns is not None else ts_ns
+                    events.append({
+                        'ts_ns': ts_ns,
+                        'timestamp': datetime.fromtimestamp(wall_ns / 1e9),
+                        'message': message
+                    })
+                    continue
+
+                match = re.match(r'\[([\d\-: ]+)\] (.+)', line)
                 if match:
                     timestamp_str, message = match.groups()
                     try:
                         timestamp = datetime.strptime(timestamp_str, '%Y-%m-%d %H:%M:%S')
                         events.append({
+                            'ts_ns': int(timestamp.timestamp()) * 1000000000,
                             'timestamp': timestamp,
-                            'message': message
+                            'message': message,
+                            'coarse': True
                         })
                     except ValueError:
                         pass
@@ -46,6 +81,21 @@ def parse_log_file(filename):
 
     return events
 
+def percentile(sorted_values, pct):
+    """Nearest-rank percentile of an ascending list"""
+    if not sorted_values:
+        return 0
+    rank = max(1, math.ceil(pct / 100.0 * len(sorted_values)))
+    return sorted_values[min(rank, len(sorted_values)) - 1]
+
+def print_latency(label, values_ns):
+    """Print the distribution of a list of latencies given in nanoseconds"""
+    if not values_ns:
+        return
+    ms = sorted(v / 1e6 for v in values_ns)
+    print(f"{label:26s}p50={percentile(ms, 50):.3f}ms p90={percentile(ms, 90):.3f}ms "
+          f"p99={percentile(ms, 99):.3f}ms max={ms[-1]:.3f}ms (n={len(ms)})")
+
 def analyze_client_log(events):
     """Analyze client log for statistics"""
     stats = {
@@ -54,8 +104,13 @@ def analyze_client_log(events):
         'total_failed': 0,
         'total_timeouts': 0,
         'retransmissions': defaultdict(int),
-        'sequences': set()
+        'sequences': set(),
+        'delivery_ns': [],     # First transmission to ACK, per message
+        'rtt_ns': [],          # Send to ACK for messages sent only once
+        'high_res': bool(events) and not any(e.get('coarse') for e in events)
     }
+    first_send = {}
+    send_count = defaultdict(int)
 
     for event in events:
         msg = event['message']
@@ -64,10 +119,21 @@ def analyze_client_log(events):
             stats['total_sent'] += 1
             seq_match = re.search(r'seq=(\d+)', msg)
             if seq_match:
-                stats['sequences'].add(int(seq_match.group(1)))
+                seq = int(seq_match.group(1))
+                stats['sequences'].add(seq)
+                first_send.setdefault(seq, event['ts_ns'])
+                send_count[seq] += 1
 
         if 'ACK_RECV:' in msg:
             stats['total_acked'] += 1
+            seq_match = re.search(r'seq=(\d+)', msg)
+            if seq_match:
+                seq = int(seq_match.group(1))
+                sent_ns = first_send.pop(seq, None)
+                if sent_ns is not None:
+                    stats['delivery_ns'].append(event['ts_ns'] - sent_ns)
+                    if send_count[seq] == 1:
+                        stats['rtt_ns'].append(event['ts_ns'] - sent_ns)
 
         if 'FAILED:' in msg:
             stats['total_failed'] += 1
@@ -111,6 +177,12 @@ def analyze_proxy_log(events):
         'dropped_s2c': 0,
         'delayed_c2s': 0,
         'delayed_s2c': 0,
+        'reordered_c2s': 0,
+        'reordered_s2c': 0,
+        'duplicated_c2s': 0,
+        'duplicated_s2c': 0,
+        'corrupted_c2s': 0,
+        'corrupted_s2c': 0,
         'delay_times_c2s': [],
         'delay_times_s2c': []
     }
@@ -139,6 +211,21 @@ def analyze_proxy_log(events):
             if delay_match:
                 stats['delay_times_s2c'].append(int(delay_match.group(1)))
 
+        if 'C->S: REORDERED' in msg:
+            stats['reordered_c2s'] += 1
+        elif 'S->C: REORDERED' in msg:
+            stats['reordered_s2c'] += 1
+
+        if 'C->S: DUPLICATED' in msg:
+            stats['duplicated_c2s'] += 1
+        elif 'S->C: DUPLICATED' in msg:
+            stats['duplicated_s2c'] += 1
+
+        if 'C->S: CORRUPTED' in msg:
+            stats['corrupted_c2s'] += 1
+        elif 'S->C: CORRUPTED' in msg:
+            stats['corrupted_s2c'] += 1
+
     return stats
 
 def print_bar_chart(label, value, max_value, width=50):
@@ -188,6 +275,11 @@ def analyze_test_set(client_file, server_file, proxy_file=None):
             success_rate = (client_stats['total_acked'] / len(client_stats['sequences'])) * 100
             print(f"Success rate:             {success_rate:.1f}%")
 
+        # Needs SEND and ACK_RECV lines, i.e. a trace-level, unsampled client log
+        if client_stats['high_res']:
+            print_latency("RTT (first attempt):", client_stats['rtt_ns'])
+            print_latency("Delivery latency:", client_stats['delivery_ns'])
+
         if client_stats['retransmissions']:
             print("\nRetransmission attempts:")
             max_attempts = max(client_stats['retransmissions'].values()) if client_stats['retransmissions'] else 1
@@ -217,6 +309,12 @@ def analyze_test_set(client_file, server_file, proxy_file=None):
         print(f"Client->Server packets:   {proxy_stats['client_to_server']}")
         print(f"  Dropped:                {proxy_stats['dropped_c2s']}")
         print(f"  Delayed:                {proxy_stats['delayed_c2s']}")
+        if proxy_stats['reordered_c2s']:
+            print(f"  Reordered:              {proxy_stats['reordered_c2s']}")
+        if proxy_stats['duplicated_c2s']:
+            print(f"  Duplicated:             {proxy_stats['duplicated_c2s']}")
+        if proxy_stats['corrupted_c2s']:
+            print(f"  Corrupted:              {proxy_stats['corrupted_c2s']}")
 
         if proxy_stats['client_to_server'] > 0:
             drop_rate = (proxy_stats['dropped_c2s'] / proxy_stats['client_to_server']) * 100
@@ -232,6 +330,12 @@ def analyze_test_set(client_file, server_file, proxy_file=None):
         print(f"Server->Client packets:   {proxy_stats['server_to_client']}")
         print(f"  Dropped:                {proxy_stats['dropped_s2c']}")
         print(f"  Delayed:                {proxy_stats['delayed_s2c']}")
+        if proxy_stats['reordered_s2c']:
+            print(f"  Reordered:              {proxy_stats['reordered_s2c']}")
+        if proxy_stats['duplicated_s2c']:
+            print(f"  Duplicated:             {proxy_stats['duplicated_s2c']}")
+        if proxy_stats['corrupted_s2c']:
+            print(f"  Corrupted:              {proxy_stats['corrupted_s2c']}")
 
         if proxy_stats['server_to_client'] > 0:
             drop_rate = (proxy_stats['dropped_s2c'] / proxy_stats['server_to_client']) * 100